@@ -0,0 +1,394 @@
+/* ======================================================================================
+ * FILE: microbench.c
+ * Microbenchmarks of the hot paths, outside the process graph:
+ *
+ *   microbench [physics|swarm|generate|codec|netbuf]
+ *
+ * physics  : sim_physics_step() (forces + Euler + collision) and the snapshot sync,
+ *            10 to 100k obstacles on a BENCH_FIELD x BENCH_FIELD field.
+ * swarm    : sim_swarm_step() for 1 to 4096 drones, reported per drone step, and
+ *            the same steps on 2 and 4 physics_pool workers.
+ * generate : sim_generate() across densities, on the game window and a large field.
+ * codec    : Message encode/decode, binary payloads vs the legacy snprintf/sscanf text.
+ * netbuf   : protocol line extraction (NetBuf) from a socket.
+ *
+ * Every case runs until BENCH_MIN_NS have elapsed; the fixed srand() seed keeps the
+ * random layouts the same from run to run.
+ * ====================================================================================== */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "app_common.h"
+#include "app_blackboard.h"
+#include "msg_codec.h"
+#include "netbuf.h"
+#include "sim_core.h"
+#include "physics_pool.h"
+
+#define BENCH_MIN_NS 200000000LL  // Minimum run time per case
+#define BENCH_FIELD  1000         // Physics field edge (cells)
+#define BENCH_SPOTS  1024         // Drone restart positions, cycled through
+
+typedef void (*BenchFn)(void *arg, long iters);
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 1: HARNESS
+ * ------------------------------------------------------------------------------------- */
+static long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* * Doubles the iteration count until one batch lasts BENCH_MIN_NS and reports
+ * that batch. ops_per_iter scales the result when an iteration is several
+ * operations (e.g. the lines of one netbuf chunk).
+ */
+static void bench(const char *name, BenchFn fn, void *arg, double ops_per_iter) {
+    long iters = 1;
+    long long t;
+    for (;;) {
+        long long t0 = now_ns();
+        fn(arg, iters);
+        t = now_ns() - t0;
+        if (t >= BENCH_MIN_NS || iters >= (1L << 40)) break;
+        iters *= 2;
+    }
+    double ns = (double)t / (iters * ops_per_iter);
+    printf("  %-44s %12.1f ns/op %14.0f op/s\n", name, ns, 1e9 / ns);
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 2: PHYSICS
+ * ------------------------------------------------------------------------------------- */
+typedef struct {
+    SimField field;
+    Point *obstacles, *moved;
+    int num_obstacles;
+    Point spots[BENCH_SPOTS];
+    Drone drn;
+} PhysicsCase;
+
+static void place_drone(Drone *drn, Point p) {
+    memset(drn, 0, sizeof(*drn));
+    drn->x = drn->x_1 = drn->x_2 = p.x + 0.5f;
+    drn->y = drn->y_1 = drn->y_2 = p.y + 0.5f;
+    drn->Fx = 1.0f;
+    drn->Fy = -1.0f;
+}
+
+static void physics_steps(void *arg, long iters) {
+    PhysicsCase *c = arg;
+    MsgForce out;
+    for (long i = 0; i < iters; i++) {
+        // The drone drifts: restart it every BENCH_SPOTS steps somewhere else in the field
+        if ((i & (BENCH_SPOTS - 1)) == 0) place_drone(&c->drn, c->spots[(i / BENCH_SPOTS) % BENCH_SPOTS]);
+        sim_physics_step(&c->field, c->obstacles, &c->drn, BENCH_FIELD, BENCH_FIELD, &out);
+    }
+}
+
+// A snapshot where every obstacle moved: alternates between two layouts
+static void physics_sync(void *arg, long iters) {
+    PhysicsCase *c = arg;
+    for (long i = 0; i < iters; i++) {
+        sim_field_set_obstacles(&c->field, (i & 1) ? c->obstacles : c->moved, c->num_obstacles);
+    }
+    sim_field_set_obstacles(&c->field, c->obstacles, c->num_obstacles);
+}
+
+static void bench_physics(void) {
+    static const int counts[] = { 10, 100, 1000, 10000, 100000 };
+    const int cells = (BENCH_FIELD - 2) * (BENCH_FIELD - 2);
+    printf("physics (%dx%d field, 100 targets, force kernel: %s)\n", BENCH_FIELD, BENCH_FIELD, force_kernel_name());
+
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        PhysicsCase c = { .obstacles = NULL, .moved = NULL };
+        Point *targets = NULL;
+        int obst_cap = 0, moved_cap = 0, targ_cap = 0;
+        char name[64];
+        srand(1);
+        sim_field_init(&c.field);
+        c.num_obstacles = sim_generate(&c.obstacles, &obst_cap, BENCH_FIELD, BENCH_FIELD,
+                                       (float)counts[k] / cells, NULL, 0);
+        int n_moved = sim_generate(&c.moved, &moved_cap, BENCH_FIELD, BENCH_FIELD, (float)counts[k] / cells, NULL, 0);
+        int n_targets = sim_generate(&targets, &targ_cap, BENCH_FIELD, BENCH_FIELD, 100.0f / cells,
+                                     c.obstacles, c.num_obstacles);
+        if (c.num_obstacles < 0 || n_moved != c.num_obstacles || n_targets < 0) {
+            fprintf(stderr, "microbench: out of memory\n");
+            exit(1);
+        }
+        for (int i = 0; i < BENCH_SPOTS; i++) {
+            c.spots[i].x = rand() % (BENCH_FIELD - 2 * (int)rho) + (int)rho;
+            c.spots[i].y = rand() % (BENCH_FIELD - 2 * (int)rho) + (int)rho;
+        }
+        sim_field_set_obstacles(&c.field, c.obstacles, c.num_obstacles);
+        sim_field_set_targets(&c.field, targets, n_targets);
+
+        snprintf(name, sizeof(name), "step, %d obstacles", c.num_obstacles);
+        bench(name, physics_steps, &c, 1);
+        snprintf(name, sizeof(name), "snapshot sync, %d obstacles", c.num_obstacles);
+        bench(name, physics_sync, &c, 1);
+
+        sim_field_free(&c.field);
+        free(c.obstacles);
+        free(c.moved);
+        free(targets);
+    }
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 3: SWARM
+ * ------------------------------------------------------------------------------------- */
+typedef struct {
+    SimField field;
+    Point *obstacles;
+    DroneSwarm swarm;
+    PhysicsPool *pool;        // NULL: sim_swarm_step() on this thread
+} SwarmCase;
+
+static void swarm_steps(void *arg, long iters) {
+    SwarmCase *c = arg;
+    MsgForce out;
+    for (long i = 0; i < iters; i++) {
+        // Spread over the field again before the drift takes everyone to a wall
+        if ((i & (BENCH_SPOTS - 1)) == 0) {
+            sim_swarm_spawn(&c->swarm, BENCH_FIELD / 2.0f, BENCH_FIELD / 2.0f, BENCH_FIELD, BENCH_FIELD);
+            for (int d = 0; d < c->swarm.count; d++) { c->swarm.Fx[d] = 1.0f; c->swarm.Fy[d] = -1.0f; }
+        }
+        if (c->pool) {
+            physics_pool_start(c->pool, &c->field, c->obstacles, &c->swarm, BENCH_FIELD, BENCH_FIELD, 1, &out);
+            physics_pool_wait(c->pool);
+        } else {
+            sim_swarm_step(&c->field, c->obstacles, &c->swarm, BENCH_FIELD, BENCH_FIELD, &out);
+        }
+    }
+}
+
+static void bench_swarm(void) {
+    static const int sizes[] = { 1, 16, 256, 4096 };
+    const int cells = (BENCH_FIELD - 2) * (BENCH_FIELD - 2);
+    printf("swarm (%dx%d field, 1000 obstacles, 100 targets, per drone step)\n", BENCH_FIELD, BENCH_FIELD);
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        SwarmCase c = { .obstacles = NULL };
+        Point *targets = NULL;
+        int obst_cap = 0, targ_cap = 0;
+        char name[64];
+        srand(1);
+        sim_field_init(&c.field);
+        int n_obst = sim_generate(&c.obstacles, &obst_cap, BENCH_FIELD, BENCH_FIELD, 1000.0f / cells, NULL, 0);
+        int n_targets = sim_generate(&targets, &targ_cap, BENCH_FIELD, BENCH_FIELD, 100.0f / cells,
+                                     c.obstacles, n_obst);
+        if (n_obst < 0 || n_targets < 0 || sim_swarm_init(&c.swarm, sizes[k]) < 0) {
+            fprintf(stderr, "microbench: out of memory\n");
+            exit(1);
+        }
+        sim_field_set_obstacles(&c.field, c.obstacles, n_obst);
+        sim_field_set_targets(&c.field, targets, n_targets);
+
+        c.pool = NULL;
+        snprintf(name, sizeof(name), "swarm step, %d drones", sizes[k]);
+        bench(name, swarm_steps, &c, sizes[k]);
+
+        // One job per step: the figures include handing the step to the workers
+        for (int threads = 2; threads <= 4 && sizes[k] >= 256; threads *= 2) {
+            PhysicsPool pool;
+            if (physics_pool_init(&pool, threads) < 0) break;
+            c.pool = &pool;
+            snprintf(name, sizeof(name), "swarm step, %d drones, %d workers", sizes[k], threads);
+            bench(name, swarm_steps, &c, sizes[k]);
+            physics_pool_free(&pool);
+        }
+
+        sim_swarm_free(&c.swarm);
+        sim_field_free(&c.field);
+        free(c.obstacles);
+        free(targets);
+    }
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 4: GENERATION
+ * ------------------------------------------------------------------------------------- */
+typedef struct {
+    int width, height;
+    float density;
+    Point *taken;
+    int num_taken;
+    Point *out;               // Refilled by every round, as in the Obstacle and Target processes
+    int out_cap;
+} GenerateCase;
+
+static void generate(void *arg, long iters) {
+    GenerateCase *c = arg;
+    for (long i = 0; i < iters; i++) {
+        if (sim_generate(&c->out, &c->out_cap, c->width, c->height, c->density, c->taken, c->num_taken) < 0) exit(1);
+    }
+}
+
+static void bench_generate(void) {
+    static const float densities[] = { 0.01f, 0.05f, 0.1f, 0.3f, 0.6f, 0.9f };
+    static const int fields[][2] = { { WIDTH, HEIGHT }, { 400, 400 } };
+    printf("generate (obstacles on an empty field, then targets around PERC_OBST obstacles)\n");
+
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        for (size_t k = 0; k < sizeof(densities) / sizeof(densities[0]); k++) {
+            GenerateCase c = { fields[f][0], fields[f][1], densities[k], NULL, 0, NULL, 0 };
+            char name[64];
+            srand(1);
+            snprintf(name, sizeof(name), "obstacles %dx%d, density %.2f", c.width, c.height, c.density);
+            bench(name, generate, &c, 1);
+            free(c.out);
+        }
+        GenerateCase c = { fields[f][0], fields[f][1], PERC_TARG, NULL, 0, NULL, 0 };
+        int taken_cap = 0;
+        char name[64];
+        srand(1);
+        c.num_taken = sim_generate(&c.taken, &taken_cap, c.width, c.height, PERC_OBST, NULL, 0);
+        if (c.num_taken < 0) exit(1);
+        snprintf(name, sizeof(name), "targets %dx%d, %d obstacles", c.width, c.height, c.num_taken);
+        bench(name, generate, &c, 1);
+        free(c.taken);
+        free(c.out);
+    }
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 5: MESSAGE CODEC
+ * ------------------------------------------------------------------------------------- */
+static volatile float sink_f; // Keeps the decoded values alive
+
+static void binary_position(void *arg, long iters) {
+    (void)arg;
+    Message m;
+    float x, y;
+    for (long i = 0; i < iters; i++) {
+        msg_encode_position(&m, MSG_TYPE_POSITION, 60.25f + i, 20.5f);
+        msg_decode_position(&m, &x, &y);
+        sink_f = x;
+    }
+}
+
+static void binary_forces(void *arg, long iters) {
+    (void)arg;
+    Message m;
+    MsgForce f = { 1.0f, -1.0f, 0.25f, 0.5f, 0.0f, -2.5f, 3.125f, 0.75f }, g;
+    for (long i = 0; i < iters; i++) {
+        f.drn_Fx = (float)i;
+        msg_encode_forces(&m, &f);
+        msg_decode_forces(&m, &g);
+        sink_f = g.drn_Fx;
+    }
+}
+
+// The payloads of a MSG_TEXT=1 build, decoded by the same msg_decode_*() path
+static void text_message(Message *m, int type, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static void text_message(Message *m, int type, const char *fmt, ...) {
+    va_list args;
+    m->type = type;
+    m->version = MSG_VERSION_TEXT;
+    va_start(args, fmt);
+    vsnprintf(m->data, sizeof(m->data), fmt, args);
+    va_end(args);
+    m->len = (uint16_t)strlen(m->data);
+}
+
+static void text_position(void *arg, long iters) {
+    (void)arg;
+    Message m;
+    float x, y;
+    for (long i = 0; i < iters; i++) {
+        text_message(&m, MSG_TYPE_POSITION, "%f %f", 60.25f + i, 20.5f);
+        msg_decode_position(&m, &x, &y);
+        sink_f = x;
+    }
+}
+
+static void text_forces(void *arg, long iters) {
+    (void)arg;
+    Message m;
+    MsgForce f = { 1.0f, -1.0f, 0.25f, 0.5f, 0.0f, -2.5f, 3.125f, 0.75f }, g;
+    for (long i = 0; i < iters; i++) {
+        f.drn_Fx = (float)i;
+        text_message(&m, MSG_TYPE_FORCE, "%g %g %g %g %g %g %g %g",
+                     f.drn_Fx, f.drn_Fy, f.obst_Fx, f.obst_Fy, f.wall_Fx, f.wall_Fy, f.targ_Fx, f.targ_Fy);
+        msg_decode_forces(&m, &g);
+        sink_f = g.drn_Fx;
+    }
+}
+
+static void bench_codec(void) {
+    printf("codec (encode + decode of one Message; msg_encode_*() built with MSG_TEXT=%d)\n", MSG_TEXT_COMPAT);
+    bench("position, msg_encode/decode", binary_position, NULL, 1);
+    bench("position, snprintf/sscanf text", text_position, NULL, 1);
+    bench("forces, msg_encode/decode", binary_forces, NULL, 1);
+    bench("forces, snprintf/sscanf text", text_forces, NULL, 1);
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 6: NETWORK LINES
+ * ------------------------------------------------------------------------------------- */
+typedef struct {
+    int fds[2];
+    NetBuf buf;
+    char chunk[4000];              // Not a multiple of the line length: lines wrap
+    size_t chunk_len;
+} NetbufCase;
+
+static void netbuf_lines(void *arg, long iters) {
+    NetbufCase *c = arg;
+    for (long i = 0; i < iters; i++) {
+        write(c->fds[0], c->chunk, c->chunk_len);
+        size_t got = 0;
+        while (got < c->chunk_len) {
+            ssize_t n = netbuf_fill(&c->buf, c->fds[1]);
+            if (n <= 0) exit(1);
+            got += (size_t)n;
+            size_t len;
+            while (netbuf_line(&c->buf, &len)) {}
+        }
+    }
+}
+
+static void bench_netbuf(void) {
+    NetbufCase c;
+    const char *line = "f 123456 98765432 60.125 20.500 1.250 -0.750\n";
+    size_t line_len = strlen(line);
+    c.chunk_len = 0;
+    while (c.chunk_len + line_len <= sizeof(c.chunk)) {
+        memcpy(c.chunk + c.chunk_len, line, line_len);
+        c.chunk_len += line_len;
+    }
+    memcpy(c.chunk + c.chunk_len, line, sizeof(c.chunk) - c.chunk_len); // Partial line
+    c.chunk_len = sizeof(c.chunk);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, c.fds) < 0 || netbuf_init(&c.buf) < 0) {
+        perror("microbench: socketpair");
+        exit(1);
+    }
+    printf("netbuf (%zu-byte chunks of %zu-byte lines through a socket)\n", c.chunk_len, line_len);
+    bench("line, fill + extract", netbuf_lines, &c, (double)c.chunk_len / line_len);
+    netbuf_free(&c.buf);
+    close(c.fds[0]);
+    close(c.fds[1]);
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 7: MAIN
+ * ------------------------------------------------------------------------------------- */
+int main(int argc, char *argv[]) {
+    const char *only = (argc > 1) ? argv[1] : NULL;
+    config_from_env(); // ARP_RHO, ARP_PERC_OBST, ... as in a session
+    if (!only || strcmp(only, "physics") == 0)  bench_physics();
+    if (!only || strcmp(only, "swarm") == 0)    bench_swarm();
+    if (!only || strcmp(only, "generate") == 0) bench_generate();
+    if (!only || strcmp(only, "codec") == 0)    bench_codec();
+    if (!only || strcmp(only, "netbuf") == 0)   bench_netbuf();
+    return 0;
+}
@@ -1,6 +1,10 @@
 #ifndef APP_COMMON_H
 #define APP_COMMON_H
 
+#include <stdint.h>
+
+#include "config.h"
+
 #define MSG_TYPE_SIZE        1
 #define MSG_TYPE_OBSTACLES   2
 #define MSG_TYPE_INPUT       3
@@ -11,19 +15,27 @@
 #define MSG_TYPE_TARGETS     8
 #define MSG_TYPE_FORCE       9
 #define MSG_TYPE_PID         10
+#define MSG_TYPE_TICK        11   // Replay lockstep: physics steps granted to the Drone
+#define MSG_TYPE_PEER_LEFT   12   // Networked: a remote drone left the session
+#define MSG_TYPE_OBST_MOTION 13   // Networked: motion of the first obstacles (remote drones)
+#define MSG_TYPE_ENTITY_DELTA 14  // One obstacle/target added, removed or moved in place
+#define MSG_TYPE_SWARM       15   // Positions of drones 1..NUM_DRONES-1, once per render tick
 
 #define MODE_STANDALONE 1
 #define MODE_NETWORKED  2
+#define MODE_REPLAY     3   // Fed from a trace by exec/replay, no watchdog
 #define MODE_SERVER     1
 #define MODE_CLIENT     2
 
 // NEW: Protocol
-#define NET_PORT 5000
+#define NET_PORT (arp_config.net_port)    // Runtime settings: config.h
+#define NET_MAX_PEERS 8          // Clients accepted by one server (remote drone ids 1..N)
+#define REMOTE_PREDICT_MAX_MS 500 // Dead reckoning horizon: a silent remote drone stops there
 #define ACK_MSG "A"
 #define ACK_LEN 1
 
-#define PERC_OBST            0.005
-#define PERC_TARG            0.001
+#define PERC_OBST            (arp_config.perc_obst)   // Share of the playing field covered
+#define PERC_TARG            (arp_config.perc_targ)
 
 #define LOG_PATH "logs/system.log"
 #define LOG_PATH_SC "logs/server_client.log"
@@ -31,28 +43,124 @@
 // ----- DRONE DYNAMIC -----
 #define M 1
 #define K 10
-#define DT 0.01f
+#define DT (arp_config.dt)
+#define PHYSICS_HZ (arp_config.physics_hz)  // Drone physics steps per second
+#define RENDER_FPS (arp_config.render_fps)  // Drone state updates per second to the Blackboard
+#ifndef NUM_DRONES
+#define NUM_DRONES 1             // Drones stepped by the Drone process (make DRONES=...)
+#endif
 #define MAX_FORCE 10.0f
 // Nota: EPSILON qui ridotto rispetto all'originale
 #define EPSILON 1e-6f
-#define rho 8.0f
-#define eta 5.0f
+#define rho (arp_config.force_rho)
+#define eta (arp_config.force_eta)
 
 #define IP_LEN 64
 extern char server_address[IP_LEN];
 extern int port_number;
 
-// ----- MODEL STRUCTURES -----
+// ----- IPC MESSAGE FORMAT -----
+#define MSG_VERSION      1     // Binary payloads (see msg_codec.h)
+#define MSG_VERSION_TEXT 0     // Legacy printf/sscanf payloads (MSG_TEXT=1 build)
+#define MSG_DATA_LEN     80
+
+/* * Fixed header + payload. Every pipe transfer is exactly sizeof(Message);
+ * obstacle/target arrays still follow the header as a raw Point[] write.
+ */
 typedef struct {
-    int type;
-    char data[80];
+    int type;              // MSG_TYPE_*
+    uint16_t version;      // MSG_VERSION or MSG_VERSION_TEXT
+    uint16_t len;          // Bytes of data[] in use
+    uint32_t seq;          // Per-sender sequence number
+    char data[MSG_DATA_LEN];
 } Message;
 
+// Packed payloads carried in Message.data
+typedef struct __attribute__((packed)) {
+    float x, y;
+} MsgPosition;             // MSG_TYPE_POSITION, MSG_TYPE_DRONE
+
+typedef struct __attribute__((packed)) {
+    float drn_Fx, drn_Fy;
+    float obst_Fx, obst_Fy;
+    float wall_Fx, wall_Fy;
+    float targ_Fx, targ_Fy;
+} MsgForce;                // MSG_TYPE_FORCE
+
+typedef struct __attribute__((packed)) {
+    float x, y;
+    int32_t peer;          // 0: the server (or the only peer), 1..NET_MAX_PEERS: a client
+    float vx, vy;          // Cells per second; absent (12-byte payload) when the peer sent none
+} MsgDrone;                // MSG_TYPE_DRONE from the Network process
+
+typedef struct __attribute__((packed)) {
+    int32_t peer;
+} MsgPeer;                 // MSG_TYPE_PEER_LEFT
+
+typedef struct __attribute__((packed)) {
+    int32_t width, height;
+} MsgSize;                 // MSG_TYPE_SIZE
+
+typedef struct __attribute__((packed)) {
+    int32_t count;         // Point[count] (Motion[count]) follows the Message on the stream
+    uint32_t version;      // Of the array after this snapshot (absent in old traces: 0)
+} MsgEntities;             // MSG_TYPE_OBSTACLES, MSG_TYPE_TARGETS, MSG_TYPE_OBST_MOTION,
+                           // MSG_TYPE_SWARM (MsgPosition[count] follows)
+
+#define ENTITY_ADD    1    // Insert (x, y) at index, shifting the ones after it up
+#define ENTITY_REMOVE 2    // Remove index, shifting the ones after it down
+#define ENTITY_MOVE   3    // Replace index with (x, y)
+
+typedef struct __attribute__((packed)) {
+    int32_t kind;          // MSG_TYPE_OBSTACLES or MSG_TYPE_TARGETS
+    int32_t op;            // ENTITY_*
+    int32_t index;
+    int32_t x, y;
+    uint32_t version;      // Of the array after this delta: applied only on top of version - 1
+} MsgEntityDelta;          // MSG_TYPE_ENTITY_DELTA, no payload after the Message
+
+typedef struct __attribute__((packed)) {
+    char key;
+} MsgInput;                // MSG_TYPE_INPUT
+
+typedef struct __attribute__((packed)) {
+    int32_t steps;
+} MsgTick;                 // MSG_TYPE_TICK
+
+/* * Key press timestamps (CLOCK_MONOTONIC ns), carried by LATENCY=1 builds.
+ * Every stage fills its own field; id 0 means "not stamped".
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t id;
+    int64_t t_input;       // Input: key written
+    int64_t t_bb;          // Blackboard: read and forwarded
+    int64_t t_drone_in;    // Drone: read
+    int64_t t_drone_out;   // Drone: position published
+} MsgLatency;
+
+typedef struct __attribute__((packed)) {
+    char key;
+    MsgLatency lat;
+} MsgInputStamped;         // MSG_TYPE_INPUT with a stamp
+
+typedef struct __attribute__((packed)) {
+    float x, y;
+    MsgLatency lat;
+} MsgPositionEcho;         // MSG_TYPE_POSITION echoing the stamp of a key press
+
+// ----- MODEL STRUCTURES -----
+
 typedef struct {
     int x;
     int y;
 } Point;
 
+// Position (cells) and velocity (cells per wall-clock second) of a moving obstacle
+typedef struct {
+    float x, y;
+    float vx, vy;
+} Motion;
+
 typedef struct {
     float x, y;
     float x_1, x_2;
@@ -19,7 +19,6 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/select.h> 
-#include <sys/file.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
@@ -29,9 +28,29 @@
 #include "app_common.h"
 #include "process_pid.h"
 #include "log.h"
+#include "shm_ipc.h"
+#include "msg_codec.h"
+#include "trace.h"
+#include "reactor.h"
+#include "latency.h"
+#include "entities.h"
+#include "occupancy.h"
+#include "heartbeat.h"
+#include "metrics.h"
 
 #define BUFSZ 256
-#define OBSTACLE_PERIOD_SEC 5
+#define OBSTACLE_PERIOD_SEC (arp_config.obstacle_period_sec)
+#define BB_MAX_FPS (arp_config.bb_fps)  // Redraws are coalesced to at most one per frame
+#define BB_FRAME_NS (1000000000LL / BB_MAX_FPS)
+#define BB_DRONE_DRAIN 256       // Drone messages handled per wake-up before the other fds get a turn
+#define REMOTE_BLEND_NS 200000000LL // Prediction error of a remote drone blended out over 200 ms
+#define REMOTE_SNAP_CELLS 10.0f     // Larger errors (respawn, long outage) are not blended
+
+/* Build option: make RENDER_INCREMENTAL=0 restores the full redraw (werase + every
+ * entity) on each frame. With 1 only the cells that changed are repainted. */
+#ifndef RENDER_INCREMENTAL
+#define RENDER_INCREMENTAL 1
+#endif
 
 /* * Internal Process State Enumeration
  * Used to track what the Blackboard is currently doing for logging and debugging purposes.
@@ -56,25 +75,44 @@ typedef struct {
 /* Global Monitoring Instance */
 static BBMonitor bb_monitor = {STATE_INIT, 0};
 
+/* What each state counts as in the metrics segment (exec/stats) */
+static const MetState met_state_of[] = {
+    [STATE_INIT] = MET_IDLE, [STATE_IDLE] = MET_IDLE, [STATE_PROCESSING_INPUT] = MET_INPUT,
+    [STATE_UPDATING_MAP] = MET_UPDATE, [STATE_RENDERING] = MET_RENDER, [STATE_BROADCASTING] = MET_BROADCAST
+};
+
 /* Global Game Configuration */
 static int current_mode = MODE_STANDALONE;
 static int current_role = 0; // 0 = None, 1 = Server, 2 = Client
+static int headless = 0;     // Null renderer: no ncurses, the field is field_w x field_h
+static int field_w = 0, field_h = 0;      // config field_width x field_height, set in main
 
 /* Timing and Optimization Globals */
-static struct timespec last_obst_change = {0, 0};
 static char last_status[256] = ""; // Caching string to avoid unnecessary redraws
 
 /* Dynamic Game Entities */
 static float current_x = 1.0f, current_y = 1.0f; // Local Drone Coordinates
+static MsgPosition swarm[NUM_DRONES];           // Drones 1..num_swarm of a swarm build (MSG_TYPE_SWARM)
+static int num_swarm = 0;
 static Point *obstacles = NULL;
-static int num_obstacles = 0;
+static int num_obstacles = 0, obstacles_cap = 0;
 static Point *targets = NULL;
-static int num_targets = 0;
+static int num_targets = 0, targets_cap = 0;
+static uint32_t obstacles_version = 0, targets_version = 0; // Stamped on every update sent
+static int drone_needs_snapshot = 0;   // An entity update was dropped on the way to the Drone
 static int target_reached = 0;
 
 /* System Handles */
 static WINDOW *status_win = NULL;
 static pid_t watchdog_pid = -1;
+#if USE_SHM_TRANSPORT
+static ShmWorld *world = NULL;
+static uint32_t last_drone_frame = 0;
+static ShmOutbox outbox_inputs, outbox_entities; // What the rings had no room for yet
+#endif
+#if LATENCY_TRACE
+static LatPath latency;                 // Key press -> screen histograms (LATENCY=1)
+#endif
 
 /* Helper Macros */
 #define BB_LOG_STATE(msg) \
@@ -89,6 +127,7 @@ void reposition_and_redraw(WINDOW **win_ptr, int req_h, int req_w);
 void set_state(BBProcessState new_state) {
     bb_monitor.current_state = new_state;
     bb_monitor.last_state_change = time(NULL);
+    metrics_state(met_state_of[new_state]);
 }
 
 
@@ -101,42 +140,21 @@ void set_state(BBProcessState new_state) {
  */
 
 /*
- * Publishes the current PID to a shared file securely.
+ * Publishes the current PID in its registry slot.
  */
-void publish_my_pid(FILE *fp) {
-    fprintf(fp, "%s %d\n", BB_PID_TAG, getpid());
-    logMessage(LOG_PATH, "[BB] PID published securely");
+void publish_my_pid(void) {
+    if (registry_publish(ROLE_BLACKBOARD) == 0)
+        logMessage(LOG_PATH, "[BB] PID published");
 }
 
 /*
- * Polls the PID file until the Watchdog's PID is found.
+ * Waits for the Watchdog's registry slot (futex wait, no polling).
  * Essential for the handshake process in Standalone mode.
  */
 void wait_for_watchdog_pid() {
-    FILE *fp;
-    char line[256], tag[128];
-    int pid_temp;
-    bool wd_found = false;
-
     logMessage(LOG_PATH, "[BB] Waiting for Watchdog...");
-
-    while (!wd_found) {
-        fp = fopen(PID_FILE_PATH, "r");
-        if (fp) {
-            while (fgets(line, sizeof(line), fp)) {
-                if (sscanf(line, "%s %d", tag, &pid_temp) == 2) {
-                    if (strcmp(tag, WD_PID_TAG) == 0) {
-                        watchdog_pid = (pid_t)pid_temp;
-                        wd_found = true;
-                        break;
-                    }
-                }
-            }
-            fclose(fp);
-        }
-        if (!wd_found) usleep(200000); // Sleep 200ms before retry
-    }
-    logMessage(LOG_PATH, "[BB] Watchdog found (PID %d)", watchdog_pid);
+    watchdog_pid = registry_wait(ROLE_WATCHDOG, -1);
+    if (watchdog_pid > 0) logMessage(LOG_PATH, "[BB] Watchdog found (PID %d)", watchdog_pid);
 }
 
 /*
@@ -165,6 +183,21 @@ WINDOW* create_window(int height, int width, int starty, int startx) {
     return win;
 }
 
+/*
+ * Size of the playing window; headless (win == NULL) the fixed field size.
+ */
+void window_size(WINDOW *win, int *width, int *height) {
+    if (!win) {
+        *width = field_w;
+        *height = field_h;
+        return;
+    }
+    int max_y, max_x;
+    getmaxyx(win, max_y, max_x);
+    *width = max_x;
+    *height = max_y;
+}
+
 void destroy_window(WINDOW *win) {
     if (!win) return;
     werase(win);
@@ -217,36 +250,164 @@ void draw_targets(WINDOW *win) {
     }
 }
 
+// Boundary clamping to keep drone inside the box
+static void drone_cell(int max_x, int max_y, float x, float y, int *ix, int *iy) {
+    *ix = (int)x;
+    *iy = (int)y;
+    if (*ix >= max_x - 1) *ix = max_x - 2;
+    if (*iy >= max_y - 1) *iy = max_y - 2;
+    if (*ix < 1) *ix = 1;
+    if (*iy < 1) *iy = 1;
+}
+
 void draw_drone(WINDOW *win, float x, float y) {
-    int max_y, max_x;
+    int max_y, max_x, ix, iy;
     getmaxyx(win, max_y, max_x);
-
-    int ix = (int)x;
-    int iy = (int)y;
-
-    // Boundary clamping to keep drone inside the box
-    if (ix >= max_x - 1) ix = max_x - 2;
-    if (iy >= max_y - 1) iy = max_y - 2;
-    if (ix < 1) ix = 1;
-    if (iy < 1) iy = 1;
+    drone_cell(max_x, max_y, x, y, &ix, &iy);
 
     wattron(win, COLOR_PAIR(1));
     mvwprintw(win, iy, ix, "+");
     wattroff(win, COLOR_PAIR(1));
 }
 
+// The swarm first: the piloted drone is drawn last, on top of them
+void draw_swarm(WINDOW *win) {
+    for (int i = 0; i < num_swarm; i++) draw_drone(win, swarm[i].x, swarm[i].y);
+}
+
+#if RENDER_INCREMENTAL
+/* * Incremental renderer: a shadow of the window content, one cell per entry
+ * holding (color pair << 8 | character), 0 for blank. Every frame the wanted
+ * cells are rebuilt from the entities, cells that disappeared are blanked and
+ * only cells whose content changed are painted. The border is never touched.
+ */
+typedef struct {
+    int w, h;
+    uint16_t *shown, *wanted;      // [w*h]
+    int *cells, *next_cells;       // Non-blank cells of shown / wanted
+    int ncells, nnext;
+    int valid;                     // 0: next frame starts from a cleared window
+} RenderCache;
+
+static RenderCache rcache = {0};
+
+void render_invalidate(void) {
+    rcache.valid = 0;
+}
+
+static void render_free(void) {
+    free(rcache.shown); free(rcache.wanted);
+    free(rcache.cells); free(rcache.next_cells);
+    memset(&rcache, 0, sizeof(rcache));
+}
+
+static int render_resize(int w, int h) {
+    render_free();
+    size_t n = (size_t)w * h;
+    rcache.shown = calloc(n, sizeof(uint16_t));
+    rcache.wanted = calloc(n, sizeof(uint16_t));
+    rcache.cells = malloc(n * sizeof(int));
+    rcache.next_cells = malloc(n * sizeof(int));
+    if (!rcache.shown || !rcache.wanted || !rcache.cells || !rcache.next_cells) {
+        render_free();
+        return -1;
+    }
+    rcache.w = w;
+    rcache.h = h;
+    return 0;
+}
+
+static void render_want(int x, int y, int pair, char ch) {
+    int idx = y * rcache.w + x;
+    if (!rcache.wanted[idx]) rcache.next_cells[rcache.nnext++] = idx;
+    rcache.wanted[idx] = (uint16_t)((pair << 8) | (unsigned char)ch);
+}
+
+/* * Same cells, order and bounds as draw_targets/draw_obstacles/draw_swarm/draw_drone:
+ * later entities cover earlier ones. Returns -1 if the shadow cannot be allocated.
+ */
+static int render_incremental(WINDOW *win) {
+    int max_y, max_x;
+    getmaxyx(win, max_y, max_x);
+
+    if (!rcache.valid || rcache.w != max_x || rcache.h != max_y) {
+        if (render_resize(max_x, max_y) < 0) return -1;
+        draw_background(win);
+        rcache.valid = 1;
+    }
+
+    if (current_mode != MODE_NETWORKED) {
+        for (int i = 0; i < num_targets; i++) {
+            int tx = targets[i].x, ty = targets[i].y;
+            if (tx > 0 && tx < max_x - 1 && ty > 0 && ty < max_y - 1) {
+                char label[16];
+                int len = snprintf(label, sizeof(label), "%d", i + target_reached);
+                for (int k = 0; k < len && tx + k < max_x - 1; k++) render_want(tx + k, ty, 3, label[k]);
+            }
+        }
+    }
+    for (int i = 0; i < num_obstacles; i++) {
+        int ox = obstacles[i].x, oy = obstacles[i].y;
+        if (ox > 0 && ox < max_x - 1 && oy > 0 && oy < max_y - 1) render_want(ox, oy, 2, 'O');
+    }
+    int ix, iy;
+    for (int i = 0; i < num_swarm; i++) {
+        drone_cell(max_x, max_y, swarm[i].x, swarm[i].y, &ix, &iy);
+        render_want(ix, iy, 1, '+');
+    }
+    drone_cell(max_x, max_y, current_x, current_y, &ix, &iy);
+    render_want(ix, iy, 1, '+');
+
+    // Blank what disappeared, then paint what changed
+    for (int i = 0; i < rcache.ncells; i++) {
+        int idx = rcache.cells[i];
+        if (!rcache.wanted[idx]) {
+            mvwaddch(win, idx / rcache.w, idx % rcache.w, ' ');
+            rcache.shown[idx] = 0;
+        }
+    }
+    for (int i = 0; i < rcache.nnext; i++) {
+        int idx = rcache.next_cells[i];
+        uint16_t cell = rcache.wanted[idx];
+        if (rcache.shown[idx] != cell) {
+            wattron(win, COLOR_PAIR(cell >> 8));
+            mvwaddch(win, idx / rcache.w, idx % rcache.w, (chtype)(cell & 0xff));
+            wattroff(win, COLOR_PAIR(cell >> 8));
+            rcache.shown[idx] = cell;
+        }
+        rcache.wanted[idx] = 0;
+    }
+
+    int *tmp = rcache.cells;
+    rcache.cells = rcache.next_cells;
+    rcache.next_cells = tmp;
+    rcache.ncells = rcache.nnext;
+    rcache.nnext = 0;
+    return 0;
+}
+#else
+void render_invalidate(void) {}
+#endif
+
 /*
  * Master refresh function: Calls all draw sub-routines and refreshes the screen.
  */
 void redraw_scene(WINDOW *win) {
+    if (!win) return; // Headless
     set_state(STATE_RENDERING); 
-    draw_background(win);
-    
-    if(current_mode == MODE_STANDALONE){
-        draw_targets(win);
+#if RENDER_INCREMENTAL
+    if (render_incremental(win) < 0)
+#endif
+    {
+        draw_background(win);
+
+        if(current_mode != MODE_NETWORKED){
+            draw_targets(win);
+        }
+        draw_obstacles(win);
+        draw_swarm(win);
+        draw_drone(win, current_x, current_y);
     }
-    draw_obstacles(win);
-    draw_drone(win, current_x, current_y);
 
     wnoutrefresh(win);
     wnoutrefresh(status_win);
@@ -261,66 +422,64 @@ void redraw_scene(WINDOW *win) {
  * Algorithms for collision detection, random generation of entities, and coordinate checks.
  */
 
-int overlaps_target(int x, int y) {
-    for (int i = 0; i < num_targets; i++) {
-        if (targets[i].x == x && targets[i].y == y) return 1;
+/*
+ * Occupancy of the playing field (standalone/replay): every obstacle and target in
+ * occ_all, the targets alone in occ_targ. Rebuilt when an array is replaced or the
+ * window size changes, patched on every single move.
+ */
+static Occupancy occ_all, occ_targ;
+
+static void occupancy_rebuild(int width, int height) {
+    if (occ_all.width != width || occ_all.height != height) {
+        occ_free(&occ_all);
+        occ_free(&occ_targ);
+        if (occ_init(&occ_all, width, height) < 0 || occ_init(&occ_targ, width, height) < 0) {
+            logMessage(LOG_PATH, "[BB] ERROR: no memory for a %dx%d occupancy map", width, height);
+            occ_free(&occ_all);
+            occ_free(&occ_targ);
+            return;
+        }
+    } else {
+        occ_reset(&occ_all);
+        occ_reset(&occ_targ);
     }
-    return 0;
+    occ_set_points(&occ_all, obstacles, num_obstacles);
+    occ_set_points(&occ_all, targets, num_targets);
+    occ_set_points(&occ_targ, targets, num_targets);
+}
+
+static void occupancy_fit(int width, int height) {
+    if (occ_all.width != width || occ_all.height != height) occupancy_rebuild(width, height);
+}
+
+int overlaps_target(int x, int y) {
+    return occ_test(&occ_targ, x, y);
 }
 
 /*
  * Generates a new position for a specific obstacle index.
- * Ensures no overlap with existing obstacles or targets.
+ * Ensures no overlap with existing obstacles or targets; on a full field it stays put.
  */
 void generate_new_obstacle(int idx, int width, int height) {
-    int valid;
-    do {
-        valid = 1;
-        obstacles[idx].x = rand() % (width - 2) + 1;
-        obstacles[idx].y = rand() % (height - 2) + 1;
-
-        // Check collision with other obstacles
-        for (int i = 0; i < num_obstacles; i++) {
-            if (i != idx && obstacles[idx].x == obstacles[i].x && obstacles[idx].y == obstacles[i].y) {
-                valid = 0; break;
-            }
-        }
-        // Check collision with targets
-        if (valid && overlaps_target(obstacles[idx].x, obstacles[idx].y)) {
-            valid = 0;
-        }
-    } while (!valid);
+    occupancy_fit(width, height);
+    Point p;
+    occ_clear(&occ_all, obstacles[idx].x, obstacles[idx].y);
+    if (occ_pick_free(&occ_all, &p) == 0) obstacles[idx] = p;
+    occ_set(&occ_all, obstacles[idx].x, obstacles[idx].y);
 }
 
 /*
  * Generates a new position for a specific target index.
- * Ensures no overlap with obstacles or other targets.
+ * Ensures no overlap with obstacles or other targets; on a full field it stays put.
  */
 void generate_new_target(int idx, int width, int height) {
-    int valid;
-    do {
-        valid = 1;
-        targets[idx].x = rand() % (width - 2) + 1;
-        targets[idx].y = rand() % (height - 2) + 1;
-
-        // Check collision with Obstacles
-        for (int i = 0; i < num_obstacles; i++) {
-            if (targets[idx].x == obstacles[i].x && targets[idx].y == obstacles[i].y) {
-                valid = 0; break;
-            }
-        }
-
-        // Check collision with other Targets
-        if (valid) {
-            for (int k = 0; k < num_targets; k++) {
-                if (k != idx && targets[k].x == targets[idx].x && targets[k].y == targets[idx].y) {
-                    valid = 0; 
-                    break;
-                }
-            }
-        }
-        
-    } while (!valid);
+    occupancy_fit(width, height);
+    Point p;
+    occ_clear(&occ_all, targets[idx].x, targets[idx].y);
+    occ_clear(&occ_targ, targets[idx].x, targets[idx].y);
+    if (occ_pick_free(&occ_all, &p) == 0) targets[idx] = p;
+    occ_set(&occ_all, targets[idx].x, targets[idx].y);
+    occ_set(&occ_targ, targets[idx].x, targets[idx].y);
 
     logMessage(LOG_PATH, "[BB] New target %d position: %d %d", idx, targets[idx].x, targets[idx].y);
 }
@@ -338,10 +497,20 @@ void update_dynamic(float x, float y, float drn_Fx, float drn_Fy, float obst_Fx,
     if (!status_win) return;
 
     char buffer[256];
+#if LATENCY_TRACE
+    // Shown right after the position so it survives narrow windows
+    char lat[64];
+    lat_path_format(&latency, lat, sizeof(lat));
+    snprintf(buffer, sizeof(buffer),
+        "x=%.4f y=%.4f | %s | drn(%.4f %.4f) | obst(%.4f %.4f) | wall(%.4f %.4f) | targ(%.4f %.4f)",
+        x, y, lat, drn_Fx, drn_Fy, obst_Fx, obst_Fy, wall_Fx, wall_Fy, targ_Fx, targ_Fy
+    );
+#else
     snprintf(buffer, sizeof(buffer),
         "x=%.4f y=%.4f | drn(%.4f %.4f) | obst(%.4f %.4f) | wall(%.4f %.4f) | targ(%.4f %.4f)",
         x, y, drn_Fx, drn_Fy, obst_Fx, obst_Fy, wall_Fx, wall_Fy, targ_Fx, targ_Fy
     );
+#endif
 
     // Only update if the text has actually changed
     if (strcmp(buffer, last_status) != 0) {
@@ -358,7 +527,14 @@ void update_dynamic(float x, float y, float drn_Fx, float drn_Fy, float obst_Fx,
  * If req_h/req_w are 0, it detects terminal size. Otherwise, it forces a specific size (used in networking).
  */
 void reposition_and_redraw(WINDOW **win_ptr, int req_h, int req_w) {
-    
+    if (headless) {
+        if (req_h > 0 && req_w > 0) {
+            field_w = req_w;
+            field_h = req_h;
+        }
+        return;
+    }
+
     // Auto-detect size if arguments are 0
     if (req_h == 0 || req_w == 0) {
         if (is_term_resized(LINES, COLS)) {
@@ -390,6 +566,7 @@ void reposition_and_redraw(WINDOW **win_ptr, int req_h, int req_w) {
 
     werase(status_win);
     box(*win_ptr, 0, 0);
+    render_invalidate(); // The only full redraw in incremental mode
     redraw_scene(*win_ptr);
     logMessage(LOG_PATH, "[BB] Window Resized to: %dx%d", req_w, req_h);
 }
@@ -403,19 +580,128 @@ void reposition_and_redraw(WINDOW **win_ptr, int req_h, int req_w) {
  * via file descriptors (pipes or sockets).
  */
 
+/*
+ * Every message the Blackboard receives or sends the Drone passes through here:
+ * traced (when recording) and counted for the headless benchmark report and the
+ * metrics segment. Input records are raw key bytes, counted as MSG_TYPE_INPUT.
+ */
+static unsigned long long msgs_in, msgs_out;
+
+static void record_msg(TraceSource src, const void *a, size_t alen, const void *b, size_t blen) {
+    int type = (src == TRACE_SRC_INPUT) ? MSG_TYPE_INPUT : ((const Message *)a)->type;
+    if (src == TRACE_SRC_TO_DRONE) {
+        msgs_out++;
+        metrics_msg_out(type);
+    } else {
+        msgs_in++;
+        metrics_msg_in(type);
+    }
+    trace_record(src, a, alen, b, blen);
+}
+
+/*
+ * Sends a Message (plus an optional raw payload, e.g. a Point array) to the Drone.
+ * In SHM mode the record goes into the matching ring and the pipe only carries a wake-up.
+ */
+void send_to_drone(int fd_drone, const Message *msg, const void *payload, size_t len) {
+    record_msg(TRACE_SRC_TO_DRONE, msg, sizeof(*msg), payload, len);
+#if USE_SHM_TRANSPORT
+    if (world) {
+        ShmOutbox *box = (msg->type == MSG_TYPE_OBSTACLES || msg->type == MSG_TYPE_TARGETS ||
+                          msg->type == MSG_TYPE_OBST_MOTION || msg->type == MSG_TYPE_ENTITY_DELTA)
+                         ? &outbox_entities : &outbox_inputs;
+        // A full ring never blocks the loop: the record waits in the outbox
+        int pushed = shm_outbox_send(box, msg, sizeof(*msg), payload, len);
+        if (pushed < 0) {
+            logMessage(LOG_PATH, "[BB] SHM outbox full (%zu bytes), dropped message type %d",
+                       shm_outbox_pending(box), msg->type);
+            if (box == &outbox_entities) drone_needs_snapshot = 1;
+            return;
+        }
+        if (pushed) {
+            char wake = SHM_WAKE_BYTE;
+            metrics_write(fd_drone, &wake, 1);
+        }
+        return;
+    }
+#endif
+    metrics_write(fd_drone, msg, sizeof(*msg));
+    if (len) metrics_write(fd_drone, payload, len);
+}
+
+#if USE_SHM_TRANSPORT
+// Drone wake-up: it took a record, so what the outboxes hold back may fit now
+static void flush_to_drone(int fd_drone) {
+    int pushed = shm_outbox_flush(&outbox_inputs);
+    pushed += shm_outbox_flush(&outbox_entities);
+    if (pushed) {
+        char wake = SHM_WAKE_BYTE;
+        metrics_write(fd_drone, &wake, 1);
+    }
+}
+#endif
+
+/*
+ * Sends a Message (plus an optional payload) to any other process, counted like the Drone's.
+ */
+static void send_to_peer(int fd, const Message *msg, const void *payload, size_t len) {
+    metrics_msg_out(msg->type);
+    metrics_write(fd, msg, sizeof(*msg));
+    if (len) metrics_write(fd, payload, len);
+}
+
+/*
+ * Entity broadcasts. A snapshot replaces the receivers' whole array, a delta patches
+ * one entry in place. Both carry the version the array has after the change, so a
+ * receiver that missed one waits for the next snapshot, and a replayed relocation
+ * the Blackboard already made is not applied twice. fd_drone / fd_peer < 0: skipped.
+ */
+static void send_snapshot(int fd_drone, int fd_peer, int kind) {
+    const Point *pts = (kind == MSG_TYPE_OBSTACLES) ? obstacles : targets;
+    int n = (kind == MSG_TYPE_OBSTACLES) ? num_obstacles : num_targets;
+    Message msg;
+    msg_encode_entities(&msg, kind, n, (kind == MSG_TYPE_OBSTACLES) ? obstacles_version : targets_version);
+
+    if (fd_drone >= 0) send_to_drone(fd_drone, &msg, pts, sizeof(Point) * n);
+    if (fd_peer >= 0) send_to_peer(fd_peer, &msg, pts, sizeof(Point) * n);
+}
+
+// After pts[index] was added, moved (or removed) locally
+static void send_delta(int fd_drone, int fd_peer, int kind, int op, int index) {
+    const Point *pts = (kind == MSG_TYPE_OBSTACLES) ? obstacles : targets;
+    uint32_t *version = (kind == MSG_TYPE_OBSTACLES) ? &obstacles_version : &targets_version;
+    MsgEntityDelta d = { kind, op, index, 0, 0, ++*version };
+    if (op != ENTITY_REMOVE) {
+        d.x = pts[index].x;
+        d.y = pts[index].y;
+    }
+    Message msg;
+    msg_encode_entity_delta(&msg, &d);
+
+    if (fd_drone >= 0) {
+        if (drone_needs_snapshot) {
+            drone_needs_snapshot = 0;
+            send_snapshot(fd_drone, -1, MSG_TYPE_OBSTACLES);
+            send_snapshot(fd_drone, -1, MSG_TYPE_TARGETS);
+        } else {
+            send_to_drone(fd_drone, &msg, NULL, 0);
+        }
+    }
+    if (fd_peer >= 0) send_to_peer(fd_peer, &msg, NULL, 0);
+}
+
 void send_window_size(WINDOW *win, int fd_drone, int fd_obst, int fd_targ) {
     set_state(STATE_BROADCASTING);
     Message msg;
     int max_y, max_x;
-    getmaxyx(win, max_y, max_x);
+    window_size(win, &max_x, &max_y);
 
-    msg.type = MSG_TYPE_SIZE;
-    snprintf(msg.data, sizeof(msg.data), "%d %d", max_x, max_y);
+    msg_encode_size(&msg, max_x, max_y);
 
-    write(fd_drone, &msg, sizeof(msg));
+    send_to_drone(fd_drone, &msg, NULL, 0);
     if(current_mode == MODE_STANDALONE){
-        write(fd_obst,  &msg, sizeof(msg));
-        write(fd_targ,  &msg, sizeof(msg));
+        send_to_peer(fd_obst, &msg, NULL, 0);
+        send_to_peer(fd_targ, &msg, NULL, 0);
     }
 }
 
@@ -424,71 +710,747 @@ void send_window_size_network(WINDOW *win, int fd_network) {
     set_state(STATE_BROADCASTING); 
     Message msg;
     int max_y, max_x;
-    getmaxyx(win, max_y, max_x);
+    window_size(win, &max_x, &max_y);
 
-    msg.type = MSG_TYPE_SIZE;
-    snprintf(msg.data, sizeof(msg.data), "%d %d", max_x, max_y);
-    write(fd_network, &msg, sizeof(msg));
+    msg_encode_size(&msg, max_x, max_y);
+    send_to_peer(fd_network, &msg, NULL, 0);
 }
 
 void send_drone_position_network(float x, float y, int fd_network) {
     if (fd_network < 0) return;
     Message net_msg;
-    net_msg.type = MSG_TYPE_POSITION; 
-    snprintf(net_msg.data, sizeof(net_msg.data), "%f %f", x, y);
-    write(fd_network, &net_msg, sizeof(net_msg));
+    msg_encode_position(&net_msg, MSG_TYPE_POSITION, x, y);
+    send_to_peer(fd_network, &net_msg, NULL, 0);
 }
 
 void send_resize(WINDOW *win, int fd_drone) {
     set_state(STATE_BROADCASTING);
     Message msg;
     int max_y, max_x;
-    getmaxyx(win, max_y, max_x);
-    msg.type = MSG_TYPE_SIZE;
-    snprintf(msg.data, sizeof(msg.data), "%d %d", max_x, max_y);
-    write(fd_drone, &msg, sizeof(msg));
+    window_size(win, &max_x, &max_y);
+    msg_encode_size(&msg, max_x, max_y);
+    send_to_drone(fd_drone, &msg, NULL, 0);
 }
 
 
 /*
  * ======================================================================================
- * MACRO-SECTION 8: MAIN EXECUTION
+ * MACRO-SECTION 8: EVENT HANDLERS
+ * ======================================================================================
+ * One handler per registered fd (keyboard, Input, Drone, Obstacle, Target, Network)
+ * plus the obstacle relocation and frame timers. The reactor only calls them
+ * when their fd is ready, so the process sleeps whenever there is nothing to do.
+ */
+
+/* * Remote drone (networked mode), dead reckoned: drawn at its newest sample moved
+ * along its velocity, for up to REMOTE_PREDICT_MAX_MS, so it keeps moving between
+ * network frames. The error of the previous prediction at each new sample is
+ * blended out over REMOTE_BLEND_NS instead of making it jump. Peers that send no
+ * velocity get one from their last two samples. One track per peer id
+ * (0: our server, 1..NET_MAX_PEERS: the other clients of the session).
+ */
+typedef struct {
+    float x, y, vx, vy;            // Newest sample (cells, cells/s)
+    float ex, ey;                  // Prediction error at its arrival, still to blend out
+    long long t;                   // Its arrival (CLOCK_MONOTONIC ns)
+    int samples;                   // 0: no such peer
+} RemoteTrack;
+
+/* * Blackboard runtime context shared by all handlers.
+ */
+typedef struct {
+    Reactor reactor;
+    WINDOW *win;
+    int fd_input_read, fd_drone_read, fd_drone_write;
+    int fd_obst_write, fd_obst_read, fd_targ_write, fd_targ_read;
+    int fd_wd_write, fd_network_write, fd_network_read;
+    int fd_obst_timer;             // Obstacle relocation, every OBSTACLE_PERIOD_SEC
+    int fd_hb_timer;               // Heartbeats (HEARTBEAT=1 standalone), -1 otherwise
+    int fd_frame_timer;            // One-shot, armed when the scene changes
+    int frame_pending;
+    struct timespec last_frame;
+    MsgForce forces;
+    RemoteTrack remote[NET_MAX_PEERS + 1];
+    unsigned remote_moving;        // Tracks (bit per peer id) the Drone was told are moving
+    int motion_dirty;              // A new sample: the Drone needs the new velocities
+    MsgLatency lat_pending;        // Echoed key press waiting for its frame (id 0: none)
+    long long lat_position_ns;     // When its position arrived
+    // Frame pacer statistics: a position replaced before any frame showed it is coalesced
+    unsigned long long frames, positions, coalesced;
+    long long unshown_ns;          // Arrival of the newest position no frame has shown yet, 0: none
+    long long worst_lag_ns;        // Longest arrival -> frame delay of a shown position
+    unsigned long long late_frames; // Frames that showed their position more than a frame period late
+    int met_frames, met_late, met_positions, met_coalesced; // Their metrics counters (exec/stats)
+    int quit;
+} BBContext;
+
+static long long elapsed_ns(struct timespec from, struct timespec to) {
+    return (to.tv_sec - from.tv_sec) * 1000000000LL + (to.tv_nsec - from.tv_nsec);
+}
+
+static long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+void request_frame(BBContext *ctx);
+
+static int remote_extrapolating(const RemoteTrack *r, long long now) {
+    return (r->vx != 0.0f || r->vy != 0.0f) && now - r->t < REMOTE_PREDICT_MAX_MS * 1000000LL;
+}
+
+static void remote_predict(const RemoteTrack *r, long long now, float *x, float *y) {
+    long long age = now - r->t;
+    long long horizon = REMOTE_PREDICT_MAX_MS * 1000000LL;
+    float dt = (float)((age < horizon) ? age : horizon) / 1e9f;
+    float blend = (age < REMOTE_BLEND_NS) ? 1.0f - (float)age / (float)REMOTE_BLEND_NS : 0.0f;
+    *x = r->x + r->vx * dt + r->ex * blend;
+    *y = r->y + r->vy * dt + r->ey * blend;
+}
+
+static void remote_sample(RemoteTrack *r, float x, float y, const float *vel) {
+    long long now = now_ns();
+    float px = x, py = y;
+    if (r->samples) remote_predict(r, now, &px, &py);
+
+    if (vel) {
+        r->vx = vel[0];
+        r->vy = vel[1];
+    } else if (r->samples && now > r->t) {
+        float dt = (float)(now - r->t) / 1e9f;
+        r->vx = (x - r->x) / dt;
+        r->vy = (y - r->y) / dt;
+    } else {
+        r->vx = r->vy = 0.0f;
+    }
+
+    // Start from where it was drawn and converge on the new prediction
+    r->ex = px - x;
+    r->ey = py - y;
+    if (fabsf(r->ex) > REMOTE_SNAP_CELLS || fabsf(r->ey) > REMOTE_SNAP_CELLS) r->ex = r->ey = 0.0f;
+    r->x = x;
+    r->y = y;
+    r->t = now;
+    r->samples = 1;
+}
+
+/* * Predicted cell of one track, clamped to the window, and the motion the Drone
+ * extrapolates from. Returns 1 while the drawn position still changes.
+ */
+static int remote_cell(const BBContext *ctx, const RemoteTrack *r, long long now, Point *p, Motion *m) {
+    float x, y;
+    remote_predict(r, now, &x, &y);
+
+    // Clamp values within bounds
+    int max_y, max_x;
+    window_size(ctx->win, &max_x, &max_y);
+    if(x >= max_x) x = max_x - 1;
+    if(y >= max_y - 1) y = max_y - 2;
+    if(x < 1) x = 1;
+    if(y < 1) y = 1;
+    p->x = (int)x; p->y = (int)y;
+
+    int extrapolating = remote_extrapolating(r, now);
+    m->x = x; m->y = y;
+    m->vx = extrapolating ? r->vx : 0.0f;
+    m->vy = extrapolating ? r->vy : 0.0f;
+    return extrapolating || ((r->ex != 0.0f || r->ey != 0.0f) && now - r->t < REMOTE_BLEND_NS);
+}
+
+/*
+ * Rebuilds the obstacle list from the remote drones, in peer id order; the Drone is
+ * only told when a cell changes or a peer comes or goes. It extrapolates them by
+ * itself between those updates, so it also gets their motion on every new sample
+ * and when one stops. Returns 1 while any of them is still moving on screen.
+ */
+static int remote_update(BBContext *ctx) {
+    Point cells[NET_MAX_PEERS + 1];
+    Motion motion[NET_MAX_PEERS + 1];
+    long long now = now_ns();
+    int n = 0, moving = 0;
+    unsigned extrapolating = 0;
+
+    for (int i = 0; i <= NET_MAX_PEERS; i++) {
+        if (ctx->remote[i].samples == 0) continue;
+        moving |= remote_cell(ctx, &ctx->remote[i], now, &cells[n], &motion[n]);
+        if (remote_extrapolating(&ctx->remote[i], now)) extrapolating |= 1u << i;
+        n++;
+    }
+
+    int changed = (n != num_obstacles || (n && memcmp(obstacles, cells, sizeof(Point) * n) != 0));
+    if (changed) {
+        // Notify local drone about the "obstacles" (remote drones): moved cells only,
+        // the whole list when a peer came or went
+        if (n == num_obstacles) {
+            for (int i = 0; i < n; i++) {
+                if (obstacles[i].x == cells[i].x && obstacles[i].y == cells[i].y) continue;
+                obstacles[i] = cells[i];
+                send_delta(ctx->fd_drone_write, -1, MSG_TYPE_OBSTACLES, ENTITY_MOVE, i);
+            }
+        } else {
+            if (entities_reserve(&obstacles, &obstacles_cap, n) < 0) return moving;
+            num_obstacles = n;
+            if (n) memcpy(obstacles, cells, sizeof(Point) * n);
+            obstacles_version++;
+            send_snapshot(ctx->fd_drone_write, -1, MSG_TYPE_OBSTACLES);
+        }
+        request_frame(ctx);
+    }
+
+    if (changed || ctx->motion_dirty || extrapolating != ctx->remote_moving) {
+        Message out_msg;
+        msg_encode_entities(&out_msg, MSG_TYPE_OBST_MOTION, n, obstacles_version);
+        send_to_drone(ctx->fd_drone_write, &out_msg, motion, sizeof(Motion) * n);
+        ctx->remote_moving = extrapolating;
+        ctx->motion_dirty = 0;
+    }
+    return moving;
+}
+
+/*
+ * Schedules a redraw: at once if the last frame is older than the frame period,
+ * otherwise when the period expires. Changes arriving meanwhile share that frame.
+ */
+void request_frame(BBContext *ctx) {
+    if (ctx->frame_pending) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long wait_ns = BB_FRAME_NS - elapsed_ns(ctx->last_frame, now);
+    if (wait_ns < 1) wait_ns = 1; // 0 would disarm the timer
+
+    reactor_timer_arm(ctx->fd_frame_timer, wait_ns, 0);
+    ctx->frame_pending = 1;
+}
+
+// Stops watching an fd whose writer is gone (it would stay readable forever)
+static void drop_fd(BBContext *ctx, int fd, const char *name) {
+    reactor_del(&ctx->reactor, fd);
+    logMessage(LOG_PATH, "[BB] %s channel closed", name);
+}
+
+static void on_frame_timer(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    reactor_timer_drain(fd);
+    // Still pending: a change it finds joins this frame
+    int moving = (current_mode == MODE_NETWORKED) ? remote_update(ctx) : 0;
+    ctx->frame_pending = 0;
+    clock_gettime(CLOCK_MONOTONIC, &ctx->last_frame);
+    redraw_scene(ctx->win);
+    ctx->frames++;
+    if (ctx->unshown_ns) {
+        long long lag = now_ns() - ctx->unshown_ns;
+        if (lag > ctx->worst_lag_ns) ctx->worst_lag_ns = lag;
+        if (lag > BB_FRAME_NS) ctx->late_frames++;
+        ctx->unshown_ns = 0;
+    }
+    if (moving) request_frame(ctx); // Keep animating while a remote drone is predicted to move
+
+#if LATENCY_TRACE
+    if (ctx->lat_pending.id) {
+        lat_path_record(&latency, &ctx->lat_pending, ctx->lat_position_ns, latency_now_ns());
+        ctx->lat_pending.id = 0;
+    }
+#endif
+}
+
+/*
+ * Local keyboard (ncurses stdin). Also called after a signal interrupted the
+ * wait, since that is how SIGWINCH surfaces as KEY_RESIZE.
+ */
+static void on_keyboard(int fd, uint32_t events, void *arg) {
+    (void)fd; (void)events;
+    BBContext *ctx = arg;
+    int ch;
+    while ((ch = getch()) != ERR) {
+        set_state(STATE_PROCESSING_INPUT);
+        if (ch == 'q') {
+            ctx->quit = 1;
+            return;
+        }
+        if (ch == KEY_RESIZE) {
+            reposition_and_redraw(&ctx->win, 0, 0);
+            send_resize(ctx->win, ctx->fd_drone_write);
+        }
+    }
+}
+
+#if USE_HEARTBEAT
+/*
+ * The loop can sleep in epoll for seconds: a timer in the same loop keeps the
+ * Watchdog's heartbeats coming, and stops them if a handler blocks.
+ */
+static void on_heartbeat_timer(int fd, uint32_t events, void *arg) {
+    (void)events; (void)arg;
+    reactor_timer_drain(fd);
+    hb_beat();
+}
+#endif
+
+/*
+ * Periodic obstacle relocation (standalone): one random obstacle moves.
+ */
+static void on_obstacle_timer(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    reactor_timer_drain(fd);
+    if (num_obstacles <= 0) return;
+
+    set_state(STATE_UPDATING_MAP);
+    int idx = rand() % num_obstacles;
+    int max_y, max_x;
+    window_size(ctx->win, &max_x, &max_y);
+    generate_new_obstacle(idx, max_x, max_y);
+
+    request_frame(ctx);
+
+    // Broadcast update: the Target process keeps its copy current for the next round
+    set_state(STATE_BROADCASTING);
+    send_delta(ctx->fd_drone_write, ctx->fd_targ_write, MSG_TYPE_OBSTACLES, ENTITY_MOVE, idx);
+}
+
+/*
+ * Input process: key presses are forwarded to the Drone, 'q' quits everyone.
+ */
+static void on_input(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    set_state(STATE_PROCESSING_INPUT);
+
+    char buf[sizeof(Message)];
+    ssize_t n = metrics_read(fd, buf, sizeof(buf));
+    if (n == 0) { drop_fd(ctx, fd, "Input"); return; }
+    if (n < 0) return;
+
+    record_msg(TRACE_SRC_INPUT, buf, n, NULL, 0);
+    char key;
+    MsgLatency lat;
+    if (msg_decode_input_record(buf, (size_t)n, &key, &lat) < 0) return;
+    if (key == 'q'){
+        // Handle Quit Sequence
+        Message quit_msg;
+        msg_encode_exit(&quit_msg);
+        if(current_mode != MODE_NETWORKED){
+            send_to_peer(ctx->fd_wd_write, &quit_msg, NULL, 0);
+            send_to_drone(ctx->fd_drone_write, &quit_msg, NULL, 0);
+            send_to_peer(ctx->fd_obst_write, &quit_msg, NULL, 0);
+            send_to_peer(ctx->fd_targ_write, &quit_msg, NULL, 0);
+        }
+        else{
+            send_to_drone(ctx->fd_drone_write, &quit_msg, NULL, 0);
+            send_to_peer(ctx->fd_network_write, &quit_msg, NULL, 0);
+        }
+        ctx->quit = 1;
+        return;
+    }
+    logMessage(LOG_PATH_SC, "[BB] Input received: %c", key);
+
+    // Forward keypress to Drone Process (a replayed stamp is stale, drop it)
+    Message msg;
+    if (lat.id && current_mode != MODE_REPLAY) {
+        lat.t_bb = latency_now_ns();
+        msg_encode_input_stamped(&msg, key, &lat);
+    } else {
+        msg_encode_input(&msg, key);
+    }
+    send_to_drone(ctx->fd_drone_write, &msg, NULL, 0);
+}
+
+/*
+ * Network process: the remote drones are shown, and sent to the Drone, as obstacles.
+ */
+static void on_network(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    Message msg;
+
+    ssize_t n = metrics_read(fd, &msg, sizeof(Message));
+    if (n == 0) { drop_fd(ctx, fd, "Network"); return; }
+    if (n < 0) return;
+
+    record_msg(TRACE_SRC_NETWORK, &msg, sizeof(msg), NULL, 0);
+    switch(msg.type){
+        case MSG_TYPE_DRONE: {
+            // Receiving remote drone position, treating it as an obstacle locally
+            float remote_x, remote_y, vel[2];
+            int peer, has_vel;
+            if (msg_decode_drone(&msg, &peer, &remote_x, &remote_y, vel, &has_vel) == 0 &&
+                peer >= 0 && peer <= NET_MAX_PEERS) {
+                remote_sample(&ctx->remote[peer], remote_x, remote_y, has_vel ? vel : NULL);
+                ctx->motion_dirty = 1;
+                if (remote_update(ctx)) request_frame(ctx);
+            }
+            break;
+        }
+        case MSG_TYPE_PEER_LEFT: {
+            int peer;
+            if (msg_decode_peer_left(&msg, &peer) == 0 && peer >= 0 && peer <= NET_MAX_PEERS) {
+                logMessage(LOG_PATH, "[BB] Remote drone %d left", peer);
+                ctx->remote[peer].samples = 0;
+                remote_update(ctx);
+            }
+            break;
+        }
+        default: break;
+    }
+}
+
+/*
+ * Standalone/Replay: target collection logic on a new drone position.
+ */
+static void check_targets(BBContext *ctx) {
+    int dx = (int)current_x;
+    int dy = (int)current_y;
+
+    for (int i = 0; i < num_targets; i++) {
+        if (dx == (int)targets[i].x && dy == (int)targets[i].y) {
+
+            // Logic for Sequential Target Collection
+            if(i == 0){
+                logMessage(LOG_PATH, "[BB] Expected target reached");
+                // Shift array (remove target 0)
+                occ_clear(&occ_all, targets[i].x, targets[i].y);
+                occ_clear(&occ_targ, targets[i].x, targets[i].y);
+                for (int j = i; j < num_targets - 1; j++) targets[j] = targets[j + 1];
+                target_reached++;
+                num_targets--;
+
+                // Broadcast the removal
+                set_state(STATE_BROADCASTING);
+                send_delta(ctx->fd_drone_write, ctx->fd_obst_write, MSG_TYPE_TARGETS, ENTITY_REMOVE, i);
+            }
+            else if(i != 0){
+                // Wrong target hit: Respawn it elsewhere
+                logMessage(LOG_PATH, "[BB] Not expected target reached");
+                int max_y, max_x;
+                window_size(ctx->win, &max_x, &max_y);
+                generate_new_target(i, max_x, max_y);
+
+                set_state(STATE_BROADCASTING);
+                send_delta(ctx->fd_drone_write, ctx->fd_obst_write, MSG_TYPE_TARGETS, ENTITY_MOVE, i);
+            }
+
+
+            // Win Condition
+            if (num_targets == 0) {
+                logMessage(LOG_PATH, "[BB] ALL TARGETS CLEARED");
+                // An obstacle snapshot asks the Target process for a new round
+                send_snapshot(-1, ctx->fd_targ_write, MSG_TYPE_OBSTACLES);
+            }
+            break;
+        }
+    }
+}
+
+// A new drone position: counted for the pacer, checked against the targets
+static void drone_position(BBContext *ctx, unsigned superseded) {
+    ctx->positions += 1 + superseded;
+    ctx->coalesced += superseded;
+    if (ctx->unshown_ns) ctx->coalesced++;
+    ctx->unshown_ns = now_ns();
+
+    // Standalone/Replay Mode: Check Collisions with Targets
+    if (current_mode != MODE_NETWORKED) check_targets(ctx);
+}
+
+// Reads past a payload that cannot be used, so the next read starts on a Message
+static int skip_payload(int fd, size_t len) {
+    char scratch[256];
+    while (len > 0) {
+        size_t k = (len < sizeof(scratch)) ? len : sizeof(scratch);
+        if (read_full(metrics_read, fd, scratch, k) < 0) return -1;
+        len -= k;
+    }
+    return 0;
+}
+
+/*
+ * Drone process: position (redraw, network forward, target check) and forces (status bar).
+ * Everything pending is drained on each wake-up: every position is checked against
+ * the targets, but only the newest one and the newest forces reach the screen and
+ * the network, with the next frame.
+ */
+static void on_drone(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    set_state(STATE_UPDATING_MAP);
+    int got_position = 0, got_forces = 0;
+    Message msg;
+    MsgLatency echo;
+    echo.id = 0;
+
+#if USE_SHM_TRANSPORT
+    if (world) {
+        // Pipe carries only wake-ups: drain them and read the seqlock block
+        char wake[64];
+        if (metrics_read(fd, wake, sizeof(wake)) == 0) { drop_fd(ctx, fd, "Drone"); return; }
+        flush_to_drone(ctx->fd_drone_write);
+        uint32_t prev_frame = last_drone_frame;
+        if (shm_drone_read(&world->drone, &current_x, &current_y, &ctx->forces, &echo, &last_drone_frame)) {
+            got_position = got_forces = 1;
+            // The block only holds the newest state: the frames in between were overwritten
+            drone_position(ctx, prev_frame ? last_drone_frame - prev_frame - 1 : 0);
+
+            // Traces always hold Messages, whatever the transport
+            Message rec;
+            if (echo.id) msg_encode_position_echo(&rec, current_x, current_y, &echo);
+            else msg_encode_position(&rec, MSG_TYPE_POSITION, current_x, current_y);
+            record_msg(TRACE_SRC_DRONE, &rec, sizeof(rec), NULL, 0);
+            msg_encode_forces(&rec, &ctx->forces);
+            record_msg(TRACE_SRC_DRONE, &rec, sizeof(rec), NULL, 0);
+        }
+    } else
+#endif
+    for (int drained = 0, synced = 1; synced && drained < BB_DRONE_DRAIN; drained++) {
+        ssize_t n = metrics_read(fd, &msg, sizeof(msg));
+        if (n == 0) { drop_fd(ctx, fd, "Drone"); break; }
+        if (n < 0) break; // EAGAIN: the pipe is empty
+        if (msg.type != MSG_TYPE_SWARM) record_msg(TRACE_SRC_DRONE, &msg, sizeof(msg), NULL, 0);
+        switch (msg.type) {
+        case MSG_TYPE_POSITION: {
+            MsgLatency e;
+            if (msg_decode_position(&msg, &current_x, &current_y) < 0) break;
+            got_position = 1;
+            // Keys share the frame: the first echoed one in this batch is timed
+            if (!echo.id && msg_decode_latency(&msg, &e) == 0) echo = e;
+            drone_position(ctx, 0);
+            break;
+        }
+        case MSG_TYPE_FORCE:
+            got_forces |= (msg_decode_forces(&msg, &ctx->forces) == 0);
+            break;
+        case MSG_TYPE_SWARM: {
+            // Recorded with its positions; the piloted drone's POSITION drives the rest
+            int count = 0;
+            if (msg_decode_entities(&msg, &count, NULL) < 0) {
+                // No count: there is no telling where the next Message starts
+                logMessage(LOG_PATH, "[BB] Undecodable SWARM header, Drone stream out of sync");
+                synced = 0;
+                break;
+            }
+            if (count > NUM_DRONES - 1) {
+                // A Drone built with another DRONES=: its positions are read and dropped
+                logMessage(LOG_PATH, "[BB] SWARM of %d drones rejected, built for %d", count, NUM_DRONES);
+                num_swarm = 0;
+                if (skip_payload(fd, sizeof(MsgPosition) * (size_t)count) < 0) synced = 0;
+                break;
+            }
+            if (read_full(metrics_read, fd, swarm, sizeof(MsgPosition) * count) < 0) {
+                logMessage(LOG_PATH, "[BB] SWARM payload of %d drones lost", count);
+                num_swarm = 0;
+                synced = 0;
+                break;
+            }
+            num_swarm = count;
+            record_msg(TRACE_SRC_DRONE, &msg, sizeof(msg), swarm, sizeof(MsgPosition) * count);
+            request_frame(ctx);
+            break;
+        }
+        default: break;
+        }
+        if (!synced) drop_fd(ctx, fd, "Drone");
+    }
+
+    if (got_position) {
+        request_frame(ctx);
+
+#if LATENCY_TRACE
+        // The key press is on screen with the frame just requested (one key per frame)
+        if (echo.id && !ctx->lat_pending.id && current_mode != MODE_REPLAY) {
+            ctx->lat_pending = echo;
+            ctx->lat_position_ns = latency_now_ns();
+        }
+#endif
+
+        // Forward position to network if applicable
+        if (current_mode == MODE_NETWORKED) {
+            send_drone_position_network(current_x, current_y, ctx->fd_network_write);
+        }
+    }
+
+    // Update force values for the UI status bar
+    if (got_forces) {
+        const MsgForce *f = &ctx->forces;
+        update_dynamic(current_x, current_y, f->drn_Fx, f->drn_Fy, f->obst_Fx, f->obst_Fy,
+                       f->wall_Fx, f->wall_Fy, f->targ_Fx, f->targ_Fy);
+    }
+}
+
+/*
+ * Replay: a recorded delta, routed here like the arrays. Relayed on when it is new
+ * to the Blackboard; its own relocations in the replay already made the others.
+ */
+static void on_entity_delta(BBContext *ctx, const Message *msg, int kind, int fd_peer) {
+    MsgEntityDelta d;
+    if (msg_decode_entity_delta(msg, &d) < 0 || d.kind != kind) return;
+    record_msg(kind == MSG_TYPE_OBSTACLES ? TRACE_SRC_OBSTACLE : TRACE_SRC_TARGET,
+                 msg, sizeof(*msg), NULL, 0);
+
+    int r = (kind == MSG_TYPE_OBSTACLES)
+            ? entities_apply(&obstacles, &num_obstacles, &obstacles_cap, &obstacles_version, &d)
+            : entities_apply(&targets, &num_targets, &targets_cap, &targets_version, &d);
+    if (r < 0) logMessage(LOG_PATH, "[BB] Entity delta (version %u) rejected", d.version);
+    if (r <= 0) return;
+
+    int max_y, max_x;
+    window_size(ctx->win, &max_x, &max_y);
+    occupancy_rebuild(max_x, max_y);
+
+    set_state(STATE_BROADCASTING);
+    send_to_drone(ctx->fd_drone_write, msg, NULL, 0);
+    send_to_peer(fd_peer, msg, NULL, 0);
+}
+
+/*
+ * Obstacle process: new array, distributed to the Drone and Target processes.
+ */
+static void on_obstacles(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    set_state(STATE_UPDATING_MAP);
+    Message msg;
+
+    ssize_t n = metrics_read(fd, &msg, sizeof(msg));
+    if (n == 0) { drop_fd(ctx, fd, "Obstacle"); return; }
+    if (n < 0) return;
+    if (msg.type == MSG_TYPE_ENTITY_DELTA) {
+        on_entity_delta(ctx, &msg, MSG_TYPE_OBSTACLES, ctx->fd_targ_write);
+        request_frame(ctx);
+        return;
+    }
+    if (msg.type != MSG_TYPE_OBSTACLES) return;
+
+    int count = 0;
+    msg_decode_entities(&msg, &count, NULL);
+    if (count > 0) {
+        if (entities_read(metrics_read, fd, &obstacles, &obstacles_cap, count) < 0) {
+            // Half an array is worse than none: an empty one goes out until the next snapshot
+            logMessage(LOG_PATH, "[BB] ERROR: snapshot of %d obstacles lost", count);
+            count = 0;
+            msg_encode_entities(&msg, MSG_TYPE_OBSTACLES, 0, 0);
+        }
+        num_obstacles = count;
+        obstacles_version++;
+        int max_y, max_x;
+        window_size(ctx->win, &max_x, &max_y);
+        occupancy_rebuild(max_x, max_y);
+        record_msg(TRACE_SRC_OBSTACLE, &msg, sizeof(msg), obstacles, sizeof(Point) * count);
+
+        logMessage(LOG_PATH, "[BB] received %d obstacles", num_obstacles);
+
+        // Distribute obstacles to Drone & Target Processes
+        set_state(STATE_BROADCASTING);
+        send_snapshot(ctx->fd_drone_write, ctx->fd_targ_write, MSG_TYPE_OBSTACLES);
+    }
+    request_frame(ctx);
+}
+
+/*
+ * Target process: new array, distributed to the Drone and Obstacle processes.
+ */
+static void on_targets(int fd, uint32_t events, void *arg) {
+    (void)events;
+    BBContext *ctx = arg;
+    set_state(STATE_UPDATING_MAP);
+    Message msg;
+
+    ssize_t n = metrics_read(fd, &msg, sizeof(msg));
+    if (n == 0) { drop_fd(ctx, fd, "Target"); return; }
+    if (n < 0) return;
+    if (msg.type == MSG_TYPE_ENTITY_DELTA) {
+        on_entity_delta(ctx, &msg, MSG_TYPE_TARGETS, ctx->fd_obst_write);
+        request_frame(ctx);
+        return;
+    }
+    if (msg.type != MSG_TYPE_TARGETS) return;
+
+    int count = 0;
+    msg_decode_entities(&msg, &count, NULL);
+    if (count > 0) {
+        if (entities_read(metrics_read, fd, &targets, &targets_cap, count) < 0) {
+            // Half an array is worse than none: an empty one goes out until the next snapshot
+            logMessage(LOG_PATH, "[BB] ERROR: snapshot of %d targets lost", count);
+            count = 0;
+            msg_encode_entities(&msg, MSG_TYPE_TARGETS, 0, 0);
+        }
+        num_targets = count;
+        targets_version++;
+        int max_y, max_x;
+        window_size(ctx->win, &max_x, &max_y);
+        occupancy_rebuild(max_x, max_y);
+        record_msg(TRACE_SRC_TARGET, &msg, sizeof(msg), targets, sizeof(Point) * count);
+
+        // Distribute targets to Drone & Obstacle Processes
+        set_state(STATE_BROADCASTING);
+        send_snapshot(ctx->fd_drone_write, ctx->fd_obst_write, MSG_TYPE_TARGETS);
+    }
+    request_frame(ctx);
+}
+
+
+/*
+ * ======================================================================================
+ * MACRO-SECTION 9: MAIN EXECUTION
  * ======================================================================================
  * Entry point. Handles Argument Parsing, Watchdog Synchronization, Ncurses Init,
- * and the main Event Loop (Select Multiplexing).
+ * handler registration and the main Event Loop (epoll reactor).
  */
 
 int main(int argc, char *argv[]) {
-    
+
     // --- ARGUMENT PARSING ---
     if (argc < 14) {
         fprintf(stderr, "[BB] Error: Needed 13 arguments, received %d\n", argc-1);
         return 1;
     }
-
-    int fd_input_read  = atoi(argv[1]);
-    int fd_drone_read  = atoi(argv[2]);
-    int fd_drone_write = atoi(argv[3]);
-    int fd_obst_write  = atoi(argv[4]);
-    int fd_obst_read   = atoi(argv[5]);
-    int fd_targ_write  = atoi(argv[6]);
-    int fd_targ_read   = atoi(argv[7]);
-    int fd_wd_write    = atoi(argv[8]);
+    config_from_env();
+    field_w = arp_config.field_width;
+    field_h = arp_config.field_height;
+
+    BBContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fd_input_read  = atoi(argv[1]);
+    ctx.fd_drone_read  = atoi(argv[2]);
+    ctx.fd_drone_write = atoi(argv[3]);
+    ctx.fd_obst_write  = atoi(argv[4]);
+    ctx.fd_obst_read   = atoi(argv[5]);
+    ctx.fd_targ_write  = atoi(argv[6]);
+    ctx.fd_targ_read   = atoi(argv[7]);
+    ctx.fd_wd_write    = atoi(argv[8]);
     current_mode = atoi(argv[9]);
     if (argv[10]) {
         strncpy(server_address, argv[10], sizeof(server_address) - 1);
         server_address[sizeof(server_address) - 1] = '\0';
     }
-    int fd_network_write = atoi(argv[11]);
-    int fd_network_read = atoi(argv[12]);
+    ctx.fd_network_write = atoi(argv[11]);
+    ctx.fd_network_read = atoi(argv[12]);
     current_role = atoi(argv[13]);
+    headless = (argc > 14 && strcmp(argv[14], "headless") == 0);
 
-    logMessage(LOG_PATH, "[BB] FDs: input=%d drone=%d obst=%d target=%d wd=%d network=%d", 
-    fd_input_read, fd_drone_read, fd_obst_write, fd_targ_write, fd_wd_write, fd_network_read);
+    logMessage(LOG_PATH, "[BB] FDs: input=%d drone=%d obst=%d target=%d wd=%d network=%d",
+    ctx.fd_input_read, ctx.fd_drone_read, ctx.fd_obst_write, ctx.fd_targ_write, ctx.fd_wd_write, ctx.fd_network_read);
 
     // Ignore SIGPIPE to prevent crash on broken pipes
     signal(SIGPIPE, SIG_IGN);
 
+    // Optional session recording (never while replaying, the trace is our input)
+    const char *trace_path = getenv(TRACE_ENV);
+    if (trace_path && *trace_path && current_mode != MODE_REPLAY) {
+        trace_open(trace_path, current_mode, current_role);
+    }
+
+#if USE_SHM_TRANSPORT
+    world = shm_world_attach();
+    if (!world) {
+        fprintf(stderr, "[BB] Error: cannot attach shared memory\n");
+        return 1;
+    }
+    shm_outbox_init(&outbox_inputs, &world->inputs);
+    shm_outbox_init(&outbox_entities, &world->entities);
+#endif
+
     // --- WATCHDOG SETUP ---
     struct sigaction sa;
     sa.sa_handler = watchdog_ping_handler;
@@ -501,63 +1463,56 @@ int main(int argc, char *argv[]) {
         wait_for_watchdog_pid();
     }
 
-    // Publish PID with file locking
-    FILE *fp_pid = fopen(PID_FILE_PATH, "a");
-    if (!fp_pid) {
-        perror("[BB] Error opening PID file");
-        exit(1);
+    // Publish PID (a replay runs next to no watchdog)
+    if (current_mode != MODE_REPLAY) publish_my_pid();
+
+    // --- NCURSES INITIALIZATION (headless: no terminal at all, ctx.win stays NULL) ---
+    if (!headless) {
+        initscr();
+        cbreak();
+        noecho();
+        nodelay(stdscr, TRUE);
+        curs_set(0);
+        start_color();
+        use_default_colors();
+        init_pair(1, COLOR_BLUE, -1);
+        init_pair(2, COLOR_RED, -1);
+        init_pair(3, COLOR_GREEN, -1);
+        refresh();
+
+        // --- WINDOW & PROTOCOL HANDSHAKE ---
+        status_win = newwin(1, COLS, 0, 0);
+        ctx.win = create_window(LINES - 1, COLS, 1, 0);
     }
-
-    int fd_pid = fileno(fp_pid);
-    flock(fd_pid, LOCK_EX); // Acquire Lock
-    publish_my_pid(fp_pid);
-    fflush(fp_pid);
-    flock(fd_pid, LOCK_UN); // Release Lock
-    fclose(fp_pid);
-
-    // --- NCURSES INITIALIZATION ---
-    initscr();
-    cbreak();
-    noecho();
-    nodelay(stdscr, TRUE);
-    curs_set(0);
-    start_color();
-    use_default_colors();
-    init_pair(1, COLOR_BLUE, -1);
-    init_pair(2, COLOR_RED, -1);
-    init_pair(3, COLOR_GREEN, -1);
-    refresh();
-
-    // --- WINDOW & PROTOCOL HANDSHAKE ---
-    WINDOW *win = NULL;
-    status_win = newwin(1, COLS, 0, 0);
-    win = create_window(LINES - 1, COLS, 1, 0);
     
-    reposition_and_redraw(&win, 0, 0);
+    reposition_and_redraw(&ctx.win, 0, 0);
     
     // Initial size broadcast
     if (current_mode == MODE_STANDALONE || (current_mode == MODE_NETWORKED && current_role == MODE_SERVER)) {
-        send_window_size(win, fd_drone_write, fd_obst_write, fd_targ_write);
+        send_window_size(ctx.win, ctx.fd_drone_write, ctx.fd_obst_write, ctx.fd_targ_write);
     }
 
+    // Startup barrier: the Network process only connects once it is released too
+    if (current_mode != MODE_REPLAY) registry_ready(ROLE_BLACKBOARD);
+
     // Network Synchronization Logic
     if (current_mode == MODE_NETWORKED) {
         if (current_role == MODE_SERVER) {
             // Server: Sends dimensions to Client
-            send_window_size_network(win, fd_network_write);
+            send_window_size_network(ctx.win, ctx.fd_network_write);
         } else {
             // Client: Waits for dimensions from Server
             Message msg;
-            ssize_t n = read(fd_network_read, &msg, sizeof(msg));
+            ssize_t n = read(ctx.fd_network_read, &msg, sizeof(msg));
             if (n > 0 && msg.type == MSG_TYPE_SIZE) {
                 int width, height;
-                if (sscanf(msg.data, "%d %d", &width, &height) == 2) {
+                if (msg_decode_size(&msg, &width, &height) == 0) {
                     
                     // 1. Resize local window to match Server
-                    reposition_and_redraw(&win, height, width);
+                    reposition_and_redraw(&ctx.win, height, width);
                     
                     // 2. Forward correct size to Local Drone
-                    send_window_size(win, fd_drone_write, fd_obst_write, fd_targ_write);
+                    send_window_size(ctx.win, ctx.fd_drone_write, ctx.fd_obst_write, ctx.fd_targ_write);
                     
                     logMessage(LOG_PATH, "[BB] Synced size with Server: %dx%d and forwarded to Drone", width, height);
                 }
@@ -565,321 +1520,128 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // Physics variables initialization
-    float drn_Fx = 0.0f, drn_Fy = 0.0f;
-    float obst_Fx = 0.0f, obst_Fy = 0.0f;
-    float wall_Fx = 0.0f, wall_Fy = 0.0f;
-    float targ_Fx = 0.0f, targ_Fy = 0.0f;
-
-    logMessage(LOG_PATH, "[BB] Ready and GUI started");
-
-    fd_set readfds;
-    struct timeval tv;
-    Message msg;
+    if (headless) logMessage(LOG_PATH, "[BB] Ready, headless (%dx%d field)", field_w, field_h);
+    else logMessage(LOG_PATH, "[BB] Ready and GUI started");
 
-    obstacles = malloc(sizeof(Point)); 
+    entities_reserve(&obstacles, &obstacles_cap, 1);
     num_obstacles = 0;
-    
-    // --- MAIN EVENT LOOP ---
-    while (1) {
-        set_state(STATE_IDLE); // Reset state before waiting
 
-        // 1. UI Input Handling (Local Keyboard)
-        int ch = getch();
-        if (ch != ERR) {
-            set_state(STATE_PROCESSING_INPUT);
-            if (ch == 'q') break;
-            if (ch == KEY_RESIZE) {
-                reposition_and_redraw(&win, 0, 0);
-                send_resize(win, fd_drone_write);
-            }
-        }
-
-        // 2. Periodic Logic (Obstacle Random Movement)
-        struct timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        if (current_mode == MODE_STANDALONE && num_obstacles > 0 && now.tv_sec - last_obst_change.tv_sec >= OBSTACLE_PERIOD_SEC) {
-            set_state(STATE_UPDATING_MAP); 
-            last_obst_change = now;
-            
-            int idx = rand() % num_obstacles;
-            int max_y, max_x;
-            getmaxyx(win, max_y, max_x);
-            generate_new_obstacle(idx, max_x, max_y);
-            
-            redraw_scene(win); 
-
-            // Broadcast update
-            set_state(STATE_BROADCASTING); 
-            Message m;
-            m.type = MSG_TYPE_OBSTACLES;
-            snprintf(m.data, sizeof(m.data), "%d", num_obstacles);
-            write(fd_drone_write, &m, sizeof(m));
-            write(fd_drone_write, obstacles, sizeof(Point) * num_obstacles);
-        }
-
-        // 3. I/O Multiplexing Configuration (Select)
-        FD_ZERO(&readfds);
-        FD_SET(fd_input_read, &readfds);
-        FD_SET(fd_drone_read, &readfds);
-        
-        if(current_mode == MODE_STANDALONE){
-            FD_SET(fd_obst_read, &readfds);
-            FD_SET(fd_targ_read, &readfds); 
-        }
-        if(current_mode == MODE_NETWORKED){
-            FD_SET(fd_network_read, &readfds);
-        }
-        
-        // Calculate max_fd for select()
-        int max_fd = fd_input_read;
-        if (fd_drone_read > max_fd) max_fd = fd_drone_read;
-        if(current_mode == MODE_STANDALONE){
-            if (fd_obst_read > max_fd) max_fd = fd_obst_read;
-            if (fd_targ_read > max_fd) max_fd = fd_targ_read;
-        }
-        if(current_mode == MODE_NETWORKED){
-            if (fd_network_read > max_fd) max_fd = fd_network_read;
-        }
-        max_fd += 1;
-
-        tv.tv_sec  = 0;
-        tv.tv_usec = 30000; // 30ms Timeout for fluid rendering
-
-        int ret = select(max_fd, &readfds, NULL, NULL, &tv);
-        if (ret < 0) {
-            if (errno == EINTR) continue;
-            break;
-        }
-
-        // 4. Input Process Handler
-        if (FD_ISSET(fd_input_read, &readfds)) {
-            set_state(STATE_PROCESSING_INPUT);
-            char buf[80];
-            ssize_t n = read(fd_input_read, buf, sizeof(buf)-1);
-            if (n > 0) {
-                buf[n] = '\0';
-                if (buf[0] == 'q'){
-                    // Handle Quit Sequence
-                    Message quit_msg;
-                    quit_msg.type = MSG_TYPE_EXIT;
-                    snprintf(msg.data, sizeof(quit_msg), "%s", buf);
-                    if(current_mode == MODE_STANDALONE){
-                        write(fd_wd_write, &quit_msg, sizeof(Message));
-                        write(fd_drone_write, &quit_msg, sizeof(Message));
-                        write(fd_obst_write, &quit_msg, sizeof(Message));
-                        write(fd_targ_write, &quit_msg, sizeof(Message));
-                    }
-                    else{
-                        write(fd_drone_write, &quit_msg, sizeof(Message));
-                        write(fd_network_write, &quit_msg, sizeof(Message));
-                    }
-                    goto quit;
-                }
-                logMessage(LOG_PATH_SC, "[BB] Input received: %c", buf[0]);
-                
-                // Forward keypress to Drone Process
-                msg.type = MSG_TYPE_INPUT;
-                snprintf(msg.data, sizeof(msg.data), "%s", buf);
-                write(fd_drone_write, &msg, sizeof(Message));
-            }
-        }
+    // --- REACTOR SETUP ---
+    if (reactor_init(&ctx.reactor) < 0) {
+        endwin();
+        perror("[BB] epoll_create1");
+        exit(1);
+    }
+    ctx.fd_frame_timer = reactor_timer_create();
+    ctx.fd_obst_timer = reactor_timer_create();
+    ctx.fd_hb_timer = -1;
+    if (ctx.fd_frame_timer < 0 || ctx.fd_obst_timer < 0) {
+        endwin();
+        perror("[BB] timerfd_create");
+        exit(1);
+    }
 
-        // 5. Network Process Handler
-        if(FD_ISSET(fd_network_read, &readfds)){
-            if(read(fd_network_read, &msg, sizeof(Message)) > 0){
-                switch(msg.type){
-                    case MSG_TYPE_DRONE: {
-                        // Receiving remote drone position, treating it as an obstacle locally
-                        float remote_x, remote_y;
-                        if (sscanf(msg.data, "%f %f", &remote_x, &remote_y) == 2) {
-                            if (!obstacles) {
-                                obstacles = malloc(sizeof(Point));
-                            }
-
-                            num_obstacles = 1;
-                            obstacles[0].x = (int)remote_x;
-                            obstacles[0].y = (int)remote_y;
-
-                            // Clamp values within bounds
-                            int max_y, max_x;
-                            getmaxyx(win, max_y, max_x);
-                            if(obstacles[0].x >= max_x) obstacles[0].x = max_x - 1;
-                            if(obstacles[0].y >= max_y - 1) obstacles[0].y = max_y - 2;
-                            if(obstacles[0].x < 1) obstacles[0].x = 1;
-                            if(obstacles[0].y < 1) obstacles[0].y = 1;
-
-                            // Notify local drone about the "obstacle" (remote drone)
-                            Message out_msg;
-                            out_msg.type = MSG_TYPE_OBSTACLES;
-                            snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_obstacles);
-                            write(fd_drone_write, &out_msg, sizeof(Message));
-                            write(fd_drone_write, obstacles, sizeof(Point) * num_obstacles);
-                            
-                            redraw_scene(win);
-                        }
-                        break;
-                    }
-                    default: break;
-                }
-            }
+    if (!headless) reactor_add(&ctx.reactor, STDIN_FILENO, on_keyboard, &ctx);
+    reactor_add(&ctx.reactor, ctx.fd_input_read, on_input, &ctx);
+    // on_drone() drains the pipe until EAGAIN
+    fcntl(ctx.fd_drone_read, F_SETFL, fcntl(ctx.fd_drone_read, F_GETFL) | O_NONBLOCK);
+    reactor_add(&ctx.reactor, ctx.fd_drone_read, on_drone, &ctx);
+    reactor_add(&ctx.reactor, ctx.fd_frame_timer, on_frame_timer, &ctx);
+    if(current_mode != MODE_NETWORKED){
+        reactor_add(&ctx.reactor, ctx.fd_obst_read, on_obstacles, &ctx);
+        reactor_add(&ctx.reactor, ctx.fd_targ_read, on_targets, &ctx);
+    }
+    if(current_mode == MODE_STANDALONE){
+        // In a replay the relocations come from the trace
+        const long long period_ns = OBSTACLE_PERIOD_SEC * 1000000000LL;
+        reactor_timer_arm(ctx.fd_obst_timer, period_ns, period_ns);
+        reactor_add(&ctx.reactor, ctx.fd_obst_timer, on_obstacle_timer, &ctx);
+#if USE_HEARTBEAT
+        ctx.fd_hb_timer = reactor_timer_create();
+        if (ctx.fd_hb_timer >= 0) {
+            const long long beat_ns = HB_DEADLINE_MS * 1000000LL / 4;
+            reactor_timer_arm(ctx.fd_hb_timer, beat_ns, beat_ns);
+            reactor_add(&ctx.reactor, ctx.fd_hb_timer, on_heartbeat_timer, &ctx);
+            hb_join("BLACKBOARD", HB_DEADLINE_MS);
         }
+#endif
+    }
+    if(current_mode == MODE_NETWORKED){
+        reactor_add(&ctx.reactor, ctx.fd_network_read, on_network, &ctx);
+    }
 
-
-        // 6. Drone Process Handler
-        if (FD_ISSET(fd_drone_read, &readfds)) {
-            set_state(STATE_UPDATING_MAP);
-            if (read(fd_drone_read, &msg, sizeof(msg)) > 0) {
-                switch (msg.type) {
-
-                case MSG_TYPE_POSITION:{
-                    sscanf(msg.data, "%f %f", &current_x, &current_y);
-
-                    redraw_scene(win); 
-
-                    // Forward position to network if applicable
-                    if (current_mode == MODE_NETWORKED) {
-                        send_drone_position_network(current_x, current_y, fd_network_write);
-                    }
-                    
-                    // Standalone Mode: Check Collisions with Targets
-                    if(current_mode == MODE_STANDALONE){
-                        int dx = (int)current_x;
-                        int dy = (int)current_y;
-
-                        for (int i = 0; i < num_targets; i++) {
-                            if (dx == (int)targets[i].x && dy == (int)targets[i].y) {
-                                
-                                // Logic for Sequential Target Collection
-                                if(i == 0){
-                                    logMessage(LOG_PATH, "[BB] Expected target reached");
-                                    // Shift array (remove target 0)
-                                    for (int j = i; j < num_targets - 1; j++) targets[j] = targets[j + 1];
-                                    target_reached++;
-                                    num_targets--;
-                                    
-                                    // Broadcast new target list
-                                    set_state(STATE_BROADCASTING);
-                                    Message out_msg;
-                                    out_msg.type = MSG_TYPE_TARGETS;
-                                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_targets);
-                                    write(fd_drone_write, &out_msg, sizeof(out_msg));
-                                    write(fd_drone_write, targets, sizeof(Point) * num_targets);
-                                }
-                                else if(i != 0){
-                                    // Wrong target hit: Respawn it elsewhere
-                                    logMessage(LOG_PATH, "[BB] Not expected target reached");
-                                    targets[i].x = 0;
-                                    targets[i].y = 0;
-
-                                    int max_y, max_x;
-                                    getmaxyx(win, max_y, max_x);
-                                    generate_new_target(i, max_x, max_y);
-
-                                    set_state(STATE_BROADCASTING);
-                                    Message out_msg;
-                                    out_msg.type = MSG_TYPE_TARGETS;
-                                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_targets);
-                                    write(fd_drone_write, &out_msg, sizeof(out_msg));
-                                    write(fd_drone_write, targets, sizeof(Point) * num_targets);
-                                }
-                                
-
-                                // Win Condition
-                                if (num_targets == 0) {
-                                    logMessage(LOG_PATH, "[BB] ALL TARGETS CLEARED");
-                                    Message out_msg;
-                                    out_msg.type = MSG_TYPE_OBSTACLES;
-                                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_obstacles);
-                                    write(fd_targ_write, &out_msg, sizeof(out_msg));
-                                    write(fd_targ_write, obstacles, sizeof(Point) * num_obstacles);
-                                }
-                                redraw_scene(win);
-                                break; 
-                            }
-                        }
-                    }
-                    break;
-                }
-
-                case MSG_TYPE_FORCE: {
-                    // Update force values for the UI status bar
-                    if (sscanf(msg.data, "%f %f %f %f %f %f %f %f",
-                            &drn_Fx, &drn_Fy, &obst_Fx, &obst_Fy, &wall_Fx, &wall_Fy, &targ_Fx, &targ_Fy) == 8) {
-                        update_dynamic(current_x, current_y, drn_Fx, drn_Fy, obst_Fx, obst_Fy, wall_Fx, wall_Fy, targ_Fx, targ_Fy);
-                    }
-                    break;
-                }
-                default: break;
-                }
-            }
+    // Metrics (exec/stats): a replay runs next to no session of its own
+    if (current_mode != MODE_REPLAY) {
+        metrics_join("BLACKBOARD");
+        metrics_pipe(ctx.fd_input_read, "input.in");
+        metrics_pipe(ctx.fd_drone_read, "drone.in");
+        metrics_pipe(ctx.fd_drone_write, "drone.out");
+        if (current_mode == MODE_STANDALONE) {
+            metrics_pipe(ctx.fd_obst_read, "obst.in");
+            metrics_pipe(ctx.fd_obst_write, "obst.out");
+            metrics_pipe(ctx.fd_targ_read, "targ.in");
+            metrics_pipe(ctx.fd_targ_write, "targ.out");
+            metrics_pipe(ctx.fd_wd_write, "wd.out");
+        } else {
+            metrics_pipe(ctx.fd_network_read, "net.in");
+            metrics_pipe(ctx.fd_network_write, "net.out");
         }
+    }
+    ctx.met_frames = metrics_counter("frames");
+    ctx.met_late = metrics_counter("late");
+    ctx.met_positions = metrics_counter("positions");
+    ctx.met_coalesced = metrics_counter("coalesced");
 
-        // 7. Obstacle Process Handler
-        if (FD_ISSET(fd_obst_read, &readfds)) {
-            set_state(STATE_UPDATING_MAP);
-            if (read(fd_obst_read, &msg, sizeof(msg)) > 0 && msg.type == MSG_TYPE_OBSTACLES) {
-                int count;
-                sscanf(msg.data, "%d", &count);
-                if (count > 0) {
-                    free(obstacles);
-                    obstacles = malloc(sizeof(Point) * count);
-                    read(fd_obst_read, obstacles, sizeof(Point) * count);
-                    num_obstacles = count;
-                    
-                    logMessage(LOG_PATH, "[BB] received %d obstacles", num_obstacles);
-                    
-                    // Distribute obstacles to Drone & Target Processes
-                    set_state(STATE_BROADCASTING);
-                    Message out_msg;
-                    out_msg.type = MSG_TYPE_OBSTACLES;
-                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_obstacles);      
-                    
-                    write(fd_drone_write, &out_msg, sizeof(out_msg));
-                    write(fd_drone_write, obstacles, sizeof(Point) * num_obstacles);
-                    
-                    write(fd_targ_write, &out_msg, sizeof(out_msg));
-                    write(fd_targ_write, obstacles, sizeof(Point) * num_obstacles);
-                }
-                redraw_scene(win);
-            }
-        }
+    // --- MAIN EVENT LOOP ---
+    int64_t started_ns = latency_now_ns();
+    while (!ctx.quit) {
+        metrics_loop();
+        metrics_set(ctx.met_frames, ctx.frames);
+        metrics_set(ctx.met_late, ctx.late_frames);
+        metrics_set(ctx.met_positions, ctx.positions);
+        metrics_set(ctx.met_coalesced, ctx.coalesced);
+        set_state(STATE_IDLE); // Reset state before waiting
 
-        // 8. Target Process Handler
-        if (FD_ISSET(fd_targ_read, &readfds)) {
-            set_state(STATE_UPDATING_MAP);
-            if (read(fd_targ_read, &msg, sizeof(msg)) > 0 && msg.type == MSG_TYPE_TARGETS) {
-                int count;
-                sscanf(msg.data, "%d", &count);
-                if (count > 0) {
-                    free(targets);
-                    targets = malloc(sizeof(Point) * count);
-                    read(fd_targ_read, targets, sizeof(Point) * count);
-                    num_targets = count;
-
-                    // Distribute targets to Drone & Obstacle Processes
-                    set_state(STATE_BROADCASTING);
-                    Message out_msg;
-                    out_msg.type = MSG_TYPE_TARGETS;
-                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_targets);
-                    
-                    write(fd_drone_write, &out_msg, sizeof(out_msg));
-                    write(fd_drone_write, targets, sizeof(Point) * num_targets);
-                    
-                    write(fd_obst_write, &out_msg, sizeof(out_msg));
-                    write(fd_obst_write, targets, sizeof(Point) * num_targets);
-                }
-                redraw_scene(win);
-            }
+        if (reactor_run_once(&ctx.reactor, -1) < 0) {
+            if (errno != EINTR) break;
+            // Signals (SIGWINCH, watchdog pings) wake us: ncurses reports resizes via getch()
+            if (!headless) on_keyboard(STDIN_FILENO, 0, &ctx);
         }
+    }
 
-        usleep(10000); // Brief sleep to prevent 100% CPU usage loop
+    logMessage(LOG_PATH, "[BB] Frames: %llu drawn at up to %d FPS, %llu late; drone positions: %llu, "
+               "%llu coalesced; worst position lag %.1f ms",
+               ctx.frames, BB_MAX_FPS, ctx.late_frames, ctx.positions, ctx.coalesced, ctx.worst_lag_ns / 1e6);
+    if (headless) {
+        double secs = (latency_now_ns() - started_ns) / 1e9;
+        logMessage(LOG_PATH, "[BENCH] blackboard: %llu msgs in, %llu to drone in %.1f s (%.0f msgs/s)",
+                   msgs_in, msgs_out, secs, secs > 0 ? (msgs_in + msgs_out) / secs : 0.0);
     }
 
     // --- CLEANUP ---
-    quit:
-    destroy_window(win);
+#if LATENCY_TRACE
+    lat_path_log(&latency, LOG_PATH);
+#endif
+    trace_close();
+#if RENDER_INCREMENTAL
+    render_free();
+#endif
+    reactor_close(&ctx.reactor);
+    close(ctx.fd_frame_timer);
+    close(ctx.fd_obst_timer);
+    if (ctx.fd_hb_timer >= 0) close(ctx.fd_hb_timer);
+    hb_leave();
+    metrics_leave();
+    destroy_window(ctx.win);
     free(obstacles);
-    endwin();
+    free(targets);
+    occ_free(&occ_all);
+    occ_free(&occ_targ);
+#if USE_SHM_TRANSPORT
+    shm_outbox_free(&outbox_inputs);
+    shm_outbox_free(&outbox_entities);
+    shm_world_detach(world);
+#endif
+    if (!headless) endwin();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,170 @@
+#include "config.h"
+#include "app_common.h"
+#include "log.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ArpConfig arp_config = {
+    .physics_hz = PHYSICS_HZ_DEFAULT,
+    .render_fps = RENDER_FPS_DEFAULT,
+    .bb_fps = BB_FPS_DEFAULT,
+    .obstacle_period_sec = OBSTACLE_PERIOD_SEC_DEFAULT,
+    .perc_obst = PERC_OBST_DEFAULT,
+    .perc_targ = PERC_TARG_DEFAULT,
+    .dt = DT_DEFAULT,
+    .force_rho = RHO_DEFAULT,
+    .force_eta = ETA_DEFAULT,
+    .net_port = NET_PORT_DEFAULT,
+    .wd_timeout_ms = WD_TIMEOUT_MS_DEFAULT,
+    .wd_cycle_sec = WD_CYCLE_SEC_DEFAULT,
+    .field_width = FIELD_WIDTH_DEFAULT,
+    .field_height = FIELD_HEIGHT_DEFAULT,
+};
+
+typedef struct {
+    const char *key;
+    int is_float;
+    void *value;
+    double min, max;
+} ConfigKey;
+
+static const ConfigKey keys[] = {
+    { "physics_hz",          0, &arp_config.physics_hz,          1,     100000 },
+    { "render_fps",          0, &arp_config.render_fps,          1,     1000 },
+    { "bb_fps",              0, &arp_config.bb_fps,              1,     1000 },
+    { "obstacle_period_sec", 0, &arp_config.obstacle_period_sec, 1,     3600 },
+    { "perc_obst",           1, &arp_config.perc_obst,           0,     0.9 },
+    { "perc_targ",           1, &arp_config.perc_targ,           0,     0.9 },
+    { "dt",                  1, &arp_config.dt,                  1e-5,  1 },
+    { "rho",                 1, &arp_config.force_rho,           1,     100 },
+    { "eta",                 1, &arp_config.force_eta,           0,     1000 },
+    { "net_port",            0, &arp_config.net_port,            1,     65535 },
+    { "wd_timeout_ms",       0, &arp_config.wd_timeout_ms,       5,     60000 },
+    { "wd_cycle_sec",        0, &arp_config.wd_cycle_sec,        1,     3600 },
+    { "field_width",         0, &arp_config.field_width,         10,    4000 },
+    { "field_height",        0, &arp_config.field_height,        10,    4000 },
+};
+#define NUM_KEYS (int)(sizeof(keys) / sizeof(keys[0]))
+
+/* ======================================================================================
+ * SECTION 1: VALUES
+ * ====================================================================================== */
+static const ConfigKey *find_key(const char *name) {
+    for (int i = 0; i < NUM_KEYS; i++) {
+        if (strcmp(keys[i].key, name) == 0) return &keys[i];
+    }
+    return NULL;
+}
+
+// Parses text into k's field. Returns -1 (field unchanged) when it is not a number in range.
+static int set_value(const ConfigKey *k, const char *text) {
+    char *end;
+    errno = 0;
+    double v = k->is_float ? strtod(text, &end) : (double)strtol(text, &end, 10);
+    while (isspace((unsigned char)*end)) end++;
+    if (errno || end == text || *end || v < k->min || v > k->max) return -1;
+    if (k->is_float) *(float *)k->value = (float)v;
+    else *(int *)k->value = (int)v;
+    return 0;
+}
+
+// exact: 9 digits, so the children parse back the very same float
+static void format_value(const ConfigKey *k, char *buf, size_t len, int exact) {
+    if (k->is_float) snprintf(buf, len, exact ? "%.9g" : "%g", *(float *)k->value);
+    else snprintf(buf, len, "%d", *(int *)k->value);
+}
+
+// ARP_<KEY>: the key in capitals
+static void env_name(const ConfigKey *k, char *buf, size_t len) {
+    size_t n = snprintf(buf, len, "ARP_%s", k->key);
+    for (size_t i = 4; i < n && i < len; i++) buf[i] = (char)toupper((unsigned char)buf[i]);
+}
+
+/* ======================================================================================
+ * SECTION 2: SOURCES
+ * ====================================================================================== */
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+    return s;
+}
+
+static int load_file(const char *path, int required) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        if (required) logMessage(LOG_PATH, "[CFG] ERROR cannot read %s: %s", path, strerror(errno));
+        return required ? -1 : 0;
+    }
+
+    char line[256];
+    int lineno = 0, applied = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *key = trim(line);
+        if (*key == '\0') continue;
+
+        char *eq = strchr(key, '=');
+        if (!eq) {
+            logMessage(LOG_PATH, "[CFG] %s:%d: no '=', line skipped", path, lineno);
+            continue;
+        }
+        *eq = '\0';
+        char *value = trim(eq + 1);
+        key = trim(key);
+
+        const ConfigKey *k = find_key(key);
+        if (!k) logMessage(LOG_PATH, "[CFG] %s:%d: unknown key \"%s\"", path, lineno, key);
+        else if (set_value(k, value) < 0)
+            logMessage(LOG_PATH, "[CFG] %s:%d: bad %s \"%s\" (%g..%g)", path, lineno, key, value, k->min, k->max);
+        else applied++;
+    }
+    fclose(f);
+    logMessage(LOG_PATH, "[CFG] %d settings from %s", applied, path);
+    return 0;
+}
+
+void config_from_env(void) {
+    char name[64];
+    for (int i = 0; i < NUM_KEYS; i++) {
+        env_name(&keys[i], name, sizeof(name));
+        const char *v = getenv(name);
+        if (v && set_value(&keys[i], v) < 0) {
+            logMessage(LOG_PATH, "[CFG] bad %s \"%s\" (%g..%g), keeping %s default",
+                       name, v, keys[i].min, keys[i].max, keys[i].key);
+        }
+    }
+}
+
+int config_load(const char *path) {
+    int rc = 0;
+    if (!path) path = getenv(CONFIG_ENV);
+    if (path) rc = load_file(path, 1);
+    else load_file(CONFIG_FILE, 0);
+    config_from_env();
+
+    // The children read the resolved values back with config_from_env()
+    char name[64], value[32];
+    for (int i = 0; i < NUM_KEYS; i++) {
+        env_name(&keys[i], name, sizeof(name));
+        format_value(&keys[i], value, sizeof(value), 1);
+        setenv(name, value, 1);
+    }
+    return rc;
+}
+
+void config_describe(char *buf, size_t len) {
+    size_t used = 0;
+    if (len) buf[0] = '\0';
+    for (int i = 0; i < NUM_KEYS && used < len; i++) {
+        char value[32];
+        format_value(&keys[i], value, sizeof(value), 0);
+        used += snprintf(buf + used, len - used, "%s%s=%s", i ? " " : "", keys[i].key, value);
+    }
+}
@@ -0,0 +1,86 @@
+// config.h
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+
+/* * Runtime settings: the rates, densities and sizes that used to need a rebuild.
+ * main resolves them once (defaults below, then the key=value file, then ARP_*
+ * environment overrides) and exports the result as ARP_* variables, so every
+ * child it spawns starts with the same values. app_common.h maps the old macro
+ * names (PHYSICS_HZ, rho, ...) onto these fields.
+ *
+ * File: one "key = value" per line, '#' starts a comment. The path is
+ * $ARP_CONFIG, or arp.conf in the working directory when it exists.
+ * Environment: ARP_<KEY> in capitals, e.g. ARP_PHYSICS_HZ=500.
+ */
+#define CONFIG_ENV      "ARP_CONFIG"
+#define CONFIG_FILE     "arp.conf"
+
+// Defaults (each can still be changed at build time with -D<NAME>_DEFAULT=...)
+#ifndef PHYSICS_HZ_DEFAULT
+#define PHYSICS_HZ_DEFAULT 1000          // Drone physics steps per second (1ms step)
+#endif
+#ifndef RENDER_FPS_DEFAULT
+#define RENDER_FPS_DEFAULT 30            // Drone state updates per second to the Blackboard
+#endif
+#ifndef BB_FPS_DEFAULT
+#define BB_FPS_DEFAULT 60                // Blackboard redraws per second at most (make BB_FPS=)
+#endif
+#ifndef OBSTACLE_PERIOD_SEC_DEFAULT
+#define OBSTACLE_PERIOD_SEC_DEFAULT 5    // Obstacle relocation period
+#endif
+#ifndef PERC_OBST_DEFAULT
+#define PERC_OBST_DEFAULT 0.005          // Share of the playing field covered
+#endif
+#ifndef PERC_TARG_DEFAULT
+#define PERC_TARG_DEFAULT 0.001
+#endif
+#ifndef DT_DEFAULT
+#define DT_DEFAULT 0.01f                 // Simulated seconds per physics step
+#endif
+#ifndef RHO_DEFAULT
+#define RHO_DEFAULT 8.0f                 // Range of the obstacle/target/wall forces (cells)
+#endif
+#ifndef ETA_DEFAULT
+#define ETA_DEFAULT 5.0f                 // Gain of those forces
+#endif
+#ifndef NET_PORT_DEFAULT
+#define NET_PORT_DEFAULT 5000            // Offered when the port prompt gets no number
+#endif
+#ifndef WD_TIMEOUT_MS_DEFAULT
+#define WD_TIMEOUT_MS_DEFAULT 200        // Watchdog: reply time allowed to a ping
+#endif
+#ifndef WD_CYCLE_SEC_DEFAULT
+#define WD_CYCLE_SEC_DEFAULT 2           // Watchdog: pause between two ping rounds
+#endif
+#ifndef FIELD_WIDTH_DEFAULT
+#define FIELD_WIDTH_DEFAULT 120          // Headless playing field (the window sets it otherwise)
+#endif
+#ifndef FIELD_HEIGHT_DEFAULT
+#define FIELD_HEIGHT_DEFAULT 40
+#endif
+
+typedef struct {
+    int physics_hz, render_fps, bb_fps;
+    int obstacle_period_sec;
+    float perc_obst, perc_targ;
+    float dt, force_rho, force_eta;      // Not rho/eta: app_common.h defines those names
+    int net_port;
+    int wd_timeout_ms, wd_cycle_sec;
+    int field_width, field_height;
+} ArpConfig;
+
+extern ArpConfig arp_config;
+
+/* * main: file (path, or $ARP_CONFIG / arp.conf when NULL) then environment, and
+ * exports the result. Bad lines and out-of-range values are logged and skipped.
+ * Returns -1 only when an explicitly named file cannot be read.
+ */
+int  config_load(const char *path);
+// Children and tools started on their own: ARP_* environment over the defaults
+void config_from_env(void);
+// "key=value ..." of every setting, for the log
+void config_describe(char *buf, size_t len);
+
+#endif
@@ -1,9 +1,11 @@
 /* ======================================================================================
  * FILE: drone.c
  * Logic: 
+ * 0. Sleep until the next physics deadline (fixed-step scheduler)
  * 1. Flush Input Pipe (Handle all pending keys/obstacles)
- * 2. Calculate Physics (High Frequency ~1000Hz)
- * 3. Send Output to Blackboard (Throttled ~30Hz to avoid pipe flooding)
+ * 2. Calculate Physics (PHYSICS_HZ, with catch-up substeps after a stall; with
+ *    PHYSICS_THREADS > 1 on worker threads while this one keeps draining the pipe)
+ * 3. Send Output to Blackboard (every PHYSICS_HZ/RENDER_FPS steps, to avoid pipe flooding)
  * ====================================================================================== */
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,18 +19,35 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/file.h>
+#include <sys/select.h>
 
 #include "app_common.h"
 #include "log.h"
 #include "process_pid.h"
+#include "shm_ipc.h"
+#include "msg_codec.h"
+#include "spatial_grid.h"
+#include "force_kernel.h"
+#include "sim_core.h"
+#include "fixed_step.h"
+#include "latency.h"
+#include "entities.h"
+#include "heartbeat.h"
+#include "metrics.h"
+#include "physics_pool.h"
 
 #undef EPSILON
 #define EPSILON 0.001f
 
-#define PHYSICS_DT_SEC 0.001f    // 1ms physics step
-#define RENDER_FPS 30            // 30 invii al secondo alla blackboard
-#define RENDER_DT_NS (1000000000L / RENDER_FPS)
+#if NUM_DRONES > 1 && USE_SHM_TRANSPORT
+#error "DRONES > 1 sends the swarm through the pipe: build it with SHM=0"
+#endif
+
+/* Every step integrates DT (simulated seconds). With PHYSICS_HZ steps per
+ * wall-clock second (app_common.h) the simulation runs DT * PHYSICS_HZ times
+ * real time, a fixed ratio instead of one that depends on sleep jitter. */
+#define MAX_CATCHUP_STEPS 20     // Substeps allowed per wake-up after a stall
+#define SCHED_REPORT_SEC 10      // Scheduler statistics period in the log
 
 typedef enum {
     STATE_INIT, STATE_WAITING_INPUT, STATE_PROCESSING_INPUT,
@@ -36,12 +55,51 @@ typedef enum {
 } ProcessState;
 
 static Point *obstacles = NULL;
-static int num_obstacles = 0;
+static int num_obstacles = 0, obstacles_cap = 0;
+static uint32_t obstacles_version = 0;
 static Point *targets = NULL;
-static int num_targets = 0;
+static int num_targets = 0, targets_cap = 0;
+static uint32_t targets_version = 0;
+static SimField field;                   // Grids and SoA copies, synced on every array update
+// Networked: the first num_moving obstacles are remote drones, moved between updates
+static Motion *obst_motion = NULL;
+static int num_moving = 0, motion_cap = 0;
+static unsigned long motion_age = 0;     // Physics steps since the last OBST_MOTION
+#if PHYSICS_THREADS > 1
+/* * Threaded physics: the workers step the swarm on front, a copy of the field
+ * and of the obstacles taken between two jobs, while this thread applies
+ * entity messages to the live arrays and field above. */
+static PhysicsPool pool;
+static bool pool_ok = false;
+static SimField front;
+static Point *front_obstacles = NULL;
+static int front_obstacles_cap = 0;
+static bool front_stale = true;          // The live field changed since the last copy
+#endif
 static volatile pid_t watchdog_pid = -1; 
 static volatile sig_atomic_t current_state = STATE_INIT;
 
+/* What each state counts as in the metrics segment (exec/stats) */
+static const MetState met_state_of[] = {
+    [STATE_INIT] = MET_IDLE, [STATE_WAITING_INPUT] = MET_IDLE, [STATE_PROCESSING_INPUT] = MET_INPUT,
+    [STATE_CALCULATING_PHYSICS] = MET_PHYSICS, [STATE_SENDING_OUTPUT] = MET_BROADCAST, [STATE_IDLE] = MET_IDLE
+};
+
+static void set_state(ProcessState state) {
+    current_state = state;
+    metrics_state(met_state_of[state]);
+}
+
+#if USE_SHM_TRANSPORT
+/* Shared-memory transport: records popped from the rings are served to
+ * drone_read() as if they came from the pipe, so the handlers are unchanged. */
+static ShmWorld *world = NULL;
+static uint8_t rec_buf[SHM_RING_BYTES];
+static ssize_t rec_len = 0, rec_pos = 0;
+static ShmRing *rec_more = NULL;   // Ring whose record goes on in its next chunk
+static int fd_wake = -1;           // To the Blackboard: a chunk was taken, push the next
+#endif
+
 // --- HELPERS ---
 void watchdog_ping_handler(int sig) {
     (void)sig; 
@@ -49,81 +107,349 @@ void watchdog_ping_handler(int sig) {
 }
 
 void wait_for_watchdog_pid() {
-    FILE *fp;
-    char line[256], tag[128];
-    int pid_temp;
-    bool wd_found = false;
-    while (!wd_found) {
-        fp = fopen(PID_FILE_PATH, "r");
-        if (fp) {
-            while (fgets(line, sizeof(line), fp)) {
-                if (sscanf(line, "%s %d", tag, &pid_temp) == 2) {
-                    if (strcmp(tag, WD_PID_TAG) == 0) {
-                        watchdog_pid = (pid_t)pid_temp;
-                        wd_found = true;
-                        break;
-                    }
+    watchdog_pid = registry_wait(ROLE_WATCHDOG, -1);
+}
+
+/* * Reads from the Blackboard channel. In SHM mode the pipe only carries
+ * wake-up bytes, which are drained here, and data comes from the rings. The
+ * chunks of a large record are read in a row from their ring, like a payload
+ * arriving in pieces on a pipe.
+ */
+ssize_t drone_read(int fd_in, void *buf, size_t len) {
+#if USE_SHM_TRANSPORT
+    if (world) {
+        if (rec_pos >= rec_len) {
+            char wake[64];
+            while (metrics_read(fd_in, wake, sizeof(wake)) > 0);
+
+            rec_pos = 0;
+            int more = 0;
+            ShmRing *ring = rec_more;
+            if (ring) {
+                rec_len = shm_ring_pop(ring, rec_buf, sizeof(rec_buf), &more);
+            } else {
+                ring = &world->inputs;
+                rec_len = shm_ring_pop(ring, rec_buf, sizeof(rec_buf), &more);
+                if (rec_len == 0) {
+                    ring = &world->entities;
+                    rec_len = shm_ring_pop(ring, rec_buf, sizeof(rec_buf), &more);
                 }
             }
-            fclose(fp);
+            if (rec_len != 0) {
+                rec_more = more ? ring : NULL;
+                if (more) {
+                    char wake = SHM_WAKE_BYTE;
+                    metrics_write(fd_wake, &wake, 1);
+                }
+            }
+            if (rec_len <= 0) {
+                rec_len = 0;
+                errno = EAGAIN;
+                return -1;
+            }
+        }
+        size_t n = (size_t)(rec_len - rec_pos);
+        if (n > len) n = len;
+        memcpy(buf, rec_buf + rec_pos, n);
+        rec_pos += n;
+        return (ssize_t)n;
+    }
+#endif
+    return metrics_read(fd_in, buf, len);
+}
+
+void send_position(Message msg, float x, float y, int fd_out, const MsgLatency *echo){
+    if (echo) msg_encode_position_echo(&msg, x, y, echo);
+    else msg_encode_position(&msg, MSG_TYPE_POSITION, x, y);
+    metrics_msg_out(MSG_TYPE_POSITION);
+    metrics_write(fd_out, &msg, sizeof(msg));
+}
+
+void send_forces(Message msg, int fd_out, const MsgForce *forces){
+    msg_encode_forces(&msg, forces);
+    metrics_msg_out(MSG_TYPE_FORCE);
+    metrics_write(fd_out, &msg, sizeof(msg));
+}
+
+/* * Publishes position and forces to the Blackboard in one step.
+ * A pending key press stamp (echo->id != 0) leaves with this position and is cleared.
+ */
+void publish_state(Message msg, int fd_out, float x, float y, const MsgForce *forces, MsgLatency *echo) {
+    const MsgLatency *out = NULL;
+    if (echo && echo->id) {
+        echo->t_drone_out = latency_now_ns();
+        out = echo;
+    }
+#if USE_SHM_TRANSPORT
+    if (world) {
+        char wake = SHM_WAKE_BYTE;
+        shm_drone_publish(&world->drone, x, y, forces, out);
+        metrics_msg_out(MSG_TYPE_POSITION);
+        metrics_msg_out(MSG_TYPE_FORCE);
+        metrics_write(fd_out, &wake, 1);
+        if (echo) echo->id = 0;
+        return;
+    }
+#endif
+    send_position(msg, x, y, fd_out, out);
+    send_forces(msg, fd_out, forces);
+    if (echo) echo->id = 0;
+}
+
+/* * Swarm builds (NUM_DRONES > 1): drones 1..N-1 leave as one MSG_TYPE_SWARM per
+ * publish, a header and their MsgPosition[] like an obstacle snapshot. Drone 0
+ * keeps its POSITION/FORCE messages, so everything that follows it is unchanged.
+ */
+void send_swarm(Message msg, int fd_out, const DroneSwarm *s) {
+    static MsgPosition pos[NUM_DRONES];
+    int n = s->count - 1;
+    if (n <= 0) return;
+    for (int i = 0; i < n; i++) {
+        pos[i].x = s->x[i + 1];
+        pos[i].y = s->y[i + 1];
+    }
+    msg_encode_entities(&msg, MSG_TYPE_SWARM, n, 0);
+    metrics_msg_out(MSG_TYPE_SWARM);
+    metrics_write(fd_out, &msg, sizeof(msg));
+    metrics_write(fd_out, pos, sizeof(MsgPosition) * n);
+}
+
+// Keys steer every drone of the swarm the same way
+void apply_key(DroneSwarm *s, char ch) {
+    for (int i = 0; i < s->count; i++) {
+        switch(ch){
+            case 'e':  s->Fy[i] -= 1.0f; break;
+            case 'r':  s->Fx[i] += 1.0f; s->Fy[i] -= 1.0f; break;
+            case 'f':  s->Fx[i] += 1.0f; break;
+            case 'v':  s->Fx[i] += 1.0f; s->Fy[i] += 1.0f; break;
+            case 'c':  s->Fy[i] += 1.0f; break;
+            case 'x':  s->Fx[i] -= 1.0f; s->Fy[i] += 1.0f; break;
+            case 's':  s->Fx[i] -= 1.0f; break;
+            case 'w':  s->Fx[i] -= 1.0f; s->Fy[i] -= 1.0f; break;
+            case 'd': // Brake
+                s->Fx[i] *= 0.5f; s->Fy[i] *= 0.5f;
+                if(fabs(s->Fx[i]) <= 0.5f) s->Fx[i] = 0.0f;
+                if(fabs(s->Fy[i]) <= 0.5f) s->Fy[i] = 0.0f;
+                break;
         }
-        if (!wd_found) usleep(200000);
     }
 }
 
-void publish_my_pid(FILE *fp) {
-    fprintf(fp, "%s %d\n", DRONE_PID_TAG, getpid());
+// Called wherever the live field changes
+static void field_touched(void) {
+#if PHYSICS_THREADS > 1
+    front_stale = true;
+#endif
+}
+
+/* * Dead reckoning of the remote drones: each physics step moves them along the
+ * velocity of the last OBST_MOTION (for up to REMOTE_PREDICT_MAX_MS), so the
+ * repulsion field follows them between two Blackboard updates. Time is counted
+ * in steps, so a replay reproduces it exactly.
+ */
+void predict_moving_obstacles(void) {
+    if (num_moving == 0) return;
+    motion_age++;
+    float t = (float)motion_age / PHYSICS_HZ;
+    if (t > REMOTE_PREDICT_MAX_MS / 1000.0f) t = REMOTE_PREDICT_MAX_MS / 1000.0f;
+
+    for (int i = 0; i < num_moving; i++) {
+        float x = obst_motion[i].x + obst_motion[i].vx * t;
+        float y = obst_motion[i].y + obst_motion[i].vy * t;
+        obstacles[i].x = (int)x;
+        obstacles[i].y = (int)y;
+        // Centres as in soa_from_points(), but not snapped to the cell
+        field.obst_soa.x[i] = x + 0.5f;
+        field.obst_soa.y[i] = y + 0.5f;
+    }
+    grid_sync(&field.obst_grid, obstacles, num_obstacles);
+    field_touched();
+}
+
+/* * Entity updates keep the arrays (and their grid and SoA copies) in place:
+ * a snapshot only reallocates when it outgrows them, a MOVE touches one entry.
+ */
+static int read_snapshot(int fd_in, Point **pts, int *cap, int count) {
+    if (entities_read(drone_read, fd_in, pts, cap, count) < 0) {
+        logMessage(LOG_PATH, "[DRONE] ERROR: snapshot of %d entities lost, waiting for the next one", count);
+        return -1;
+    }
+    return 0;
+}
+
+static void entities_changed(SpatialGrid *g, PointSoA *s, const Point *pts, int n, const MsgEntityDelta *d) {
+    if (d->op == ENTITY_MOVE && s->count == n) {
+        s->x[d->index] = (float)pts[d->index].x + 0.5f;
+        s->y[d->index] = (float)pts[d->index].y + 0.5f;
+    } else {
+        soa_from_points(s, pts, n);
+    }
+    grid_sync(g, pts, n);
+    field_touched();
 }
 
-void send_position(Message msg, float x, float y, int fd_out){
-    msg.type = MSG_TYPE_POSITION;
-    snprintf(msg.data, sizeof(msg.data), "%f %f", x, y);
-    write(fd_out, &msg, sizeof(msg));
+static void apply_delta(const MsgEntityDelta *d) {
+    int r;
+    if (d->kind == MSG_TYPE_OBSTACLES) {
+        r = entities_apply(&obstacles, &num_obstacles, &obstacles_cap, &obstacles_version, d);
+        if (r > 0) {
+            if (num_moving > num_obstacles) num_moving = 0;
+            entities_changed(&field.obst_grid, &field.obst_soa, obstacles, num_obstacles, d);
+        }
+    } else if (d->kind == MSG_TYPE_TARGETS) {
+        r = entities_apply(&targets, &num_targets, &targets_cap, &targets_version, d);
+        if (r > 0) entities_changed(&field.targ_grid, &field.targ_soa, targets, num_targets, d);
+    } else {
+        r = -1;
+    }
+    if (r < 0) {
+        logMessage(LOG_PATH, "[DRONE] Delta %d on kind %d (version %u) rejected, waiting for a snapshot",
+                   d->op, d->kind, d->version);
+    }
+}
+
+/* * Messages that only update the obstacles and targets (the live arrays and
+ * field). Returns 0 for any other message, which is left to the caller.
+ */
+static int handle_entity_msg(int fd_in, const Message *msg) {
+    switch (msg->type) {
+        case MSG_TYPE_OBSTACLES: { 
+            int count;
+            uint32_t version;
+            if (msg_decode_entities(msg, &count, &version) < 0) {
+                logMessage(LOG_PATH, "[DRONE] Malformed OBSTACLES header");
+                break;
+            }
+            if (read_snapshot(fd_in, &obstacles, &obstacles_cap, count) < 0) count = 0;
+            num_obstacles = count;
+            obstacles_version = version;
+            num_moving = 0; // Until the motion that follows a remote drone update
+            sim_field_set_obstacles(&field, obstacles, num_obstacles);
+            field_touched();
+            break; 
+        }
+        case MSG_TYPE_OBST_MOTION: {
+            int count;
+            if (msg_decode_entities(msg, &count, NULL) < 0) {
+                logMessage(LOG_PATH, "[DRONE] Malformed OBST_MOTION header");
+                break;
+            }
+            if (count > motion_cap) {
+                Motion *m = realloc(obst_motion, sizeof(Motion) * count);
+                if (!m) {
+                    logMessage(LOG_PATH, "[DRONE] ERROR: no memory for %d motions", count);
+                    break;
+                }
+                obst_motion = m;
+                motion_cap = count;
+            }
+            if (count && read_full(drone_read, fd_in, obst_motion, sizeof(Motion) * count) < 0) count = 0;
+            // Only meaningful for the obstacles it was sent with
+            num_moving = (count <= num_obstacles) ? count : 0;
+            motion_age = 0;
+            break;
+        }
+        case MSG_TYPE_TARGETS: { 
+            int count;
+            uint32_t version;
+            if (msg_decode_entities(msg, &count, &version) < 0) {
+                logMessage(LOG_PATH, "[DRONE] Malformed TARGETS header");
+                break;
+            }
+            if (read_snapshot(fd_in, &targets, &targets_cap, count) < 0) count = 0;
+            num_targets = count;
+            targets_version = version;
+            sim_field_set_targets(&field, targets, num_targets);
+            field_touched();
+            break; 
+        }
+        case MSG_TYPE_ENTITY_DELTA: {
+            MsgEntityDelta d;
+            if (msg_decode_entity_delta(msg, &d) < 0) {
+                logMessage(LOG_PATH, "[DRONE] Malformed ENTITY_DELTA");
+                break;
+            }
+            apply_delta(&d);
+            break;
+        }
+        default:
+            return 0;
+    }
+    return 1;
 }
 
-void send_forces(Message msg, int fd_out, float drone_Fx, float drone_Fy,
-                 float obst_Fx, float obst_Fy, float wall_Fx, float wall_Fy,
-                 float abtrFx, float abtrFy){
-    msg.type = MSG_TYPE_FORCE;
-    snprintf(msg.data, sizeof(msg.data), "%f %f %f %f %f %f %f %f",
-             drone_Fx, drone_Fy, obst_Fx, obst_Fy, wall_Fx, wall_Fy, abtrFx, abtrFy);
-    write(fd_out, &msg, sizeof(msg));
+#if PHYSICS_THREADS > 1
+// Brings front in line with the live field if it changed. -1 on allocation failure.
+static int sync_front(void) {
+    if (!front_stale) return 0;
+    if (entities_reserve(&front_obstacles, &front_obstacles_cap, num_obstacles) < 0) return -1;
+    if (num_obstacles) memcpy(front_obstacles, obstacles, sizeof(Point) * num_obstacles);
+    sim_field_set_obstacles(&front, front_obstacles, num_obstacles);
+    sim_field_set_targets(&front, targets, num_targets);
+    front_stale = false;
+    return 0;
 }
 
-long get_time_diff_ns(struct timespec t1, struct timespec t2) {
-    return (t2.tv_sec - t1.tv_sec) * 1000000000L + (t2.tv_nsec - t1.tv_nsec);
+/* * Drains the pipe while the workers run. Entity messages go to the live arrays;
+ * the first other one may touch the swarm, so it is kept in *held for the next
+ * STEP 1 and nothing behind it is read. Returns true when a message was held.
+ */
+static bool drain_entities(int fd_in, Message *held, unsigned long *msgs_in) {
+    while (1) {
+        ssize_t n = drone_read(fd_in, held, sizeof(Message));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (!handle_entity_msg(fd_in, held)) return true;
+        (*msgs_in)++;
+        metrics_msg_in(held->type);
+    }
 }
+#endif
 
 // --- MAIN ---
 int main(int argc, char *argv[]) {
     if (argc < 5) return 1;
+    config_from_env();
 
     int fd_in   = atoi(argv[1]);
     int fd_out  = atoi(argv[2]);
     int mode    = atoi(argv[3]);
     int role    = atoi(argv[4]);
+    // Replay: argv[5] "fast" runs exactly the steps granted by TICK messages, unpaced
+    bool replay_fast = (mode == MODE_REPLAY && argc > 5 && strcmp(argv[5], "fast") == 0);
 
     signal(SIGPIPE, SIG_IGN); 
     fcntl(fd_in, F_SETFL, O_NONBLOCK);
 
-    Drone drn = {0};
-    Message msg;
+#if USE_SHM_TRANSPORT
+    world = shm_world_attach();
+    if (!world) {
+        logMessage(LOG_PATH, "[DRONE] ERROR attaching shared memory");
+        exit(1);
+    }
+    fd_wake = fd_out;
+#endif
+
+    DroneSwarm swarm;
+    if (sim_swarm_init(&swarm, NUM_DRONES) < 0) {
+        logMessage(LOG_PATH, "[DRONE] ERROR: no memory for %d drones", NUM_DRONES);
+        exit(1);
+    }
+    sim_field_init(&field);
+#if PHYSICS_THREADS > 1
+    sim_field_init(&front);
+    pool_ok = (physics_pool_init(&pool, PHYSICS_THREADS) == 0);
+    if (pool_ok) logMessage(LOG_PATH, "[DRONE] Physics on %d worker threads", PHYSICS_THREADS);
+    else logMessage(LOG_PATH, "[DRONE] ERROR starting the physics workers, stepping on one thread");
+#endif
+    Message msg, held_msg = {0};
+    bool held = false;       // A message drain_entities() left for the next STEP 1
     int win_width = 0, win_height = 0;
     bool spawned = false;
 
     // Watchdog Setup
     if(mode == MODE_STANDALONE){
-        FILE *fp_pid = fopen(PID_FILE_PATH, "a");
-        if (!fp_pid) {
-            perror("fopen PID file");
-            exit(1);
-        }
-        int fd_pid = fileno(fp_pid);
-        flock(fd_pid, LOCK_EX); 
-        publish_my_pid(fp_pid);
-        fflush(fp_pid);
-        flock(fd_pid, LOCK_UN);
-        fclose(fp_pid);
+        registry_publish(ROLE_DRONE);
 
         struct sigaction sa;
         sa.sa_handler = watchdog_ping_handler;
@@ -132,188 +458,202 @@ int main(int argc, char *argv[]) {
         sigaction(SIGUSR1, &sa, NULL);
 
         wait_for_watchdog_pid();
+        hb_join("DRONE", HB_DEADLINE_MS);
     }
-
-    struct timespec last_render_time;
-    clock_gettime(CLOCK_MONOTONIC, &last_render_time);
+    if (mode != MODE_REPLAY) {
+        metrics_join("DRONE");
+        metrics_pipe(fd_in, "bb.in");
+        metrics_pipe(fd_out, "bb.out");
+    }
+    if (mode != MODE_REPLAY) registry_ready(ROLE_DRONE);
+
+    // Fixed-step scheduler: physics at PHYSICS_HZ, output every steps_per_output steps
+    FixedStep sched;
+    fixed_step_init(&sched, PHYSICS_HZ, MAX_CATCHUP_STEPS);
+    const unsigned long steps_per_output = (PHYSICS_HZ / RENDER_FPS) > 0 ? (PHYSICS_HZ / RENDER_FPS) : 1;
+    unsigned long next_output_step = steps_per_output;
+    unsigned long next_report_step = (unsigned long)PHYSICS_HZ * SCHED_REPORT_SEC;
+    MsgForce forces = {0};
+    long step_budget = 0;
+    MsgLatency lat_echo = {0}; // Key press stamp waiting for the next publish (LATENCY=1)
+    unsigned long msgs_in = 0, publishes = 0;
+    int64_t started_ns = latency_now_ns();
 
     // --- MAIN SIMULATION LOOP ---
     while (1) {
+
+        // ====================================================================
+        // STEP 0: WAIT FOR THE NEXT PHYSICS DEADLINE
+        // ====================================================================
+        metrics_loop();
+        set_state(STATE_IDLE);
+        hb_beat();
+        int due = 0;
+        if (!replay_fast) {
+            due = fixed_step_wait(&sched);
+        } else if (step_budget == 0) {
+            // Lockstep replay: no clock, sleep on the pipe until more steps are granted
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            FD_SET(fd_in, &rfds);
+            select(fd_in + 1, &rfds, NULL, NULL, NULL);
+        }
         
         // ====================================================================
         // STEP 1: INPUT FLUSHING (Drain the pipe)
         // Legge TUTTI i messaggi disponibili. Se la blackboard manda 10 messaggi,
         // li processiamo tutti ORA invece di aspettare 10 cicli.
         // ====================================================================
-        current_state = STATE_PROCESSING_INPUT;
+        set_state(STATE_PROCESSING_INPUT);
         
         while(1) {
-            ssize_t n = read(fd_in, &msg, sizeof(Message));
+            ssize_t n;
+            if (held) {
+                msg = held_msg;
+                held = false;
+                n = sizeof(Message);
+            } else {
+                n = drone_read(fd_in, &msg, sizeof(Message));
+            }
             if (n < 0) {
                 if (errno == EAGAIN || errno == EWOULDBLOCK) break;
                 if (errno == EINTR) continue;
                 break;
             }
             if (n == 0) break;
+            msgs_in++;
+            metrics_msg_in(msg.type);
 
             // Handle Message
-            switch (msg.type) {
+            if (!handle_entity_msg(fd_in, &msg)) switch (msg.type) {
                 case MSG_TYPE_SIZE: {
-                    sscanf(msg.data, "%d %d", &win_width, &win_height);
+                    if (msg_decode_size(&msg, &win_width, &win_height) < 0) break;
 
                     if (!spawned) {
                         
                         // A. Spawn
-                        if (mode == MODE_STANDALONE) {
-                            drn.x = win_width / 2.0f;
-                            drn.y = win_height / 2.0f;
+                        // A replay passes the recorded role, 0 for a standalone session
+                        float x0 = 0.0f, y0 = 0.0f;
+                        if (mode == MODE_STANDALONE || (mode == MODE_REPLAY && role == 0)) {
+                            x0 = win_width / 2.0f;
+                            y0 = win_height / 2.0f;
                         } 
-                        else if (mode == MODE_NETWORKED) {
+                        else {
                             if (role == MODE_SERVER) {
-                                drn.x = 5.0f; drn.y = 5.0f;
+                                x0 = 5.0f; y0 = 5.0f;
                             } 
                             else if (role == MODE_CLIENT) {
-                                drn.x = (float)win_width - 5.0f;
-                                drn.y = (float)win_height - 5.0f;
+                                x0 = (float)win_width - 5.0f;
+                                y0 = (float)win_height - 5.0f;
                             }
                         }
 
-                        drn.x_1 = drn.x_2 = drn.x;
-                        drn.y_1 = drn.y_2 = drn.y;
-                        drn.Fx = drn.Fy = 0.0f;
+                        sim_swarm_spawn(&swarm, x0, y0, win_width, win_height);
                         
                         spawned = true;
                         
                         // B. Sends initial position
-                        send_position(msg, drn.x, drn.y, fd_out);
-                        logMessage(LOG_PATH, "[DRONE] Spawned at %.2f %.2f", drn.x, drn.y);
+                        const MsgForce no_forces = {0};
+                        publish_state(msg, fd_out, swarm.x[0], swarm.y[0], &no_forces, NULL);
+                        send_swarm(msg, fd_out, &swarm);
+                        logMessage(LOG_PATH, "[DRONE] Spawned at %.2f %.2f, %d drones (force kernel: %s)",
+                                   swarm.x[0], swarm.y[0], swarm.count, force_kernel_name());
                     }
                     break;
                 }
                 case MSG_TYPE_INPUT: {
-                    char ch = msg.data[0];
+                    char ch;
+                    if (msg_decode_input(&msg, &ch) < 0) break;
                     if(ch == 'q') goto quit;
-                    // Apply Forces
-                    switch(ch){
-                        case 'e':  drn.Fy -= 1.0f; break;
-                        case 'r':  drn.Fx += 1.0f; drn.Fy -= 1.0f; break;
-                        case 'f':  drn.Fx += 1.0f; break;
-                        case 'v':  drn.Fx += 1.0f; drn.Fy += 1.0f; break;
-                        case 'c':  drn.Fy += 1.0f; break;
-                        case 'x':  drn.Fx -= 1.0f; drn.Fy += 1.0f; break;
-                        case 's':  drn.Fx -= 1.0f; break;
-                        case 'w':  drn.Fx -= 1.0f; drn.Fy -= 1.0f; break;
-                        case 'd': // Brake
-                            drn.Fx *= 0.5f; drn.Fy *= 0.5f;
-                            if(fabs(drn.Fx) <= 0.5f) drn.Fx = 0.0f;
-                            if(fabs(drn.Fy) <= 0.5f) drn.Fy = 0.0f;
-                            break;
+#if LATENCY_TRACE
+                    // Keys arriving before the next publish share it: the first one is echoed
+                    if (lat_echo.id == 0 && msg_decode_latency(&msg, &lat_echo) == 0) {
+                        lat_echo.t_drone_in = latency_now_ns();
                     }
+#endif
+                    // Apply Forces
+                    apply_key(&swarm, ch);
                     break;
                 }
-                case MSG_TYPE_OBSTACLES: { 
-                    int count; sscanf(msg.data, "%d", &count); 
-                    free(obstacles); obstacles = count ? malloc(sizeof(Point)*count) : NULL; 
-                    if (obstacles) read(fd_in, obstacles, sizeof(Point)*count);
-                    num_obstacles = count; 
-                    break; 
-                }
-                case MSG_TYPE_TARGETS: { 
-                    int count; sscanf(msg.data, "%d", &count); 
-                    free(targets); targets = count ? malloc(sizeof(Point)*count) : NULL; 
-                    if (targets) read(fd_in, targets, sizeof(Point)*count);
-                    num_targets = count; 
-                    break; 
+                case MSG_TYPE_TICK: {
+                    int steps;
+                    if (msg_decode_tick(&msg, &steps) == 0) step_budget += steps;
+                    break;
                 }
                 case MSG_TYPE_EXIT: {
                     logMessage(LOG_PATH, "[DRONE] Received EXIT signal. Shutting down.");
                     goto quit;
                 }
             }
+
+            // One TICK per loop keeps later replayed messages behind the steps granted before them
+            if (replay_fast && step_budget > 0) break;
         }
 
         // ====================================================================
-        // STEP 2: PHYSICS CALCULATION (Run every cycle)
+        // STEP 2: PHYSICS CALCULATION (every step that is due)
         // ====================================================================
-        current_state = STATE_CALCULATING_PHYSICS;
-        float repFx=0.0f, repFy=0.0f, repWallFx=0.0f, repWallFy=0.0f, abtrFx = 0.0f, abtrFy = 0.0f;        
-        
-        // A. Attractive (Targets)
-        for(int i=0; i<num_targets; i++){
-            float dx = drn.x - ((float)targets[i].x + 0.5);
-            float dy = drn.y - ((float)targets[i].y + 0.5);
-            float d = sqrt(dx*dx + dy*dy) - 0.5f;
-            if(d < rho && d > 0.1f){
-                float F = eta * (1.0f/d - 1.0f/rho) / (d*d);
-                abtrFx += F * dx/d; abtrFy += F * dy/d;
-            }
+        set_state(STATE_CALCULATING_PHYSICS);
+        if (replay_fast) {
+            // Granted steps are counted like scheduled ones, so output stays every steps_per_output
+            due = (int)step_budget;
+            step_budget = 0;
+            sched.steps += due;
         }
-
-        // B. Repulsive (Obstacles)
-        for(int i=0; i<num_obstacles; i++){
-            float dx = drn.x - ((float)obstacles[i].x + 0.5);
-            float dy = drn.y - ((float)obstacles[i].y + 0.5);
-            float d = sqrt(dx*dx + dy*dy) - 0.5f;
-            if(d < rho && d > 0.1f){
-                float F = eta * (1.0f/d - 1.0f/rho) / (d*d);
-                repFx += F * dx/d; repFy += F * dy/d;
-            }
+#if PHYSICS_THREADS > 1
+        // Remote drones move the field every step: those sessions stay on this thread
+        if (pool_ok && due > 0 && num_moving == 0 && sync_front() == 0) {
+            physics_pool_start(&pool, &front, front_obstacles, &swarm, win_width, win_height, due, &forces);
+            // A replay keeps its messages behind the TICK that granted these steps
+            if (!replay_fast) held = drain_entities(fd_in, &held_msg, &msgs_in);
+            physics_pool_wait(&pool);
+            due = 0;
         }
-
-        // C. Walls
-        float dR = (win_width-1) - drn.x;
-        float dL = drn.x - 1;
-        float dT = drn.y - 1;
-        float dB = (win_height-1) - drn.y;
-        if(dR < rho) repWallFx -= eta * (1.0f/dR - 1.0f/rho)/(dR*dR);
-        if(dL < rho) repWallFx += eta * (1.0f/dL - 1.0f/rho)/(dL*dL);
-        if(dT < rho) repWallFy += eta * (1.0f/dT - 1.0f/rho)/(dT*dT);
-        if(dB < rho) repWallFy -= eta * (1.0f/dB - 1.0f/rho)/(dB*dB);
-
-        // D. Sum & Clamp
-        float totFx = drn.Fx + repFx + repWallFx - abtrFx;
-        float totFy = drn.Fy + repFy + repWallFy - abtrFy;
-        float forceMag = sqrt(totFx*totFx + totFy*totFy);
-        if(forceMag > MAX_FORCE){
-            totFx = totFx/forceMag*MAX_FORCE;
-            totFy = totFy/forceMag*MAX_FORCE;
-        }
-
-        // E. Euler Integration
-        drn.x_2 = drn.x_1; drn.x_1 = drn.x;
-        drn.y_2 = drn.y_1; drn.y_1 = drn.y;
-        drn.x = (DT*DT*totFx - drn.x_2 + (2+K*DT)*drn.x_1)/(1+K*DT);
-        drn.y = (DT*DT*totFy - drn.y_2 + (2+K*DT)*drn.y_1)/(1+K*DT);
-
-        // F. Collision
-        for(int i=0; i<num_obstacles; i++){
-            float dx = drn.x - (float)obstacles[i].x;
-            float dy = drn.y - (float)obstacles[i].y;
-            if(sqrt(dx*dx + dy*dy) <= 0.1f){
-                drn.x = drn.x_1; drn.y = drn.y_1;
-                break;
-            }
+#endif
+        for (int step = 0; step < due; step++) {
+            predict_moving_obstacles();
+            sim_swarm_step(&field, obstacles, &swarm, win_width, win_height, &forces);
         }
 
         // ====================================================================
-        // STEP 3: OUTPUT THROTTLING (Send only at ~30 FPS)
+        // STEP 3: OUTPUT THROTTLING (one publish per RENDER_FPS period of steps)
         // ====================================================================
-        struct timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        
-        if (get_time_diff_ns(last_render_time, now) >= RENDER_DT_NS) {
-            current_state = STATE_SENDING_OUTPUT;
-            send_position(msg, drn.x, drn.y, fd_out);
-            send_forces(msg, fd_out, drn.Fx, drn.Fy, repFx, repFy, repWallFx, repWallFy, abtrFx, abtrFy);
-            last_render_time = now;
+        if (sched.steps >= next_output_step) {
+            set_state(STATE_SENDING_OUTPUT);
+            publish_state(msg, fd_out, swarm.x[0], swarm.y[0], &forces, &lat_echo);
+            send_swarm(msg, fd_out, &swarm);
+            publishes++;
+            next_output_step = sched.steps + steps_per_output;
         }
 
-        usleep(1000); 
+        if (sched.steps >= next_report_step) {
+            logMessage(LOG_PATH, "[DRONE] Scheduler: %lu steps, %lu late, %lu dropped",
+                       sched.steps, sched.late_steps, sched.dropped_steps);
+            next_report_step += (unsigned long)PHYSICS_HZ * SCHED_REPORT_SEC;
+        }
     }
 
 quit:
+    logMessage(LOG_PATH, "[DRONE] Scheduler: %lu steps, %lu late, %lu dropped",
+               sched.steps, sched.late_steps, sched.dropped_steps);
+    double secs = (latency_now_ns() - started_ns) / 1e9;
+    logMessage(LOG_PATH, "[BENCH] drone: %lu physics steps of %d drones in %.1f s (%.0f steps/s), %lu msgs in, %lu publishes",
+               sched.steps, swarm.count, secs, secs > 0 ? sched.steps / secs : 0.0, msgs_in, publishes);
+    hb_leave();
+    metrics_leave();
+#if PHYSICS_THREADS > 1
+    if (pool_ok) physics_pool_free(&pool);
+    sim_field_free(&front);
+    free(front_obstacles);
+#endif
+    sim_field_free(&field);
+    sim_swarm_free(&swarm);
     free(obstacles);
+    free(obst_motion);
     free(targets);
+#if USE_SHM_TRANSPORT
+    shm_world_detach(world);
+#endif
     close(fd_in);
     close(fd_out);
     return 0;
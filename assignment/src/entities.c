@@ -0,0 +1,79 @@
+#include "entities.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+/* ======================================================================================
+ * SECTION 1: STORAGE
+ * ====================================================================================== */
+int entities_reserve(Point **pts, int *cap, int n) {
+    if (n <= *cap) return 0;
+    int new_cap = *cap ? *cap : 16;
+    while (new_cap < n) new_cap *= 2;
+    Point *p = realloc(*pts, sizeof(Point) * new_cap);
+    if (!p) return -1;
+    *pts = p;
+    *cap = new_cap;
+    return 0;
+}
+
+/* ======================================================================================
+ * SECTION 2: PAYLOADS
+ * ====================================================================================== */
+int read_full(ssize_t (*rd)(int, void *, size_t), int fd, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = rd(fd, (char *)buf + got, len - got);
+        if (n > 0) { got += (size_t)n; continue; }
+        if (n == 0) return -1;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        int r = poll(&p, 1, PAYLOAD_TIMEOUT_MS);
+        if (r == 0) return -1;
+        if (r < 0 && errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+int entities_read(ssize_t (*rd)(int, void *, size_t), int fd, Point **pts, int *cap, int count) {
+    if (count <= 0) return 0;
+    if (entities_reserve(pts, cap, count) < 0) return -1;
+    return read_full(rd, fd, *pts, sizeof(Point) * count);
+}
+
+/* ======================================================================================
+ * SECTION 3: DELTAS
+ * ====================================================================================== */
+int entities_apply(Point **pts, int *count, int *cap, uint32_t *version, const MsgEntityDelta *d) {
+    int32_t ahead = (int32_t)(d->version - *version);
+    if (ahead <= 0) return 0;
+    if (ahead != 1) return -1;
+
+    int n = *count, i = d->index;
+    Point p = { d->x, d->y };
+    switch (d->op) {
+    case ENTITY_ADD:
+        if (i < 0 || i > n || entities_reserve(pts, cap, n + 1) < 0) return -1;
+        memmove(*pts + i + 1, *pts + i, sizeof(Point) * (n - i));
+        (*pts)[i] = p;
+        (*count)++;
+        break;
+    case ENTITY_REMOVE:
+        if (i < 0 || i >= n) return -1;
+        memmove(*pts + i, *pts + i + 1, sizeof(Point) * (n - i - 1));
+        (*count)--;
+        break;
+    case ENTITY_MOVE:
+        if (i < 0 || i >= n) return -1;
+        (*pts)[i] = p;
+        break;
+    default:
+        return -1;
+    }
+    *version = d->version;
+    return 1;
+}
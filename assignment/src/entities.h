@@ -0,0 +1,43 @@
+// entities.h
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "app_common.h"
+
+// How long a payload may take to follow its header before the read gives up
+#define PAYLOAD_TIMEOUT_MS 1000
+
+/* * Obstacle and target arrays as every process keeps them: a Point array that
+ * only grows (cap), patched in place by MSG_TYPE_ENTITY_DELTA and replaced by
+ * a snapshot (MSG_TYPE_OBSTACLES / MSG_TYPE_TARGETS). Both carry the version
+ * of the array they produce, numbered by the Blackboard.
+ */
+
+// Makes room for n entries, keeping the content. Returns -1 on allocation failure.
+int entities_reserve(Point **pts, int *cap, int n);
+
+/* * Reads exactly len bytes with rd (read(), or a process's own reader with the
+ * same contract). A payload bigger than the pipe buffer arrives in pieces, so
+ * short reads are continued, and on a non-blocking fd EAGAIN waits (poll) for
+ * the rest, at most PAYLOAD_TIMEOUT_MS. Returns 0, or -1 on EOF, error or timeout.
+ */
+int read_full(ssize_t (*rd)(int, void *, size_t), int fd, void *buf, size_t len);
+
+/* * Refills *pts in place with the count entries that follow a snapshot header,
+ * growing it only when it is too small. Returns -1 when there is no memory or
+ * the payload did not arrive whole: the content is then undefined, so the
+ * caller drops the snapshot (count 0) and waits for the next one.
+ */
+int entities_read(ssize_t (*rd)(int, void *, size_t), int fd, Point **pts, int *cap, int count);
+
+/* * Applies one delta if it is the next version: returns 1 when applied, 0 when
+ * the array already has it (e.g. a replayed relocation) and -1 when a version
+ * was missed or the index is out of range, in which case nothing changes and
+ * the array stays stale until the next snapshot.
+ */
+int entities_apply(Point **pts, int *count, int *cap, uint32_t *version, const MsgEntityDelta *d);
+
+#endif
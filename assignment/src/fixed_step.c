@@ -0,0 +1,49 @@
+#include "fixed_step.h"
+
+#include <errno.h>
+
+#define NS_PER_SEC 1000000000L
+
+static void timespec_add_ns(struct timespec *t, long ns) {
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= NS_PER_SEC) {
+        t->tv_nsec -= NS_PER_SEC;
+        t->tv_sec++;
+    }
+}
+
+long timespec_diff_ns(struct timespec from, struct timespec to) {
+    return (to.tv_sec - from.tv_sec) * NS_PER_SEC + (to.tv_nsec - from.tv_nsec);
+}
+
+void fixed_step_init(FixedStep *fs, long rate_hz, int max_catchup) {
+    fs->period_ns = NS_PER_SEC / (rate_hz > 0 ? rate_hz : 1);
+    fs->max_catchup = max_catchup > 0 ? max_catchup : 1;
+    fs->steps = fs->late_steps = fs->dropped_steps = 0;
+    clock_gettime(CLOCK_MONOTONIC, &fs->next);
+    timespec_add_ns(&fs->next, fs->period_ns);
+}
+
+int fixed_step_wait(FixedStep *fs) {
+    // Absolute sleep: restarting after EINTR (watchdog signals) keeps the same deadline
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &fs->next, NULL) == EINTR);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Accumulator: every full period past the deadline is one more step owed
+    long behind = timespec_diff_ns(fs->next, now);
+    long due = 1 + (behind > 0 ? behind / fs->period_ns : 0);
+
+    if (due > 1) fs->late_steps += due - 1;
+    if (due > fs->max_catchup) {
+        fs->dropped_steps += due - fs->max_catchup;
+        // Resynchronise instead of spiralling: skip the backlog that cannot be recovered
+        timespec_add_ns(&fs->next, (due - fs->max_catchup) * fs->period_ns);
+        due = fs->max_catchup;
+    }
+
+    timespec_add_ns(&fs->next, due * fs->period_ns);
+    fs->steps += due;
+    return (int)due;
+}
@@ -0,0 +1,28 @@
+// fixed_step.h
+#ifndef FIXED_STEP_H
+#define FIXED_STEP_H
+
+#include <time.h>
+
+/* * Drift-free fixed-timestep clock.
+ * Deadlines are absolute (CLOCK_MONOTONIC + clock_nanosleep TIMER_ABSTIME), so
+ * sleep jitter never accumulates. After a stall the caller is told to run
+ * several steps to catch up, bounded by max_catchup; any excess is dropped.
+ */
+typedef struct {
+    long period_ns;
+    int max_catchup;
+    struct timespec next;          // Deadline of the next step
+    unsigned long steps;           // Steps handed out
+    unsigned long late_steps;      // Steps started after their deadline had passed by a full period
+    unsigned long dropped_steps;   // Steps skipped because the backlog exceeded max_catchup
+} FixedStep;
+
+void fixed_step_init(FixedStep *fs, long rate_hz, int max_catchup);
+
+// Sleeps until the next deadline and returns how many steps are due (>= 1).
+int fixed_step_wait(FixedStep *fs);
+
+long timespec_diff_ns(struct timespec from, struct timespec to);
+
+#endif
@@ -0,0 +1,203 @@
+#include "force_kernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if FORCE_SIMD == FORCE_SIMD_SSE
+#include <emmintrin.h>
+#elif FORCE_SIMD == FORCE_SIMD_AVX
+#include <immintrin.h>
+#elif FORCE_SIMD == FORCE_SIMD_NEON
+#if !defined(__aarch64__)
+#error "SIMD=neon needs AArch64 (vsqrtq_f32, vdivq_f32, vaddvq_f32); use SIMD=none on 32-bit ARM"
+#endif
+#include <arm_neon.h>
+#endif
+
+#define D_MIN 0.1f       // Below this the field is ignored (drone on the cell)
+#define HALF_CELL 0.5f
+
+/* ======================================================================================
+ * SECTION 1: SoA BUFFERS
+ * ====================================================================================== */
+void soa_init(PointSoA *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void soa_free(PointSoA *s) {
+    free(s->x);
+    free(s->y);
+    soa_init(s);
+}
+
+static int soa_reserve(PointSoA *s, int n) {
+    if (n <= s->cap) return 0;
+    float *nx = realloc(s->x, sizeof(float) * n);
+    if (!nx) return -1;
+    s->x = nx;
+    float *ny = realloc(s->y, sizeof(float) * n);
+    if (!ny) return -1;
+    s->y = ny;
+    s->cap = n;
+    return 0;
+}
+
+int soa_from_points(PointSoA *s, const Point *pts, int n) {
+    if (soa_reserve(s, n) < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        s->x[i] = (float)pts[i].x + HALF_CELL;
+        s->y[i] = (float)pts[i].y + HALF_CELL;
+    }
+    s->count = n;
+    return 0;
+}
+
+int soa_gather(PointSoA *dst, const PointSoA *src, const int *idx, int n) {
+    if (soa_reserve(dst, n) < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        dst->x[i] = src->x[idx[i]];
+        dst->y[i] = src->y[idx[i]];
+    }
+    dst->count = n;
+    return 0;
+}
+
+/* ======================================================================================
+ * SECTION 2: SCALAR REFERENCE
+ * ====================================================================================== */
+void force_sum_scalar(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy) {
+    float sx = 0.0f, sy = 0.0f;
+    for (int i = 0; i < s->count; i++) {
+        float dx = px - s->x[i];
+        float dy = py - s->y[i];
+        float d = sqrtf(dx*dx + dy*dy) - HALF_CELL;
+        if (d < range && d > D_MIN) {
+            float F = gain * (1.0f/d - 1.0f/range) / (d*d);
+            sx += F * dx/d; sy += F * dy/d;
+        }
+    }
+    *fx = sx;
+    *fy = sy;
+}
+
+/* ======================================================================================
+ * SECTION 3: VECTOR KERNELS
+ * Per lane: k = gain * (1/d - 1/range) / d^3, masked to 0 outside (D_MIN, range),
+ * then f += k * (dx, dy). One divide per lane, no branches.
+ * ====================================================================================== */
+#if FORCE_SIMD != FORCE_SIMD_NONE
+// Remainder lanes, same math as the vector body
+static void force_tail(const PointSoA *s, int i, float px, float py, float range, float gain, float *fx, float *fy) {
+    for (; i < s->count; i++) {
+        float dx = px - s->x[i];
+        float dy = py - s->y[i];
+        float d = sqrtf(dx*dx + dy*dy) - HALF_CELL;
+        if (d < range && d > D_MIN) {
+            float inv = 1.0f / d;
+            float k = gain * (inv - 1.0f/range) * inv * inv * inv;
+            *fx += k * dx; *fy += k * dy;
+        }
+    }
+}
+#endif
+
+#if FORCE_SIMD == FORCE_SIMD_SSE
+void force_sum(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy) {
+    const __m128 vpx = _mm_set1_ps(px), vpy = _mm_set1_ps(py);
+    const __m128 half = _mm_set1_ps(HALF_CELL), one = _mm_set1_ps(1.0f);
+    const __m128 vrange = _mm_set1_ps(range), vmin = _mm_set1_ps(D_MIN);
+    const __m128 vinv_range = _mm_set1_ps(1.0f / range), vgain = _mm_set1_ps(gain);
+    __m128 accx = _mm_setzero_ps(), accy = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= s->count; i += 4) {
+        __m128 dx = _mm_sub_ps(vpx, _mm_loadu_ps(s->x + i));
+        __m128 dy = _mm_sub_ps(vpy, _mm_loadu_ps(s->y + i));
+        __m128 d = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))), half);
+        __m128 mask = _mm_and_ps(_mm_cmplt_ps(d, vrange), _mm_cmpgt_ps(d, vmin));
+        __m128 inv = _mm_div_ps(one, d);
+        __m128 inv3 = _mm_mul_ps(_mm_mul_ps(inv, inv), inv);
+        __m128 k = _mm_and_ps(_mm_mul_ps(_mm_mul_ps(vgain, _mm_sub_ps(inv, vinv_range)), inv3), mask);
+        accx = _mm_add_ps(accx, _mm_mul_ps(k, dx));
+        accy = _mm_add_ps(accy, _mm_mul_ps(k, dy));
+    }
+
+    float lx[4], ly[4];
+    _mm_storeu_ps(lx, accx);
+    _mm_storeu_ps(ly, accy);
+    *fx = (lx[0] + lx[1]) + (lx[2] + lx[3]);
+    *fy = (ly[0] + ly[1]) + (ly[2] + ly[3]);
+    force_tail(s, i, px, py, range, gain, fx, fy);
+}
+
+#elif FORCE_SIMD == FORCE_SIMD_AVX
+void force_sum(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy) {
+    const __m256 vpx = _mm256_set1_ps(px), vpy = _mm256_set1_ps(py);
+    const __m256 half = _mm256_set1_ps(HALF_CELL), one = _mm256_set1_ps(1.0f);
+    const __m256 vrange = _mm256_set1_ps(range), vmin = _mm256_set1_ps(D_MIN);
+    const __m256 vinv_range = _mm256_set1_ps(1.0f / range), vgain = _mm256_set1_ps(gain);
+    __m256 accx = _mm256_setzero_ps(), accy = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= s->count; i += 8) {
+        __m256 dx = _mm256_sub_ps(vpx, _mm256_loadu_ps(s->x + i));
+        __m256 dy = _mm256_sub_ps(vpy, _mm256_loadu_ps(s->y + i));
+        __m256 d = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))), half);
+        __m256 mask = _mm256_and_ps(_mm256_cmp_ps(d, vrange, _CMP_LT_OQ), _mm256_cmp_ps(d, vmin, _CMP_GT_OQ));
+        __m256 inv = _mm256_div_ps(one, d);
+        __m256 inv3 = _mm256_mul_ps(_mm256_mul_ps(inv, inv), inv);
+        __m256 k = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(vgain, _mm256_sub_ps(inv, vinv_range)), inv3), mask);
+        accx = _mm256_add_ps(accx, _mm256_mul_ps(k, dx));
+        accy = _mm256_add_ps(accy, _mm256_mul_ps(k, dy));
+    }
+
+    float lx[8], ly[8];
+    _mm256_storeu_ps(lx, accx);
+    _mm256_storeu_ps(ly, accy);
+    *fx = ((lx[0] + lx[1]) + (lx[2] + lx[3])) + ((lx[4] + lx[5]) + (lx[6] + lx[7]));
+    *fy = ((ly[0] + ly[1]) + (ly[2] + ly[3])) + ((ly[4] + ly[5]) + (ly[6] + ly[7]));
+    force_tail(s, i, px, py, range, gain, fx, fy);
+}
+
+#elif FORCE_SIMD == FORCE_SIMD_NEON
+void force_sum(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy) {
+    const float32x4_t vpx = vdupq_n_f32(px), vpy = vdupq_n_f32(py);
+    const float32x4_t half = vdupq_n_f32(HALF_CELL), one = vdupq_n_f32(1.0f);
+    const float32x4_t vrange = vdupq_n_f32(range), vmin = vdupq_n_f32(D_MIN);
+    const float32x4_t vinv_range = vdupq_n_f32(1.0f / range), vgain = vdupq_n_f32(gain);
+    float32x4_t accx = vdupq_n_f32(0.0f), accy = vdupq_n_f32(0.0f);
+
+    int i = 0;
+    for (; i + 4 <= s->count; i += 4) {
+        float32x4_t dx = vsubq_f32(vpx, vld1q_f32(s->x + i));
+        float32x4_t dy = vsubq_f32(vpy, vld1q_f32(s->y + i));
+        float32x4_t d = vsubq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy))), half);
+        uint32x4_t mask = vandq_u32(vcltq_f32(d, vrange), vcgtq_f32(d, vmin));
+        float32x4_t inv = vdivq_f32(one, d);
+        float32x4_t inv3 = vmulq_f32(vmulq_f32(inv, inv), inv);
+        float32x4_t k = vmulq_f32(vmulq_f32(vgain, vsubq_f32(inv, vinv_range)), inv3);
+        k = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(k), mask));
+        accx = vaddq_f32(accx, vmulq_f32(k, dx));
+        accy = vaddq_f32(accy, vmulq_f32(k, dy));
+    }
+
+    *fx = vaddvq_f32(accx);
+    *fy = vaddvq_f32(accy);
+    force_tail(s, i, px, py, range, gain, fx, fy);
+}
+
+#else
+void force_sum(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy) {
+    force_sum_scalar(s, px, py, range, gain, fx, fy);
+}
+#endif
+
+const char *force_kernel_name(void) {
+    switch (FORCE_SIMD) {
+        case FORCE_SIMD_SSE:  return "sse";
+        case FORCE_SIMD_AVX:  return "avx";
+        case FORCE_SIMD_NEON: return "neon";
+        default:              return "scalar";
+    }
+}
@@ -0,0 +1,45 @@
+// force_kernel.h
+#ifndef FORCE_KERNEL_H
+#define FORCE_KERNEL_H
+
+#include "app_common.h"
+
+/* Build option: make SIMD=sse|avx|neon selects the vector kernel.
+ * 0 (SIMD=none) keeps the scalar reference loop. */
+#define FORCE_SIMD_NONE 0
+#define FORCE_SIMD_SSE  1
+#define FORCE_SIMD_AVX  2
+#define FORCE_SIMD_NEON 3
+
+#ifndef FORCE_SIMD
+#define FORCE_SIMD FORCE_SIMD_NONE
+#endif
+
+/* * Structure-of-arrays float copy of entity cells.
+ * Coordinates are cell centres (x + 0.5, y + 0.5), as used by the Latombe model.
+ */
+typedef struct {
+    float *x, *y;
+    int count, cap;
+} PointSoA;
+
+void soa_init(PointSoA *s);
+void soa_free(PointSoA *s);
+// Replaces the content with the centres of pts[0..n). Returns -1 on allocation failure.
+int  soa_from_points(PointSoA *s, const Point *pts, int n);
+// Copies the entries src[idx[0..n)] into dst (e.g. the hits of a grid query).
+int  soa_gather(PointSoA *dst, const PointSoA *src, const int *idx, int n);
+
+/* * Sums the Latombe field eta * (1/d - 1/rho) / d^2 * (dx/d, dy/d) of every
+ * entity with 0.1 < d < rho, where d is the distance from (px, py) to the
+ * cell centre minus half a cell.
+ * force_sum_scalar() is the reference loop; force_sum() uses the vector
+ * kernel selected at build time.
+ */
+void force_sum_scalar(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy);
+void force_sum(const PointSoA *s, float px, float py, float range, float gain, float *fx, float *fy);
+
+// Name of the compiled kernel, for logging
+const char *force_kernel_name(void);
+
+#endif
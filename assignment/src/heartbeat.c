@@ -0,0 +1,107 @@
+#include "heartbeat.h"
+#include "app_common.h"
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static HbTable *table = NULL;            // This process's mapping (hb_join)
+static HbSlot *own = NULL;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+/* ======================================================================================
+ * SECTION 1: SEGMENT LIFETIME
+ * ====================================================================================== */
+int heartbeat_create(void) {
+    int fd = shm_open(HB_SEGMENT_NAME, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        logMessage(LOG_PATH, "[HB] ERROR shm_open: %s", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(HbTable)) < 0) {
+        logMessage(LOG_PATH, "[HB] ERROR ftruncate: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    HbTable *t = mmap(NULL, sizeof(HbTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED) {
+        logMessage(LOG_PATH, "[HB] ERROR mmap: %s", strerror(errno));
+        return -1;
+    }
+
+    // ftruncate zero-fills the segment: every slot starts free
+    t->magic = HB_MAGIC;
+    munmap(t, sizeof(HbTable));
+    return 0;
+}
+
+void heartbeat_unlink(void) {
+    shm_unlink(HB_SEGMENT_NAME);
+}
+
+HbTable *heartbeat_attach(void) {
+    int fd = shm_open(HB_SEGMENT_NAME, O_RDWR, 0600);
+    if (fd < 0) return NULL;
+    HbTable *t = mmap(NULL, sizeof(HbTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED) return NULL;
+    if (t->magic != HB_MAGIC) {
+        munmap(t, sizeof(HbTable));
+        return NULL;
+    }
+    return t;
+}
+
+void heartbeat_detach(HbTable *t) {
+    if (t) munmap(t, sizeof(HbTable));
+}
+
+/* ======================================================================================
+ * SECTION 2: PROCESS SIDE
+ * ====================================================================================== */
+void hb_join(const char *name, uint32_t deadline_ms) {
+    if (!USE_HEARTBEAT || table) return;
+    table = heartbeat_attach();
+    if (!table) {
+        logMessage(LOG_PATH, "[HB] No heartbeat segment, %s is not watched", name);
+        return;
+    }
+    uint32_t i = atomic_fetch_add(&table->used, 1);
+    if (i >= HB_MAX_SLOTS) {
+        logMessage(LOG_PATH, "[HB] ERROR no free heartbeat slot for %s", name);
+        heartbeat_detach(table);
+        table = NULL;
+        return;
+    }
+    own = &table->slot[i];
+    strncpy(own->name, name, sizeof(own->name) - 1);
+    own->deadline_ms = deadline_ms;
+    atomic_store_explicit(&own->beat_ns, monotonic_ns(), memory_order_relaxed);
+    atomic_store_explicit(&own->pid, (int32_t)getpid(), memory_order_release);
+}
+
+void hb_beat(void) {
+    if (!own) return;
+    atomic_store_explicit(&own->beat_ns, monotonic_ns(), memory_order_release);
+    atomic_fetch_add_explicit(&own->beats, 1, memory_order_relaxed);
+}
+
+void hb_leave(void) {
+    if (!own) return;
+    atomic_store_explicit(&own->pid, 0, memory_order_release);
+    heartbeat_detach(table);
+    table = NULL;
+    own = NULL;
+}
@@ -0,0 +1,58 @@
+// heartbeat.h
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Build option: make HEARTBEAT=1 replaces the Watchdog's sequential SIGUSR1/SIGUSR2
+ * ping round with heartbeats the processes publish in shared memory. */
+#ifndef USE_HEARTBEAT
+#define USE_HEARTBEAT 0
+#endif
+#ifndef HB_PERIOD_MS
+#define HB_PERIOD_MS   100               // Watchdog scan period
+#endif
+#ifndef HB_DEADLINE_MS
+#define HB_DEADLINE_MS 1000              // Silence allowed before a process counts as hung
+#endif
+
+#define HB_SEGMENT_NAME "/arp_heartbeat"
+#define HB_MAGIC        0x42485241u      // "ARHB"
+#define HB_MAX_SLOTS    16
+
+/* * One slot per process, on its own cache line. The owner fills name and
+ * deadline_ms before publishing pid, the Watchdog reads them after seeing it;
+ * pid goes back to 0 when the process leaves cleanly.
+ */
+typedef struct {
+    _Alignas(64) _Atomic int32_t pid;
+    uint32_t deadline_ms;
+    _Atomic uint64_t beat_ns;            // CLOCK_MONOTONIC of the last beat
+    _Atomic uint64_t beats;
+    char name[16];
+} HbSlot;
+
+typedef struct {
+    uint32_t magic;
+    _Atomic uint32_t used;               // Slots handed out so far
+    HbSlot slot[HB_MAX_SLOTS];
+} HbTable;
+
+// Creates (or truncates) the segment. Called once by main before forking.
+int heartbeat_create(void);
+void heartbeat_unlink(void);
+// Maps the segment (the Watchdog's view). Returns NULL on failure.
+HbTable *heartbeat_attach(void);
+void heartbeat_detach(HbTable *t);
+
+/* * Process side. hb_join() claims a slot and beats once; hb_beat() is meant for
+ * the main loop, so it proves the loop runs, not just that signals are handled.
+ * All three are no-ops in builds without HEARTBEAT=1 or when the segment is
+ * missing (e.g. a process started on its own), so call sites need no checks.
+ */
+void hb_join(const char *name, uint32_t deadline_ms);
+void hb_beat(void);
+void hb_leave(void);
+
+#endif
@@ -10,11 +10,14 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/stat.h>
-#include <sys/file.h>
 
 #include "process_pid.h"
 #include "app_common.h"
 #include "log.h"       
+#include "msg_codec.h"
+#include "latency.h"
+#include "heartbeat.h"
+#include "metrics.h"
 
 #define KEY_QUIT 'q'
 
@@ -34,31 +37,12 @@ void draw_legend() {
     refresh();
 }
 
-void publish_my_pid(FILE *fp) {
-    fprintf(fp, "%s %d\n", INPUT_PID_TAG, getpid());
+void publish_my_pid(void) {
+    registry_publish(ROLE_INPUT);
 }
 
 void wait_for_watchdog_pid() {
-    FILE *fp;
-    char line[256], tag[128];
-    int pid_temp;
-    bool wd_found = false;
-    while (!wd_found) {
-        fp = fopen(PID_FILE_PATH, "r");
-        if (fp) {
-            while (fgets(line, sizeof(line), fp)) {
-                if (sscanf(line, "%s %d", tag, &pid_temp) == 2) {
-                    if (strcmp(tag, WD_PID_TAG) == 0) {
-                        watchdog_pid = (pid_t)pid_temp;
-                        wd_found = true;
-                        break;
-                    }
-                }
-            }
-            fclose(fp);
-        }
-        if (!wd_found) usleep(200000);
-    }
+    watchdog_pid = registry_wait(ROLE_WATCHDOG, -1);
 }
 
 void watchdog_ping_handler(int signo) {
@@ -66,25 +50,62 @@ void watchdog_ping_handler(int signo) {
     if(watchdog_pid > 0) kill(watchdog_pid, SIGUSR2);
 }
 
+// One key to the Blackboard: a raw byte pair, or a stamped Message (LATENCY=1)
+static int send_key(int fd_out, int ch) {
+    metrics_state(MET_BROADCAST);
+    metrics_msg_out(MSG_TYPE_INPUT);
+#if LATENCY_TRACE
+    static uint32_t key_id = 0;
+    // One stamped Message per key, followed up to the screen by the Blackboard
+    MsgLatency lat = {0};
+    lat.id = ++key_id;
+    lat.t_input = latency_now_ns();
+    Message msg;
+    msg_encode_input_stamped(&msg, (char)ch, &lat);
+    return (metrics_write(fd_out, &msg, sizeof(msg)) < 0) ? -1 : 0;
+#else
+    char msg_buf[2] = { (char)ch, '\0' };
+    return (metrics_write(fd_out, msg_buf, 2) < 0) ? -1 : 0;
+#endif
+}
+
+/*
+ * Headless: replays keys[] in a loop at hz keys per second (absolute deadlines),
+ * then quits the session after the given number of seconds.
+ */
+static void run_script(int fd_out, const char *keys, double hz, double seconds) {
+    size_t n = strlen(keys);
+    long long period_ns = (hz > 0) ? (long long)(1e9 / hz) : 50000000LL;
+    long long keys_total = (long long)(seconds * 1e9) / period_ns;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    logMessage(LOG_PATH, "[INPUT] Scripted: \"%s\" at %.1f keys/s for %.1f s", keys, hz, seconds);
+    // One key per deadline, the quit included: two keys in one read are one record
+    for (long long i = 0; i <= keys_total; i++) {
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) { next.tv_nsec -= 1000000000L; next.tv_sec++; }
+        metrics_loop();
+        metrics_state(MET_IDLE);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {}
+        hb_beat();
+        if (i == keys_total) break;
+        if (!n || keys[i % n] == KEY_QUIT) continue; // Only the end of the script quits
+        if (send_key(fd_out, keys[i % n]) < 0) return;
+    }
+    send_key(fd_out, KEY_QUIT);
+}
+
 int main(int argc, char *argv[]) {
     if(argc < 3) return 1;
+    config_from_env();
 
     int fd_out = atoi(argv[1]);
     int mode = atoi(argv[2]);
 
     if(mode == MODE_STANDALONE){
         // 1. PUBBLICA IL PID SUBITO
-        FILE *fp_pid = fopen(PID_FILE_PATH, "a");
-        if (!fp_pid) {
-            perror("fopen PID file");
-            exit(1);
-        }
-        int fd_pid = fileno(fp_pid);
-        flock(fd_pid, LOCK_EX); 
-        publish_my_pid(fp_pid);
-        fflush(fp_pid);
-        flock(fd_pid, LOCK_UN);
-        fclose(fp_pid);
+        publish_my_pid();
 
         // 2. SETUP SEGNALI
         struct sigaction sa;
@@ -96,10 +117,25 @@ int main(int argc, char *argv[]) {
         // 3. ASPETTA IL WATCHDOG
         wait_for_watchdog_pid();
     }
-    
-    int ch;
-    char msg_buf[2];
+    registry_ready(ROLE_INPUT);
+    metrics_join("INPUT");
+    metrics_pipe(fd_out, "bb.out");
+
+    // Headless: <keys> <keys per second> <seconds> replace the keyboard
+    if (argc >= 6) {
+        double hz = atof(argv[4]);
+        // Beats once per key: a slow script needs a longer deadline
+        uint32_t deadline_ms = (hz > 0 && 2000.0 / hz > HB_DEADLINE_MS) ? (uint32_t)(2000.0 / hz) : HB_DEADLINE_MS;
+        if (mode == MODE_STANDALONE) hb_join("INPUT", deadline_ms);
+        run_script(fd_out, argv[3], hz, atof(argv[5]));
+        hb_leave();
+        metrics_leave();
+        close(fd_out);
+        return 0;
+    }
+    if (mode == MODE_STANDALONE) hb_join("INPUT", HB_DEADLINE_MS);
 
+    int ch;
     initscr();
     cbreak();
     noecho();
@@ -108,17 +144,18 @@ int main(int argc, char *argv[]) {
     draw_legend();
 
     while(1) {
+        metrics_loop();
+        hb_beat();
+        metrics_state(MET_INPUT);
         ch = getch();
 
         if(ch == ERR) {
+            metrics_state(MET_IDLE);
             usleep(10000); // 10ms sleep to save CPU
             continue;
         }
 
-        msg_buf[0] = (char)ch;
-        msg_buf[1] = '\0';
-
-        if(write(fd_out, msg_buf, 2) < 0) break;
+        if(send_key(fd_out, ch) < 0) break;
         mvprintw(14, 0, "Feedback: '%c'  ", ch);
         refresh();
 
@@ -129,6 +166,8 @@ int main(int argc, char *argv[]) {
     }
 
     quit:
+    hb_leave();
+    metrics_leave();
     endwin();
     close(fd_out);
     return 0;
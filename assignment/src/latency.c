@@ -0,0 +1,89 @@
+#include "latency.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define LAT_SUB (1 << LAT_SUB_BITS)
+
+static const char *hop_names[LAT_HOP_COUNT] = {
+    "input->bb", "bb->drone", "drone", "drone->bb", "bb->screen", "end-to-end"
+};
+
+/* ======================================================================================
+ * SECTION 1: HISTOGRAM
+ * ====================================================================================== */
+int64_t latency_now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+// Values below LAT_SUB get a bucket each, then LAT_SUB buckets per power of two
+static int bucket_of(uint64_t v) {
+    if (v < LAT_SUB) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - LAT_SUB_BITS;
+    return ((shift + 1) << LAT_SUB_BITS) | (int)((v >> shift) & (LAT_SUB - 1));
+}
+
+static int64_t bucket_upper(int idx) {
+    if (idx < LAT_SUB) return idx;
+    int shift = (idx >> LAT_SUB_BITS) - 1;
+    int64_t mant = (idx & (LAT_SUB - 1)) | LAT_SUB;
+    return ((mant + 1) << shift) - 1;
+}
+
+void lat_hist_add(LatHist *h, int64_t ns) {
+    if (ns < 0) ns = 0; // Clock reads on different CPUs: never trust a negative hop
+    h->buckets[bucket_of((uint64_t)ns)]++;
+    h->count++;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
+
+int64_t lat_hist_percentile(const LatHist *h, double p) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            int64_t v = bucket_upper(i);
+            return (v > h->max_ns) ? h->max_ns : v;
+        }
+    }
+    return h->max_ns;
+}
+
+/* ======================================================================================
+ * SECTION 2: KEY PRESS PATH
+ * ====================================================================================== */
+void lat_path_record(LatPath *p, const MsgLatency *l, int64_t t_position, int64_t t_frame) {
+    lat_hist_add(&p->hops[LAT_HOP_INPUT_BB], l->t_bb - l->t_input);
+    lat_hist_add(&p->hops[LAT_HOP_BB_DRONE], l->t_drone_in - l->t_bb);
+    lat_hist_add(&p->hops[LAT_HOP_DRONE], l->t_drone_out - l->t_drone_in);
+    lat_hist_add(&p->hops[LAT_HOP_DRONE_BB], t_position - l->t_drone_out);
+    lat_hist_add(&p->hops[LAT_HOP_RENDER], t_frame - t_position);
+    lat_hist_add(&p->hops[LAT_HOP_TOTAL], t_frame - l->t_input);
+}
+
+void lat_path_format(const LatPath *p, char *buf, size_t cap) {
+    const LatHist *h = &p->hops[LAT_HOP_TOTAL];
+    if (h->count == 0) {
+        snprintf(buf, cap, "e2e -");
+        return;
+    }
+    snprintf(buf, cap, "e2e %.1f/%.1f/%.1fms",
+             lat_hist_percentile(h, 50) / 1e6, lat_hist_percentile(h, 99) / 1e6, h->max_ns / 1e6);
+}
+
+void lat_path_log(const LatPath *p, const char *filename) {
+    for (int i = 0; i < LAT_HOP_COUNT; i++) {
+        const LatHist *h = &p->hops[i];
+        logMessage(filename, "[LAT] %-10s n=%llu p50=%.3fms p99=%.3fms max=%.3fms", hop_names[i],
+                   (unsigned long long)h->count, lat_hist_percentile(h, 50) / 1e6,
+                   lat_hist_percentile(h, 99) / 1e6, h->max_ns / 1e6);
+    }
+}
@@ -0,0 +1,57 @@
+// latency.h
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "app_common.h"
+
+/* Build option: make LATENCY=1 stamps every key press in Input and follows it
+ * through Blackboard -> Drone -> Blackboard -> screen. Off, nothing is stamped. */
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE 0
+#endif
+
+/* * Log-linear histogram of nanosecond samples: 8 buckets per power of two,
+ * so a reported percentile is at most 12.5% above the true value.
+ */
+#define LAT_SUB_BITS 3
+#define LAT_BUCKETS  (64 << LAT_SUB_BITS)
+
+typedef struct {
+    uint64_t count;
+    int64_t max_ns;
+    uint32_t buckets[LAT_BUCKETS];
+} LatHist;
+
+// Hops of a key press, in pipeline order (see MsgLatency)
+typedef enum {
+    LAT_HOP_INPUT_BB,      // Input write -> Blackboard read
+    LAT_HOP_BB_DRONE,      // Blackboard forward -> Drone read
+    LAT_HOP_DRONE,         // Drone read -> position published (physics + output throttling)
+    LAT_HOP_DRONE_BB,      // Drone publish -> Blackboard read
+    LAT_HOP_RENDER,        // Blackboard read -> frame on screen
+    LAT_HOP_TOTAL,         // Input write -> frame on screen
+    LAT_HOP_COUNT
+} LatHop;
+
+typedef struct {
+    LatHist hops[LAT_HOP_COUNT];
+} LatPath;
+
+// CLOCK_MONOTONIC in ns: shared by all processes on the host
+int64_t latency_now_ns(void);
+
+void    lat_hist_add(LatHist *h, int64_t ns);
+// Upper bound of the bucket holding the p-th percentile (0 < p <= 100), 0 if empty
+int64_t lat_hist_percentile(const LatHist *h, double p);
+
+// Adds one echoed key press, seen by the Blackboard at t_position and drawn at t_frame
+void lat_path_record(LatPath *p, const MsgLatency *l, int64_t t_position, int64_t t_frame);
+// "e2e p50/p99/max ms" for the status bar
+void lat_path_format(const LatPath *p, char *buf, size_t cap);
+// One log line per hop
+void lat_path_log(const LatPath *p, const char *filename);
+
+#endif
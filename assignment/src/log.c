@@ -1,40 +1,142 @@
 #include "log.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <errno.h>
 #include <time.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/stat.h>
-#include <sys/file.h>
 
-void logMessage(const char *filename, const char *format, ...) {
+#define LOG_MAX_FILES 4
+#define LOG_LINE_MAX  1024
+
+typedef struct {
+    char path[64];
+    int fd;
+    size_t len;
+    long long last_flush_ms;
+    char buf[LOG_BUF_SIZE];
+} LogFile;
+
+static LogFile files[LOG_MAX_FILES];
+static int file_count = 0;
+static int initialised = 0;
+static pid_t my_pid = 0;
+
+// One strftime() per second instead of one per line
+static time_t cached_sec = (time_t)-1;
+static char cached_stamp[32];
+
+/* ======================================================================================
+ * SECTION 1: INTERNAL HELPERS
+ * ====================================================================================== */
+static long long monotonic_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &t);
+    return (long long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static void flush_file(LogFile *f) {
+    size_t off = 0;
+    while (off < f->len) {
+        ssize_t n = write(f->fd, f->buf + off, f->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break; // Nowhere to report it: drop the buffer
+        off += (size_t)n;
+    }
+    f->len = 0;
+    f->last_flush_ms = monotonic_ms();
+}
+
+/* * A forked child starts with a copy of the parent's buffers: the parent
+ * writes those lines, the child only needs its own PID and an empty buffer.
+ */
+static void after_fork_child(void) {
+    my_pid = getpid();
+    for (int i = 0; i < file_count; i++) {
+        files[i].len = 0;
+        files[i].last_flush_ms = 0;
+    }
+}
+
+static void init_once(void) {
+    if (initialised) return;
+    initialised = 1;
+    my_pid = getpid();
+    atexit(log_flush);
+    pthread_atfork(NULL, NULL, after_fork_child);
+}
+
+static LogFile *get_file(const char *filename) {
+    for (int i = 0; i < file_count; i++) {
+        if (strcmp(files[i].path, filename) == 0) return &files[i];
+    }
+    if (file_count == LOG_MAX_FILES) return NULL;
+
     mkdir("logs", 0777);
+    int fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return NULL;
 
-    FILE *fp = fopen(filename, "a");
-    if (!fp) return;
+    LogFile *f = &files[file_count++];
+    snprintf(f->path, sizeof(f->path), "%s", filename);
+    f->fd = fd;
+    f->len = 0;
+    f->last_flush_ms = 0;
+    return f;
+}
 
-    int fd = fileno(fp); 
-    
-    flock(fd, LOCK_EX); 
+static void log_vwrite(int level, const char *filename, const char *format, va_list args) {
+    init_once();
+    LogFile *f = get_file(filename);
+    if (!f) return;
 
     time_t t = time(NULL);
-    struct tm tm_info;
-    localtime_r(&t, &tm_info);
+    if (t != cached_sec) {
+        struct tm tm_info;
+        localtime_r(&t, &tm_info);
+        strftime(cached_stamp, sizeof(cached_stamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+        cached_sec = t;
+    }
 
-    char timebuf[32];
-    strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &tm_info);
+    char line[LOG_LINE_MAX];
+    int n = snprintf(line, sizeof(line), "[%s] (PID %d) ", cached_stamp, (int)my_pid);
+    int m = vsnprintf(line + n, sizeof(line) - n, format, args);
+    size_t len = (m < 0) ? (size_t)n : (size_t)n + (size_t)m;
+    if (len > sizeof(line) - 2) len = sizeof(line) - 2; // Truncated: keep room for '\n'
+    line[len++] = '\n';
 
-    fprintf(fp, "[%s] (PID %d) ", timebuf, getpid());
+    if (f->len + len > sizeof(f->buf)) flush_file(f);
+    memcpy(f->buf + f->len, line, len);
+    f->len += len;
 
+    if (level >= LOG_LEVEL_ERROR || f->len >= sizeof(f->buf) * 3 / 4 ||
+        monotonic_ms() - f->last_flush_ms >= LOG_FLUSH_MS) {
+        flush_file(f);
+    }
+}
+
+/* ======================================================================================
+ * SECTION 2: PUBLIC API
+ * ====================================================================================== */
+void logMessage(const char *filename, const char *format, ...) {
     va_list args;
     va_start(args, format);
-    vfprintf(fp, format, args);
+    log_vwrite(LOG_LEVEL_INFO, filename, format, args);
     va_end(args);
+}
 
-    fprintf(fp, "\n");
-
-    fflush(fp);
-    
-    flock(fd, LOCK_UN);
+void logMessageLevel(int level, const char *filename, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(level, filename, format, args);
+    va_end(args);
+}
 
-    fclose(fp);
-}
\ No newline at end of file
+void log_flush(void) {
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].len) flush_file(&files[i]);
+    }
+}
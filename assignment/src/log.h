@@ -2,7 +2,36 @@
 #ifndef LOG_H
 #define LOG_H
 
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_ERROR 2
+
+/* Build option: make LOG_DEBUG=1 sets LOG_MIN_LEVEL to LOG_LEVEL_DEBUG.
+ * Below the minimum level, LOG_DEBUG() lines are removed at compile time. */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+/* * Lines are buffered per file and written with a single O_APPEND write(),
+ * so lines from different processes never interleave. A buffer is flushed
+ * when it fills up, when its last flush is older than LOG_FLUSH_MS, on every
+ * ERROR line and at exit.
+ */
+#define LOG_BUF_SIZE  8192
+#define LOG_FLUSH_MS  100
+
 // Scrive un messaggio nel file di log specificato (in append) con timestamp
-void logMessage(const char *filename, const char *format, ...);
+void logMessage(const char *filename, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void logMessageLevel(int level, const char *filename, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+// Writes out every buffered line (e.g. before exec or a SIGKILL)
+void log_flush(void);
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(file, ...) logMessageLevel(LOG_LEVEL_DEBUG, file, __VA_ARGS__)
+#else
+#define LOG_DEBUG(file, ...) ((void)0)
+#endif
+#define LOG_ERROR(file, ...) logMessageLevel(LOG_LEVEL_ERROR, file, __VA_ARGS__)
 
 #endif
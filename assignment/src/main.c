@@ -9,6 +9,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -16,6 +17,10 @@
 #include "log.h"
 #include "app_common.h"
 #include "process_pid.h"
+#include "shm_ipc.h"
+#include "heartbeat.h"
+#include "metrics.h"
+#include "latency.h"
 
 /* --------------------------------------------------------------------------------------
  * SECTION 1: LOG DIRECTORY CREATION
@@ -38,37 +43,115 @@ void ensureLogsDir(void) {
 }
 
 /* --------------------------------------------------------------------------------------
- * SECTION 2: MAIN
+ * SECTION 2: HEADLESS BENCHMARK
+ * `./exec/main headless [seconds] [keys] [keys per second]` runs a standalone session
+ * with no terminal: the Blackboard renders nothing, the Input process plays the key
+ * script, and the CPU time of every child is reported when they have exited.
  * ------------------------------------------------------------------------------------- */
-int main(void) {
+#define BENCH_DEFAULT_SECONDS "10"
+#define BENCH_DEFAULT_KEYS    "ffrrvvccxxsswwee"
+#define BENCH_DEFAULT_HZ      "20"
+
+typedef struct {
+    pid_t pid;
+    const char *name;
+} Child;
+
+static void wait_and_report(const Child *children, int n) {
+    struct rusage ru;
+    pid_t pid;
+    while ((pid = wait4(-1, NULL, 0, &ru)) > 0) {
+        const char *name = "?";
+        for (int i = 0; i < n; i++) {
+            if (children[i].pid == pid) name = children[i].name;
+        }
+        double user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+        double sys  = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+        logMessage(LOG_PATH, "[BENCH] cpu %s: %.3f s user, %.3f s sys", name, user, sys);
+    }
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 3: STARTUP BARRIER
+ * Every child is forked without waiting for the previous one; each reports ready in
+ * the PID registry once its setup is done and blocks until main releases them all
+ * together, so the session starts when the slowest process is ready and not later.
+ * ------------------------------------------------------------------------------------- */
+#define STARTUP_TIMEOUT_MS 5000   // Release anyway if a process never reports ready
+
+static void startup_barrier(const int64_t *spawn_ns, uint32_t expected) {
+    int64_t first = 0;
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        if ((expected & ROLE_BIT(role)) && (first == 0 || spawn_ns[role] < first)) first = spawn_ns[role];
+    }
+
+    uint32_t ready = registry_barrier(STARTUP_TIMEOUT_MS);
+    int64_t released = latency_now_ns();
+
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        if (!(expected & ROLE_BIT(role))) continue;
+        if (ready & ROLE_BIT(role)) {
+            logMessage(LOG_PATH, "[MAIN] Startup: %s ready %.1f ms after its fork",
+                       registry_role_name(role), (registry_ready_ns(role) - spawn_ns[role]) / 1e6);
+        } else {
+            logMessage(LOG_PATH, "[MAIN] Startup: %s not ready after %d ms, released without it",
+                       registry_role_name(role), STARTUP_TIMEOUT_MS);
+        }
+    }
+    logMessage(LOG_PATH, "[MAIN] Startup barrier released %.1f ms after the first fork", (released - first) / 1e6);
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 4: MAIN
+ * ------------------------------------------------------------------------------------- */
+int main(int argc, char *argv[]) {
+
+    int headless = (argc > 1 && strcmp(argv[1], "headless") == 0);
+    const char *bench_seconds = (argc > 2) ? argv[2] : BENCH_DEFAULT_SECONDS;
+    const char *bench_keys    = (argc > 3) ? argv[3] : BENCH_DEFAULT_KEYS;
+    const char *bench_hz      = (argc > 4) ? argv[4] : BENCH_DEFAULT_HZ;
 
     ensureLogsDir();
     logMessage(LOG_PATH, "[MAIN] PROGRAM STARTED");
 
+    // --- RUNTIME SETTINGS (exported to every child as ARP_*) ---
+    if (config_load(NULL) < 0) {
+        fprintf(stderr, "[MAIN] Cannot read the file named by %s\n", CONFIG_ENV);
+        return 1;
+    }
+    char settings[1024];
+    config_describe(settings, sizeof(settings));
+    logMessage(LOG_PATH, "[MAIN] Settings: %s", settings);
+
     // --- MODE AND ROLE ---
     memset(server_address, 0, sizeof(server_address));
     port_number = 0;
     int mode = MODE_STANDALONE;
     int role = 0;
 
-    printf("\n");
-    printf("=== DRONE CONTROL ===\n");
-    printf("\n");
-    printf(" Select mode:\n 1: standalone\n 2: networked\n> ");
-    if (scanf("%d", &mode) != 1) mode = MODE_STANDALONE;
-
-    if (mode == MODE_NETWORKED) {
-        printf(" Select role:\n 1: server\n 2: client\n> ");
-        if (scanf("%d", &role) != 1) role = MODE_SERVER;
-        if (role != MODE_SERVER && role != MODE_CLIENT) role = MODE_SERVER;
-
-        if (role == MODE_CLIENT) {
-            printf(" Insert IP address: ");
-            scanf("%63s", server_address);
+    if (headless) {
+        logMessage(LOG_PATH, "[MAIN] Headless benchmark: %s s, keys \"%s\" at %s/s",
+                   bench_seconds, bench_keys, bench_hz);
+    } else {
+        printf("\n");
+        printf("=== DRONE CONTROL ===\n");
+        printf("\n");
+        printf(" Select mode:\n 1: standalone\n 2: networked\n> ");
+        if (scanf("%d", &mode) != 1) mode = MODE_STANDALONE;
+
+        if (mode == MODE_NETWORKED) {
+            printf(" Select role:\n 1: server\n 2: client\n> ");
+            if (scanf("%d", &role) != 1) role = MODE_SERVER;
+            if (role != MODE_SERVER && role != MODE_CLIENT) role = MODE_SERVER;
+
+            if (role == MODE_CLIENT) {
+                printf(" Insert IP address: ");
+                scanf("%63s", server_address);
+            }
+
+            printf(" Insert port number [%d]: ", NET_PORT);
+            if (scanf("%d", &port_number) != 1) port_number = NET_PORT;
         }
-
-        printf(" Insert port number: ");
-        scanf("%d", &port_number);
     }
 
     logMessage(LOG_PATH, "[MAIN] Starting in MODE: %d", mode);
@@ -95,11 +178,43 @@ int main(void) {
 
     logMessage(LOG_PATH, "[MAIN] Pipes created successfully");
 
-    /* --- RESET PID FILE --- */
-    FILE *fp = fopen(PID_FILE_PATH, "w");
-    if (fp) fclose(fp);
+#if USE_SHM_TRANSPORT
+    /* --- SHARED MEMORY WORLD (Blackboard <-> Drone) --- */
+    if (shm_world_create() < 0) {
+        perror("shm_world_create");
+        exit(1);
+    }
+#endif
+
+#if USE_HEARTBEAT
+    /* --- HEARTBEAT SLOTS (processes -> Watchdog) --- */
+    if (heartbeat_create() < 0) {
+        perror("heartbeat_create");
+        exit(1);
+    }
+#endif
+
+#if USE_METRICS
+    /* --- METRICS SLOTS (processes -> exec/stats) --- */
+    if (metrics_create() < 0) {
+        perror("metrics_create");
+        exit(1);
+    }
+#endif
+
+    /* --- PID REGISTRY (every slot empty until its process publishes) --- */
+    uint32_t expected = ROLE_BIT(ROLE_INPUT) | ROLE_BIT(ROLE_BLACKBOARD) | ROLE_BIT(ROLE_DRONE);
+    if (mode == MODE_STANDALONE) expected |= ROLE_BIT(ROLE_OBSTACLE) | ROLE_BIT(ROLE_TARGET) | ROLE_BIT(ROLE_WATCHDOG);
+    else expected |= ROLE_BIT(ROLE_NETWORK);
+    int64_t spawn_ns[ROLE_COUNT] = {0};
+
+    if (registry_create(expected) < 0) {
+        perror("registry_create");
+        exit(1);
+    }
 
     /* --- FORK INPUT PROCESS --- */
+    spawn_ns[ROLE_INPUT] = latency_now_ns();
     pid_t pid_input = fork();
     if (pid_input == 0) {
         // Close unused ends
@@ -115,12 +230,18 @@ int main(void) {
         close(pipe_network_bb[0]); close(pipe_network_bb[1]);
 
         char fd_out[16]; snprintf(fd_out, sizeof(fd_out), "%d", pipe_input_bb[1]);
-        execlp("konsole", "konsole", "-e", "./exec/input", fd_out, arg_mode, NULL);
+        if (headless) {
+            execlp("./exec/input", "./exec/input", fd_out, arg_mode,
+                   bench_keys, bench_hz, bench_seconds, NULL);
+        } else {
+            execlp("konsole", "konsole", "-e", "./exec/input", fd_out, arg_mode, NULL);
+        }
         perror("exec input");
         exit(1);
     }
 
     /* --- FORK BLACKBOARD PROCESS --- */
+    spawn_ns[ROLE_BLACKBOARD] = latency_now_ns();
     pid_t pid_bb = fork();
     if (pid_bb == 0) {
         // Close unused ends
@@ -128,7 +249,7 @@ int main(void) {
         close(pipe_bb_drone[0]); close(pipe_drone_bb[1]);
         close(pipe_bb_obst[0]); close(pipe_obst_bb[1]);
         close(pipe_bb_target[0]); close(pipe_target_bb[1]);
-        close(pipe_bb_wd[0]); close(pipe_bb_wd[1]);
+        close(pipe_bb_wd[0]);
         close(pipe_bb_network[0]); close(pipe_network_bb[1]);
 
         char fd_in_input[16], fd_in_drone[16], fd_out_drone[16];
@@ -150,21 +271,34 @@ int main(void) {
 
         if (strlen(server_address) == 0) strcpy(server_address, "0.0.0.0");
 
-        execlp("konsole", "konsole", "-e",
-            "./exec/blackboard",
-            fd_in_input, fd_in_drone,
-            fd_out_drone, fd_out_obst,
-            fd_in_obst, fd_out_target,
-            fd_in_target, fd_out_wd,
-            arg_mode, server_address,
-            fd_out_network, fd_in_network,
-            arg_role, NULL);
+        if (headless) {
+            execlp("./exec/blackboard",
+                "./exec/blackboard",
+                fd_in_input, fd_in_drone,
+                fd_out_drone, fd_out_obst,
+                fd_in_obst, fd_out_target,
+                fd_in_target, fd_out_wd,
+                arg_mode, server_address,
+                fd_out_network, fd_in_network,
+                arg_role, "headless", NULL);
+        } else {
+            execlp("konsole", "konsole", "-e",
+                "./exec/blackboard",
+                fd_in_input, fd_in_drone,
+                fd_out_drone, fd_out_obst,
+                fd_in_obst, fd_out_target,
+                fd_in_target, fd_out_wd,
+                arg_mode, server_address,
+                fd_out_network, fd_in_network,
+                arg_role, NULL);
+        }
 
         perror("exec blackboard");
         exit(1);
     }
 
     /* --- FORK DRONE PROCESS --- */
+    spawn_ns[ROLE_DRONE] = latency_now_ns();
     pid_t pid_drone = fork();
     if (pid_drone == 0) {
         // Close unused
@@ -192,6 +326,7 @@ int main(void) {
     if(mode == MODE_STANDALONE){
         /* --- FORK OBSTACLE PROCESS --- */
 
+        spawn_ns[ROLE_OBSTACLE] = latency_now_ns();
         pid_obst = fork();
         if(pid_obst < 0) {
             perror("fork obstacle");
@@ -219,6 +354,7 @@ int main(void) {
         }
 
         /* --- FORK TARGET PROCESS --- */
+        spawn_ns[ROLE_TARGET] = latency_now_ns();
         pid_target = fork();
         if(pid_target < 0) {
             perror("fork target");
@@ -246,6 +382,7 @@ int main(void) {
         }
 
         /* --- FORK WATCHDOG --- */
+        spawn_ns[ROLE_WATCHDOG] = latency_now_ns();
         pid_watchdog = fork();
         if(pid_watchdog < 0) {
             perror("fork watchdog");
@@ -265,13 +402,21 @@ int main(void) {
             close(pipe_network_bb[0]); close(pipe_network_bb[1]);
 
             char fd_in_bb[16]; snprintf(fd_in_bb, sizeof(fd_in_bb), "%d", pipe_bb_wd[0]);
-            execlp("konsole", "konsole", "-e", "./exec/watchdog", fd_in_bb, NULL);
+            if (headless) {
+                // Its status lines would land on the benchmark's terminal
+                int devnull = open("/dev/null", O_WRONLY);
+                if (devnull >= 0) dup2(devnull, STDOUT_FILENO);
+                execlp("./exec/watchdog", "./exec/watchdog", fd_in_bb, NULL);
+            } else {
+                execlp("konsole", "konsole", "-e", "./exec/watchdog", fd_in_bb, NULL);
+            }
             perror("exec watchdog");
             exit(1);
         }
 
     } else if(mode == MODE_NETWORKED){
         /* --- FORK NETWORK PROCESS --- */
+        spawn_ns[ROLE_NETWORK] = latency_now_ns();
         pid_network = fork();
         if(pid_network == 0){
             close(pipe_network_bb[0]); close(pipe_bb_network[1]);
@@ -315,8 +460,29 @@ int main(void) {
     logMessage(LOG_PATH, "[MAIN] All processes started (input=%d drone=%d bb=%d obst=%d targ=%d watchdog=%d network=%d)",
         pid_input, pid_drone, pid_bb, pid_obst, pid_target, pid_watchdog, pid_network);
 
+    /* --- RELEASE ALL PROCESSES TOGETHER --- */
+    startup_barrier(spawn_ns, expected);
+
     /* --- WAIT FOR CHILDREN --- */
-    while (wait(NULL) > 0);
+    if (headless) {
+        Child children[] = {
+            { pid_input, "input" }, { pid_bb, "blackboard" }, { pid_drone, "drone" },
+            { pid_obst, "obstacle" }, { pid_target, "target" }, { pid_watchdog, "watchdog" },
+        };
+        wait_and_report(children, sizeof(children) / sizeof(children[0]));
+    } else {
+        while (wait(NULL) > 0);
+    }
+#if USE_SHM_TRANSPORT
+    shm_world_unlink();
+#endif
+#if USE_HEARTBEAT
+    heartbeat_unlink();
+#endif
+#if USE_METRICS
+    metrics_unlink();
+#endif
+    registry_unlink();
     logMessage(LOG_PATH, "[MAIN] PROGRAM EXIT");
 
     return 0;
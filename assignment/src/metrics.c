@@ -0,0 +1,227 @@
+#include "metrics.h"
+#include "app_common.h"
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static MetTable *table = NULL;           // This process's mapping (metrics_join)
+static MetSlot *own = NULL;
+static uint64_t state_since_ns, loop_start_ns, loop_idle_ns, next_sample_ns;
+
+static const char *const state_names[MET_STATES] = {
+    "idle", "input", "physics", "update", "render", "broadcast"
+};
+
+static uint64_t monotonic_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+// Single writer: a load and a store, no locked read-modify-write
+static inline void add(_Atomic uint64_t *c, uint64_t by) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+/* ======================================================================================
+ * SECTION 1: SEGMENT LIFETIME
+ * ====================================================================================== */
+int metrics_create(void) {
+    if (!USE_METRICS) return 0;
+    int fd = shm_open(MET_SEGMENT_NAME, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        logMessage(LOG_PATH, "[MET] ERROR shm_open: %s", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(MetTable)) < 0) {
+        logMessage(LOG_PATH, "[MET] ERROR ftruncate: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    MetTable *t = mmap(NULL, sizeof(MetTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED) {
+        logMessage(LOG_PATH, "[MET] ERROR mmap: %s", strerror(errno));
+        return -1;
+    }
+
+    // ftruncate zero-fills the segment: every slot starts free
+    t->magic = MET_MAGIC;
+    munmap(t, sizeof(MetTable));
+    return 0;
+}
+
+void metrics_unlink(void) {
+    if (USE_METRICS) shm_unlink(MET_SEGMENT_NAME);
+}
+
+static MetTable *map_table(int prot) {
+    int fd = shm_open(MET_SEGMENT_NAME, (prot & PROT_WRITE) ? O_RDWR : O_RDONLY, 0600);
+    if (fd < 0) return NULL;
+    MetTable *t = mmap(NULL, sizeof(MetTable), prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED) return NULL;
+    if (t->magic != MET_MAGIC) {
+        munmap(t, sizeof(MetTable));
+        return NULL;
+    }
+    return t;
+}
+
+const MetTable *metrics_attach(void) {
+    return map_table(PROT_READ);
+}
+
+void metrics_detach(const MetTable *t) {
+    if (t) munmap((void *)t, sizeof(MetTable));
+}
+
+const char *metrics_state_name(int state) {
+    return (state >= 0 && state < MET_STATES) ? state_names[state] : "?";
+}
+
+/* ======================================================================================
+ * SECTION 2: PROCESS SIDE
+ * ====================================================================================== */
+void metrics_join(const char *name) {
+    if (!USE_METRICS || table) return;
+    table = map_table(PROT_READ | PROT_WRITE);
+    if (!table) {
+        logMessage(LOG_PATH, "[MET] No metrics segment, %s is not measured", name);
+        return;
+    }
+    uint32_t i = atomic_fetch_add(&table->used, 1);
+    if (i >= MET_MAX_SLOTS) {
+        logMessage(LOG_PATH, "[MET] ERROR no free metrics slot for %s", name);
+        munmap(table, sizeof(MetTable));
+        table = NULL;
+        return;
+    }
+    own = &table->slot[i];
+    strncpy(own->name, name, sizeof(own->name) - 1);
+    state_since_ns = loop_start_ns = next_sample_ns = monotonic_ns();
+    atomic_store_explicit(&own->updated_ns, state_since_ns, memory_order_relaxed);
+    atomic_store_explicit(&own->pid, (int32_t)getpid(), memory_order_release);
+}
+
+void metrics_leave(void) {
+    if (!own) return;
+    atomic_store_explicit(&own->pid, 0, memory_order_release);
+    munmap(table, sizeof(MetTable));
+    table = NULL;
+    own = NULL;
+}
+
+void metrics_pipe(int fd, const char *name) {
+    if (!own || fd < 0) return;
+    uint32_t n = atomic_load_explicit(&own->pipes, memory_order_relaxed);
+    if (n >= MET_MAX_PIPES) return;
+    MetPipe *p = &own->pipe[n];
+    strncpy(p->name, name, sizeof(p->name) - 1);
+    p->fd = fd;
+    atomic_store_explicit(&own->pipes, n + 1, memory_order_release);
+}
+
+int metrics_counter(const char *name) {
+    if (!own) return -1;
+    uint32_t n = atomic_load_explicit(&own->counters, memory_order_relaxed);
+    if (n >= MET_MAX_COUNTERS) return -1;
+    strncpy(own->counter[n].name, name, sizeof(own->counter[n].name) - 1);
+    atomic_store_explicit(&own->counters, n + 1, memory_order_release);
+    return (int)n;
+}
+
+void metrics_set(int id, uint64_t value) {
+    if (own && id >= 0) atomic_store_explicit(&own->counter[id].value, value, memory_order_relaxed);
+}
+
+static MetPipe *find_pipe(int fd) {
+    uint32_t n = atomic_load_explicit(&own->pipes, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+        if (own->pipe[i].fd == fd) return &own->pipe[i];
+    }
+    return NULL;
+}
+
+static void sample_pending(void) {
+    uint32_t n = atomic_load_explicit(&own->pipes, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+        MetPipe *p = &own->pipe[i];
+        int queued = 0;
+        if (ioctl(p->fd, FIONREAD, &queued) < 0) continue;
+        atomic_store_explicit(&p->pending, (uint32_t)queued, memory_order_relaxed);
+        if ((uint32_t)queued > atomic_load_explicit(&p->pending_max, memory_order_relaxed)) {
+            atomic_store_explicit(&p->pending_max, (uint32_t)queued, memory_order_relaxed);
+        }
+    }
+}
+
+void metrics_loop(void) {
+    if (!own) return;
+    uint64_t now = monotonic_ns();
+    uint64_t idle = loop_idle_ns;
+    if (atomic_load_explicit(&own->state, memory_order_relaxed) == MET_IDLE) idle += now - state_since_ns;
+    uint64_t busy = (now - loop_start_ns > idle) ? now - loop_start_ns - idle : 0;
+    if (busy > atomic_load_explicit(&own->loop_max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&own->loop_max_ns, busy, memory_order_relaxed);
+    }
+    // The idle time already counted stays out of the next iteration
+    loop_start_ns = now;
+    loop_idle_ns = 0;
+    if (atomic_load_explicit(&own->state, memory_order_relaxed) == MET_IDLE) {
+        add(&own->state_ns[MET_IDLE], now - state_since_ns);
+        state_since_ns = now;
+    }
+    add(&own->loops, 1);
+    atomic_store_explicit(&own->updated_ns, now, memory_order_relaxed);
+
+    if (now >= next_sample_ns) {
+        sample_pending();
+        next_sample_ns = now + MET_SAMPLE_MS * 1000000ull;
+    }
+}
+
+void metrics_state(MetState state) {
+    if (!own) return;
+    uint32_t prev = atomic_load_explicit(&own->state, memory_order_relaxed);
+    if (prev == (uint32_t)state) return;
+    uint64_t now = monotonic_ns();
+    add(&own->state_ns[prev], now - state_since_ns);
+    if (prev == MET_IDLE) loop_idle_ns += now - state_since_ns;
+    state_since_ns = now;
+    atomic_store_explicit(&own->state, state, memory_order_relaxed);
+}
+
+void metrics_msg_in(int type) {
+    if (own && type >= 0 && type < MET_MSG_TYPES) add(&own->msgs_in[type], 1);
+}
+
+void metrics_msg_out(int type) {
+    if (own && type >= 0 && type < MET_MSG_TYPES) add(&own->msgs_out[type], 1);
+}
+
+ssize_t metrics_read(int fd, void *buf, size_t len) {
+    ssize_t n = read(fd, buf, len);
+    if (own && n > 0) {
+        MetPipe *p = find_pipe(fd);
+        if (p) add(&p->bytes_in, (uint64_t)n);
+    }
+    return n;
+}
+
+ssize_t metrics_write(int fd, const void *buf, size_t len) {
+    ssize_t n = write(fd, buf, len);
+    if (own && n > 0) {
+        MetPipe *p = find_pipe(fd);
+        if (p) add(&p->bytes_out, (uint64_t)n);
+    }
+    return n;
+}
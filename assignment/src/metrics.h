@@ -0,0 +1,103 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+/* Build option: make METRICS=0 leaves every counter below untouched (the calls
+ * stay, as no-ops). With METRICS=1 each process publishes its counters in shared
+ * memory and exec/stats reads them while the session runs. */
+#ifndef USE_METRICS
+#define USE_METRICS 1
+#endif
+#ifndef MET_SAMPLE_MS
+#define MET_SAMPLE_MS 100                // FIONREAD sampling period of the pipes
+#endif
+
+#define MET_SEGMENT_NAME "/arp_metrics"
+#define MET_MAGIC        0x54454d41u     // "AMET"
+#define MET_MAX_SLOTS    16
+#define MET_MAX_PIPES    12
+#define MET_MSG_TYPES    16              // MSG_TYPE_* values counted (app_common.h)
+#define MET_MAX_COUNTERS 8
+
+// What the main loop is doing; each process maps its own state enum onto these
+typedef enum {
+    MET_IDLE,                            // Waiting in select()/epoll/sleep
+    MET_INPUT,                           // Reading and handling messages
+    MET_PHYSICS,
+    MET_UPDATE,                          // Entity arrays, occupancy, generation
+    MET_RENDER,
+    MET_BROADCAST,                       // Writing to the pipes
+    MET_STATES
+} MetState;
+
+// A count of the process's own (frames drawn, positions coalesced, ...)
+typedef struct {
+    char name[12];
+    _Atomic uint64_t value;
+} MetCounter;
+
+typedef struct {
+    char name[12];
+    int32_t fd;
+    _Atomic uint64_t bytes_in, bytes_out;
+    _Atomic uint32_t pending, pending_max; // FIONREAD: bytes queued in the kernel
+} MetPipe;
+
+/* * One slot per process, on its own cache line; only its owner writes it, so
+ * the counters are plain loads and stores. Like a heartbeat slot, pid is
+ * published last and goes back to 0 when the process leaves cleanly.
+ */
+typedef struct {
+    _Alignas(64) _Atomic int32_t pid;
+    char name[16];
+    _Atomic uint32_t pipes;              // Entries of pipe[] in use
+    _Atomic uint64_t loops;              // Main-loop iterations
+    _Atomic uint64_t loop_max_ns;        // Longest iteration, time spent idle excluded
+    _Atomic uint64_t state_ns[MET_STATES];
+    _Atomic uint32_t state;
+    _Atomic uint64_t msgs_in[MET_MSG_TYPES], msgs_out[MET_MSG_TYPES];
+    MetPipe pipe[MET_MAX_PIPES];
+    _Atomic uint32_t counters;           // Entries of counter[] in use
+    MetCounter counter[MET_MAX_COUNTERS];
+    _Atomic uint64_t updated_ns;         // CLOCK_MONOTONIC of the last metrics_loop()
+} MetSlot;
+
+typedef struct {
+    uint32_t magic;
+    _Atomic uint32_t used;
+    MetSlot slot[MET_MAX_SLOTS];
+} MetTable;
+
+// Creates (or truncates) the segment. Called once by main before forking.
+int metrics_create(void);
+void metrics_unlink(void);
+// Maps the segment read-only (the stats tool's view). Returns NULL on failure.
+const MetTable *metrics_attach(void);
+void metrics_detach(const MetTable *t);
+const char *metrics_state_name(int state);
+
+/* * Process side. metrics_join() claims a slot; everything else is a no-op before
+ * it, in METRICS=0 builds and when the segment is missing (a process started
+ * on its own), so call sites need no checks. Main thread only.
+ */
+void metrics_join(const char *name);
+void metrics_leave(void);
+// Names a pipe end; reads and writes on unregistered fds still count messages
+void metrics_pipe(int fd, const char *name);
+// Top of every main-loop iteration: closes the previous one, samples FIONREAD
+void metrics_loop(void);
+// Names a counter of the process's own: returns its id for metrics_set(), or -1
+int  metrics_counter(const char *name);
+void metrics_set(int id, uint64_t value);
+void metrics_state(MetState state);
+void metrics_msg_in(int type);
+void metrics_msg_out(int type);
+// read()/write() that add what they moved to the fd's byte counters
+ssize_t metrics_read(int fd, void *buf, size_t len);
+ssize_t metrics_write(int fd, const void *buf, size_t len);
+
+#endif
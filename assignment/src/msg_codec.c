@@ -0,0 +1,302 @@
+#include "msg_codec.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+
+_Static_assert(sizeof(MsgForce) <= MSG_DATA_LEN, "MsgForce does not fit Message.data");
+_Static_assert(sizeof(MsgPositionEcho) <= MSG_DATA_LEN, "MsgPositionEcho does not fit Message.data");
+_Static_assert(sizeof(MsgEntityDelta) <= MSG_DATA_LEN, "MsgEntityDelta does not fit Message.data");
+
+static uint32_t next_seq = 0;
+
+/* ======================================================================================
+ * SECTION 1: HEADER HELPERS
+ * ====================================================================================== */
+static void put_binary(Message *m, int type, const void *payload, size_t len) {
+    m->type = type;
+    m->version = MSG_VERSION;
+    m->len = (uint16_t)len;
+    m->seq = next_seq++;
+    memset(m->data, 0, sizeof(m->data));
+    if (len) memcpy(m->data, payload, len);
+}
+
+#if MSG_TEXT_COMPAT
+static void put_text(Message *m, int type, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static void put_text(Message *m, int type, const char *fmt, ...) {
+    va_list args;
+    m->type = type;
+    m->version = MSG_VERSION_TEXT;
+    m->seq = next_seq++;
+    va_start(args, fmt);
+    vsnprintf(m->data, sizeof(m->data), fmt, args);
+    va_end(args);
+    m->len = (uint16_t)strlen(m->data);
+}
+#endif
+
+// Copies a binary payload out after checking version and length
+static int get_binary(const Message *m, void *out, size_t len) {
+    if (m->version != MSG_VERSION || m->len != len) return -1;
+    memcpy(out, m->data, len);
+    return 0;
+}
+
+// Text payloads are not guaranteed to be NUL-terminated within data[]
+static const char *text_of(const Message *m, char *buf) {
+    memcpy(buf, m->data, MSG_DATA_LEN);
+    buf[MSG_DATA_LEN] = '\0';
+    return buf;
+}
+
+/* ======================================================================================
+ * SECTION 2: PAYLOADS
+ * ====================================================================================== */
+void msg_encode_position(Message *m, int type, float x, float y) {
+#if MSG_TEXT_COMPAT
+    put_text(m, type, "%f %f", x, y);
+#else
+    MsgPosition p = { x, y };
+    put_binary(m, type, &p, sizeof(p));
+#endif
+}
+
+int msg_decode_position(const Message *m, float *x, float *y) {
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        return (sscanf(text_of(m, buf), "%f %f", x, y) == 2) ? 0 : -1;
+    }
+    // A position may echo a key press stamp after x, y (LATENCY=1 builds)
+    MsgPosition p;
+    if (m->version != MSG_VERSION ||
+        (m->len != sizeof(MsgPosition) && m->len != sizeof(MsgPositionEcho))) return -1;
+    memcpy(&p, m->data, sizeof(p));
+    *x = p.x; *y = p.y;
+    return 0;
+}
+
+void msg_encode_drone(Message *m, int peer, float x, float y, const float *vel) {
+#if MSG_TEXT_COMPAT
+    if (vel) put_text(m, MSG_TYPE_DRONE, "%f %f %d %f %f", x, y, peer, vel[0], vel[1]);
+    else put_text(m, MSG_TYPE_DRONE, "%f %f %d", x, y, peer);
+#else
+    MsgDrone p = { x, y, peer, vel ? vel[0] : 0.0f, vel ? vel[1] : 0.0f };
+    put_binary(m, MSG_TYPE_DRONE, &p, vel ? sizeof(p) : offsetof(MsgDrone, vx));
+#endif
+}
+
+int msg_decode_drone(const Message *m, int *peer, float *x, float *y, float *vel, int *has_vel) {
+    *has_vel = 0;
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        int n = sscanf(text_of(m, buf), "%f %f %d %f %f", x, y, peer, &vel[0], &vel[1]);
+        if (n < 3) *peer = 0;
+        *has_vel = (n == 5);
+        return (n >= 2) ? 0 : -1;
+    }
+    if (m->version == MSG_VERSION &&
+        (m->len == sizeof(MsgDrone) || m->len == offsetof(MsgDrone, vx))) {
+        MsgDrone p;
+        memcpy(&p, m->data, m->len);
+        *x = p.x; *y = p.y; *peer = p.peer;
+        if (m->len == sizeof(MsgDrone)) {
+            vel[0] = p.vx; vel[1] = p.vy;
+            *has_vel = 1;
+        }
+        return 0;
+    }
+    *peer = 0;
+    return msg_decode_position(m, x, y);
+}
+
+void msg_encode_peer_left(Message *m, int peer) {
+#if MSG_TEXT_COMPAT
+    put_text(m, MSG_TYPE_PEER_LEFT, "%d", peer);
+#else
+    MsgPeer p = { peer };
+    put_binary(m, MSG_TYPE_PEER_LEFT, &p, sizeof(p));
+#endif
+}
+
+int msg_decode_peer_left(const Message *m, int *peer) {
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        return (sscanf(text_of(m, buf), "%d", peer) == 1) ? 0 : -1;
+    }
+    MsgPeer p;
+    if (get_binary(m, &p, sizeof(p)) < 0) return -1;
+    *peer = p.peer;
+    return 0;
+}
+
+void msg_encode_forces(Message *m, const MsgForce *f) {
+#if MSG_TEXT_COMPAT
+    put_text(m, MSG_TYPE_FORCE, "%g %g %g %g %g %g %g %g",
+             f->drn_Fx, f->drn_Fy, f->obst_Fx, f->obst_Fy,
+             f->wall_Fx, f->wall_Fy, f->targ_Fx, f->targ_Fy);
+#else
+    put_binary(m, MSG_TYPE_FORCE, f, sizeof(*f));
+#endif
+}
+
+int msg_decode_forces(const Message *m, MsgForce *f) {
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        return (sscanf(text_of(m, buf), "%f %f %f %f %f %f %f %f",
+                       &f->drn_Fx, &f->drn_Fy, &f->obst_Fx, &f->obst_Fy,
+                       &f->wall_Fx, &f->wall_Fy, &f->targ_Fx, &f->targ_Fy) == 8) ? 0 : -1;
+    }
+    return get_binary(m, f, sizeof(*f));
+}
+
+void msg_encode_size(Message *m, int width, int height) {
+#if MSG_TEXT_COMPAT
+    put_text(m, MSG_TYPE_SIZE, "%d %d", width, height);
+#else
+    MsgSize p = { width, height };
+    put_binary(m, MSG_TYPE_SIZE, &p, sizeof(p));
+#endif
+}
+
+int msg_decode_size(const Message *m, int *width, int *height) {
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        return (sscanf(text_of(m, buf), "%d %d", width, height) == 2) ? 0 : -1;
+    }
+    MsgSize p;
+    if (get_binary(m, &p, sizeof(p)) < 0) return -1;
+    *width = p.width; *height = p.height;
+    return 0;
+}
+
+void msg_encode_entities(Message *m, int type, int count, uint32_t version) {
+#if MSG_TEXT_COMPAT
+    put_text(m, type, "%d %u", count, version);
+#else
+    MsgEntities p = { count, version };
+    put_binary(m, type, &p, sizeof(p));
+#endif
+}
+
+int msg_decode_entities(const Message *m, int *count, uint32_t *version) {
+    uint32_t v = 0;
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        if (sscanf(text_of(m, buf), "%d %u", count, &v) < 1 || *count < 0) return -1;
+    } else {
+        // Traces recorded before the version was added carry the count alone
+        MsgEntities p = { 0, 0 };
+        if (m->version != MSG_VERSION ||
+            (m->len != sizeof(p) && m->len != offsetof(MsgEntities, version))) return -1;
+        memcpy(&p, m->data, m->len);
+        if (p.count < 0) return -1;
+        *count = p.count;
+        v = p.version;
+    }
+    if (version) *version = v;
+    return 0;
+}
+
+void msg_encode_entity_delta(Message *m, const MsgEntityDelta *d) {
+#if MSG_TEXT_COMPAT
+    put_text(m, MSG_TYPE_ENTITY_DELTA, "%d %d %d %d %d %u",
+             d->kind, d->op, d->index, d->x, d->y, d->version);
+#else
+    put_binary(m, MSG_TYPE_ENTITY_DELTA, d, sizeof(*d));
+#endif
+}
+
+int msg_decode_entity_delta(const Message *m, MsgEntityDelta *d) {
+    if (m->version == MSG_VERSION_TEXT) {
+        char buf[MSG_DATA_LEN + 1];
+        return (sscanf(text_of(m, buf), "%d %d %d %d %d %u", &d->kind, &d->op, &d->index,
+                       &d->x, &d->y, &d->version) == 6) ? 0 : -1;
+    }
+    return get_binary(m, d, sizeof(*d));
+}
+
+void msg_encode_input(Message *m, char key) {
+#if MSG_TEXT_COMPAT
+    put_text(m, MSG_TYPE_INPUT, "%c", key);
+#else
+    MsgInput p = { key };
+    put_binary(m, MSG_TYPE_INPUT, &p, sizeof(p));
+#endif
+}
+
+int msg_decode_input(const Message *m, char *key) {
+    if (m->version == MSG_VERSION_TEXT) {
+        *key = m->data[0];
+        return 0;
+    }
+    MsgInput p;
+    if (m->version != MSG_VERSION ||
+        (m->len != sizeof(MsgInput) && m->len != sizeof(MsgInputStamped))) return -1;
+    memcpy(&p, m->data, sizeof(p));
+    *key = p.key;
+    return 0;
+}
+
+int msg_decode_input_record(const void *buf, size_t n, char *key, MsgLatency *lat) {
+    lat->id = 0;
+    if (n == sizeof(Message)) {
+        const Message *m = buf;
+        if (m->type != MSG_TYPE_INPUT || msg_decode_input(m, key) < 0) return -1;
+        if (msg_decode_latency(m, lat) < 0) lat->id = 0;
+        return 0;
+    }
+    if (n == 0) return -1;
+    *key = *(const char *)buf;
+    return 0;
+}
+
+// Only produced by exec/replay, so there is no text variant
+void msg_encode_tick(Message *m, int steps) {
+    MsgTick p = { steps };
+    put_binary(m, MSG_TYPE_TICK, &p, sizeof(p));
+}
+
+int msg_decode_tick(const Message *m, int *steps) {
+    MsgTick p;
+    if (get_binary(m, &p, sizeof(p)) < 0 || p.steps < 0) return -1;
+    *steps = p.steps;
+    return 0;
+}
+
+void msg_encode_exit(Message *m) {
+    put_binary(m, MSG_TYPE_EXIT, NULL, 0);
+}
+
+/* ======================================================================================
+ * SECTION 3: LATENCY STAMPS
+ * ====================================================================================== */
+// Binary only, like the TICK: LATENCY=1 is a measurement build
+void msg_encode_input_stamped(Message *m, char key, const MsgLatency *lat) {
+    MsgInputStamped p;
+    p.key = key;
+    p.lat = *lat;
+    put_binary(m, MSG_TYPE_INPUT, &p, sizeof(p));
+}
+
+void msg_encode_position_echo(Message *m, float x, float y, const MsgLatency *lat) {
+    MsgPositionEcho p;
+    p.x = x;
+    p.y = y;
+    p.lat = *lat;
+    put_binary(m, MSG_TYPE_POSITION, &p, sizeof(p));
+}
+
+int msg_decode_latency(const Message *m, MsgLatency *lat) {
+    if (m->version != MSG_VERSION) return -1;
+    if (m->type == MSG_TYPE_INPUT && m->len == sizeof(MsgInputStamped)) {
+        memcpy(lat, m->data + offsetof(MsgInputStamped, lat), sizeof(*lat));
+    } else if (m->type == MSG_TYPE_POSITION && m->len == sizeof(MsgPositionEcho)) {
+        memcpy(lat, m->data + offsetof(MsgPositionEcho, lat), sizeof(*lat));
+    } else {
+        return -1;
+    }
+    return (lat->id != 0) ? 0 : -1;
+}
@@ -0,0 +1,62 @@
+// msg_codec.h
+#ifndef MSG_CODEC_H
+#define MSG_CODEC_H
+
+#include <stddef.h>
+
+#include "app_common.h"
+
+/* Build option: make MSG_TEXT=1 makes the encoders emit the legacy ASCII
+ * payloads (readable in a hex dump). Decoders accept both formats. */
+#ifndef MSG_TEXT_COMPAT
+#define MSG_TEXT_COMPAT 0
+#endif
+
+/* * Encoders fill type, version, len and seq. Decoders return 0 on success
+ * and -1 if the version is unknown or the payload length does not match.
+ */
+void msg_encode_position(Message *m, int type, float x, float y);
+int  msg_decode_position(const Message *m, float *x, float *y);
+
+/* * Remote drone with its peer id and, when vel is given, its velocity (vel[2]).
+ * Decoding sets *has_vel; a plain MsgPosition decodes as peer 0 without velocity.
+ */
+void msg_encode_drone(Message *m, int peer, float x, float y, const float *vel);
+int  msg_decode_drone(const Message *m, int *peer, float *x, float *y, float *vel, int *has_vel);
+
+void msg_encode_peer_left(Message *m, int peer);
+int  msg_decode_peer_left(const Message *m, int *peer);
+
+void msg_encode_forces(Message *m, const MsgForce *f);
+int  msg_decode_forces(const Message *m, MsgForce *f);
+
+void msg_encode_size(Message *m, int width, int height);
+int  msg_decode_size(const Message *m, int *width, int *height);
+
+// Array snapshot header; version may be NULL when the caller does not track it
+void msg_encode_entities(Message *m, int type, int count, uint32_t version);
+int  msg_decode_entities(const Message *m, int *count, uint32_t *version);
+
+void msg_encode_entity_delta(Message *m, const MsgEntityDelta *d);
+int  msg_decode_entity_delta(const Message *m, MsgEntityDelta *d);
+
+void msg_encode_input(Message *m, char key);
+int  msg_decode_input(const Message *m, char *key);
+
+void msg_encode_tick(Message *m, int steps);
+int  msg_decode_tick(const Message *m, int *steps);
+
+void msg_encode_exit(Message *m);
+
+/* * The Input pipe carries raw key bytes, or one Message per key in LATENCY=1
+ * builds. Fills key (and lat, id 0 when not stamped); -1 if unreadable.
+ */
+int  msg_decode_input_record(const void *buf, size_t n, char *key, MsgLatency *lat);
+
+// --- key press latency stamps (LATENCY=1, see latency.h) ---
+void msg_encode_input_stamped(Message *m, char key, const MsgLatency *lat);
+void msg_encode_position_echo(Message *m, float x, float y, const MsgLatency *lat);
+// 0 if m is an INPUT or POSITION carrying a stamp
+int  msg_decode_latency(const Message *m, MsgLatency *lat);
+
+#endif
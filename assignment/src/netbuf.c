@@ -0,0 +1,226 @@
+#include "netbuf.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define IDX(b, n) ((n) & ((b)->cap - 1))
+
+/* ======================================================================================
+ * SECTION 1: STORAGE
+ * ====================================================================================== */
+int netbuf_init(NetBuf *b) {
+    memset(b, 0, sizeof(*b));
+    b->data = malloc(NETBUF_INITIAL);
+    if (!b->data) return -1;
+    b->cap = NETBUF_INITIAL;
+    return 0;
+}
+
+void netbuf_free(NetBuf *b) {
+    free(b->data);
+    free(b->spill);
+    memset(b, 0, sizeof(*b));
+}
+
+size_t netbuf_len(const NetBuf *b) {
+    return b->tail - b->head;
+}
+
+size_t netbuf_space(const NetBuf *b) {
+    size_t len = netbuf_len(b);
+    if (len < b->cap) return b->cap - len;
+    return (b->cap < NETBUF_MAX) ? b->cap : 0; // Full: the next fill doubles it
+}
+
+// Doubles the capacity, unwrapping the content to the front of the new block
+static int grow(NetBuf *b) {
+    size_t len = netbuf_len(b);
+    char *d = malloc(b->cap * 2);
+    if (!d) return -1;
+
+    size_t start = IDX(b, b->head);
+    size_t first = (len < b->cap - start) ? len : b->cap - start;
+    memcpy(d, b->data + start, first);
+    memcpy(d + first, b->data, len - first);
+
+    b->scan -= b->head;
+    b->nl -= b->head;
+    b->tail = len;
+    b->head = 0;
+    free(b->data);
+    b->data = d;
+    b->cap *= 2;
+    return 0;
+}
+
+/* ======================================================================================
+ * SECTION 2: READING
+ * ====================================================================================== */
+ssize_t netbuf_fill(NetBuf *b, int fd) {
+    if (netbuf_len(b) == b->cap) {
+        if (netbuf_has_line(b)) {
+            errno = ENOBUFS;       // Backpressure: consume the pending lines first
+            return -1;
+        }
+        if (b->cap >= NETBUF_MAX) {
+            // A line longer than NETBUF_MAX: drop it rather than wedge the connection
+            b->head = b->scan = b->tail;
+            errno = EMSGSIZE;
+            return -1;
+        }
+        if (grow(b) < 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    // The free space is [tail, head + cap): at most two segments of the ring
+    size_t free_len = b->cap - netbuf_len(b);
+    size_t start = IDX(b, b->tail);
+    struct iovec iov[2];
+    iov[0].iov_base = b->data + start;
+    iov[0].iov_len = (free_len < b->cap - start) ? free_len : b->cap - start;
+    iov[1].iov_base = b->data;
+    iov[1].iov_len = free_len - iov[0].iov_len;
+
+    ssize_t n = readv(fd, iov, iov[1].iov_len ? 2 : 1);
+    if (n > 0) b->tail += (size_t)n;
+    return n;
+}
+
+/* ======================================================================================
+ * SECTION 3: LINES
+ * ====================================================================================== */
+int netbuf_has_line(NetBuf *b) {
+    while (!b->has_nl && b->scan < b->tail) {
+        size_t start = IDX(b, b->scan);
+        size_t seg = b->tail - b->scan;
+        if (seg > b->cap - start) seg = b->cap - start;
+
+        const char *p = memchr(b->data + start, '\n', seg);
+        if (p) {
+            b->nl = b->scan + (size_t)(p - (b->data + start));
+            b->has_nl = 1;
+        } else {
+            b->scan += seg;
+        }
+    }
+    return b->has_nl;
+}
+
+const char *netbuf_peek(NetBuf *b, size_t *len) {
+    if (!netbuf_has_line(b)) return NULL;
+
+    size_t n = b->nl - b->head;
+    size_t start = IDX(b, b->head);
+    if (len) *len = n;
+
+    if (start + n < b->cap) {
+        b->data[start + n] = '\0'; // Over the '\n': the line is a C string in place
+        return b->data + start;
+    }
+
+    // Wraps around the end of the ring: the only case that copies
+    if (b->spill_cap < n + 1) {
+        char *s = realloc(b->spill, n + 1);
+        if (!s) return NULL;
+        b->spill = s;
+        b->spill_cap = n + 1;
+    }
+    size_t first = b->cap - start;
+    memcpy(b->spill, b->data + start, first);
+    memcpy(b->spill + first, b->data, n - first);
+    b->spill[n] = '\0';
+    return b->spill;
+}
+
+void netbuf_drop(NetBuf *b) {
+    if (!netbuf_has_line(b)) return;
+    b->head = b->nl + 1;
+    b->has_nl = 0;
+    if (b->scan < b->head) b->scan = b->head;
+}
+
+const char *netbuf_line(NetBuf *b, size_t *len) {
+    const char *line = netbuf_peek(b, len);
+    if (line) netbuf_drop(b);
+    return line;
+}
+
+int netbuf_wait_line(NetBuf *b, int fd) {
+    while (!netbuf_has_line(b)) {
+        ssize_t n = netbuf_fill(b, fd);
+        if (n == 0) return -1;
+        if (n < 0 && errno != EINTR && errno != EMSGSIZE) return -1;
+    }
+    return 0;
+}
+
+const char *netbuf_read_line(NetBuf *b, int fd, size_t *len) {
+    return (netbuf_wait_line(b, fd) == 0) ? netbuf_line(b, len) : NULL;
+}
+
+/* ======================================================================================
+ * SECTION 4: OUTBOUND QUEUE
+ * ====================================================================================== */
+int netout_init(NetOut *o) {
+    memset(o, 0, sizeof(*o));
+    o->data = malloc(NETBUF_INITIAL);
+    if (!o->data) return -1;
+    o->cap = NETBUF_INITIAL;
+    return 0;
+}
+
+void netout_free(NetOut *o) {
+    free(o->data);
+    memset(o, 0, sizeof(*o));
+}
+
+size_t netout_pending(const NetOut *o) {
+    return o->len - o->off;
+}
+
+// Makes room for need more bytes: reuses the sent prefix first, then doubles
+static int reserve(NetOut *o, size_t need) {
+    if (o->cap - o->len >= need) return 0;
+    size_t pending = netout_pending(o);
+    if (o->off) {
+        memmove(o->data, o->data + o->off, pending);
+        o->off = 0;
+        o->len = pending;
+        if (o->cap - o->len >= need) return 0;
+    }
+    size_t cap = o->cap;
+    while (cap - pending < need) cap *= 2;
+    if (cap > NETBUF_MAX) return -1;
+    char *d = realloc(o->data, cap);
+    if (!d) return -1;
+    o->data = d;
+    o->cap = cap;
+    return 0;
+}
+
+int netout_append(NetOut *o, const void *bytes, size_t n) {
+    if (reserve(o, n) < 0) return -1;
+    memcpy(o->data + o->len, bytes, n);
+    o->len += n;
+    return 0;
+}
+
+ssize_t netout_flush(NetOut *o, int fd) {
+    while (o->off < o->len) {
+        ssize_t n = send(fd, o->data + o->off, o->len - o->off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        o->off += (size_t)n;
+    }
+    if (o->off == o->len) o->off = o->len = 0;
+    return (ssize_t)netout_pending(o);
+}
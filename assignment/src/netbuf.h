@@ -0,0 +1,77 @@
+// netbuf.h
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define NETBUF_INITIAL 1024        // Starting capacity (power of two)
+#define NETBUF_MAX     (64 * 1024) // Never grows past this
+
+/* * Circular receive buffer for newline-terminated protocols.
+ * head/tail are free-running byte counts (index = count & (cap - 1)), so a
+ * consumed line only moves head: nothing is shifted. Bytes in [head, scan)
+ * are known to hold no '\n' and are never searched again.
+ */
+typedef struct {
+    char *data;
+    size_t cap;
+    size_t head, tail;             // Next byte to consume / next byte to fill
+    size_t scan;                   // Search resumes here
+    size_t nl;                     // Newline of the next line (valid when has_nl)
+    int has_nl;
+    char *spill;                   // Line that wraps around the end, made contiguous
+    size_t spill_cap;
+} NetBuf;
+
+int    netbuf_init(NetBuf *b);
+void   netbuf_free(NetBuf *b);
+size_t netbuf_len(const NetBuf *b);
+// Room left before the next read (0: full at NETBUF_MAX, stop reading the fd)
+size_t netbuf_space(const NetBuf *b);
+
+/* * One read()/readv() from fd into the free space, growing the buffer while it
+ * holds no complete line. Returns the bytes read, 0 on EOF, -1 with errno set
+ * (EAGAIN on a drained non-blocking fd, ENOBUFS when full of pending lines).
+ */
+ssize_t netbuf_fill(NetBuf *b, int fd);
+
+// 1 when a complete line is buffered (the search is shared with netbuf_peek)
+int    netbuf_has_line(NetBuf *b);
+
+/* * Next complete line without its '\n', NUL-terminated, or NULL.
+ * The view points into the buffer and stays valid until the next netbuf_fill,
+ * netbuf_peek or netbuf_line. netbuf_line also consumes it.
+ */
+const char *netbuf_peek(NetBuf *b, size_t *len);
+void        netbuf_drop(NetBuf *b);
+const char *netbuf_line(NetBuf *b, size_t *len);
+
+/* * Blocking: fills from fd until a line is complete. Returns 0, or -1 on EOF
+ * or error (including the fd's SO_RCVTIMEO expiring).
+ */
+int         netbuf_wait_line(NetBuf *b, int fd);
+// netbuf_wait_line + netbuf_line: the line, or NULL
+const char *netbuf_read_line(NetBuf *b, int fd, size_t *len);
+
+/* * Outbound queue of one connection: everything produced in one pass of the
+ * protocol is appended, then sent with a single send(). Bytes a non-blocking
+ * socket did not take stay queued for the next flush.
+ */
+typedef struct {
+    char *data;
+    size_t cap;
+    size_t off, len;               // Pending bytes are [off, len)
+} NetOut;
+
+int    netout_init(NetOut *o);
+void   netout_free(NetOut *o);
+size_t netout_pending(const NetOut *o);
+// -1 (nothing appended) when the queue would pass NETBUF_MAX
+int    netout_append(NetOut *o, const void *bytes, size_t n);
+/* * Sends the queue, retrying partial writes until it is empty or the socket would
+ * block. Returns the bytes still queued, -1 with errno set on a socket error.
+ */
+ssize_t netout_flush(NetOut *o, int fd);
+
+#endif
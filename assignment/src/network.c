@@ -16,15 +16,74 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/select.h> 
+#include <netinet/tcp.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <stdarg.h>
 
 #include "app_common.h"
 #include "log.h"
+#include "msg_codec.h"
+#include "netbuf.h"
+#include "process_pid.h"
+#include "metrics.h"
 
 #define BUFSZ 1024 
 
+/* Build option: make NET_STREAM=0 keeps only the lock-step drone/dok/obst/pok exchange.
+ * With 1 the server offers the streaming mode after the handshake and falls back to
+ * lock-step when the peer (e.g. the reference implementation) ignores the offer. */
+#ifndef NET_STREAM
+#define NET_STREAM 1
+#endif
+
+/* Build option: make NET_HZ=<n> sets the streamed frame rate (default RENDER_FPS).
+ * Frames carry a velocity the receivers extrapolate with, so it can be well below
+ * the render rate. */
+#ifndef NET_HZ
+#define NET_HZ RENDER_FPS
+#endif
+
+#define VEL_SMOOTHING       0.5f                 // Weight of the newest local velocity sample
+
+#define STREAM_VERSION      1
+#define STREAM_NEGOTIATE_MS 500                  // Server wait for "stream ok"
+#define STREAM_PERIOD_MS    (1000 / NET_HZ)      // One state frame per period
+#define STREAM_ACK_EVERY    4                    // Cumulative ack every N new frames...
+#define STREAM_ACK_MS       250                  // ...or at least this often
+#define STREAM_REPORT_SEC   10
+#define NET_HANDSHAKE_SEC   3                    // Server: read timeout while a client joins
+
+/* Build option: make NET_REJOIN_SEC=<n> sets how long a streaming peer whose link
+ * dropped may take to come back (0: a drop ends its session, as before). The client
+ * reconnects with exponential backoff for that long; the server keeps its slot, and
+ * its stream counters, just as long. */
+#ifndef NET_REJOIN_SEC
+#define NET_REJOIN_SEC 10
+#endif
+#define NET_RETRY_MIN_MS    250                  // First reconnect delay, doubled after each failure...
+#define NET_RETRY_MAX_MS    4000                 // ...up to this
+#define NET_CONNECT_SEC     1                    // connect() timeout of one attempt
+// A streaming peer silent this long is lost (longer than a handshake can stall the server)
+#define NET_SILENCE_MS      ((NET_HANDSHAKE_SEC + 2) * 1000)
+
+/* Build option: make NET_UDP=0 keeps the streamed frames on the TCP connection.
+ * With 1 they travel as UDP datagrams (a lost frame is dropped, never resent) when
+ * the peer accepts; the handshake and q/qok stay on TCP. */
+#ifndef NET_UDP
+#define NET_UDP 1
+#endif
+
+/* Build options: NET_NODELAY=1 (default) sets TCP_NODELAY, so each flushed batch
+ * leaves at once instead of waiting behind Nagle and the peer's delayed ACK.
+ * NET_CORK=1 keeps the socket corked and uncorks it on every flush instead. */
+#ifndef NET_NODELAY
+#define NET_NODELAY 1
+#endif
+#ifndef NET_CORK
+#define NET_CORK 0
+#endif
+
 /* * Rotation angle for coordinate transformation. 
  * If non-zero, the view is rotated between Local and Virtual space.
  */
@@ -48,22 +107,73 @@ typedef enum {
     CL_WAIT_POK          // Wait for Server to acknowledge my data
 } NetState;
 
-static NetState net_state;
-static int net_fd = -1;
+/* * Streaming protocol counters of one connection (see MACRO-SECTION 6).
+ */
+typedef struct {
+    uint32_t tx_seq, rx_seq;       // Last frame sent / newest frame received
+    uint32_t acked;                // Highest of our frames the peer has seen
+    long long rx_t_ms;             // Peer timestamp of frame rx_seq
+    long long rx_at_ms;            // When it arrived (ack hold time)
+    uint32_t acked_rx_seq;         // rx_seq at our last ack
+    long long last_ack_ms;
+    // Counters for the periodic report
+    unsigned long sent, received, stale, coalesced, lost;
+    long long rtt_ms;
+} StreamState;
 
-/* * Buffer structure for Non-Blocking I/O.
- * Accumulates partial reads until a full newline-terminated message is found.
+/* * One connection. A client has a single Peer (the server, drone id 0); the server
+ * has one per accepted client, whose drone id is its slot + 1.
  */
 typedef struct {
-    char data[BUFSZ];
-    int len;
-} SocketBuffer;
+    int fd;                        // TCP connection, -1 when the slot is free
+    int udp_fd;                    // Connected UDP frame socket, -1 if frames use TCP
+    int id;
+    int streaming;                 // Negotiated protocol: 1 streaming, 0 lock-step
+    NetState state;                // Lock-step state machine
+    NetBuf buf;                    // Received bytes, handshake included (see netbuf.h)
+    NetOut out;                    // Lines queued until the end of the loop pass
+    StreamState st;
+    float rx_x, rx_y;              // Newest frame of this loop iteration (virtual coords)
+    float rx_vel[2];               // Its velocity (virtual units/s), if rx_has_vel
+    int rx_has_vel;
+    int have_new;
+    long long heard_ms;            // Last line from the peer (TCP or UDP)
+    int suspended;                 // Server: link lost, slot kept for a rejoin until rejoin_by_ms
+    long long rejoin_by_ms;
+} Peer;
 
-static SocketBuffer sock_buf = { .len = 0 };
+/* * Drones relayed by the server (client side, "r" lines): newest sequence per id.
+ */
+typedef struct {
+    uint32_t rx_seq;
+    float x, y;
+    float vel[2];
+    int has_vel;
+    int have_new;
+} RelayTrack;
+
+static Peer peers[NET_MAX_PEERS];
+static int peer_count = 0;         // Slots in use: 1 on a client
+static RelayTrack relayed[NET_MAX_PEERS + 1];
+
+/* * Rejoin ticket. The server draws session_id at startup and hands every streaming
+ * client "join <id> <session>"; a client that lost its link presents it again.
+ */
+static uint32_t session_id = 0;    // Client: 0 until the server sent a ticket
+static int my_id = 0;              // Client: our drone id on the server
+static struct { int id; unsigned int session, rx_seq; } rejoin_req; // Server: last "rejoin" line
+
+/* Client: where the server is, and the reconnect schedule while the link is down */
+static char server_addr[64];
+static int server_port = 0;
+static long long retry_at_ms = 0, retry_until_ms = 0;
+static int retry_delay_ms = NET_RETRY_MIN_MS;
 
 /* Cached local positions to be sent over the network */
 static float my_last_x = 0.0f;
 static float my_last_y = 0.0f;
+static float my_vel_x = 0.0f, my_vel_y = 0.0f;   // Smoothed, local units per second
+static long long my_last_ms = 0;                 // Arrival of my_last_x/y
 
 
 /* * ======================================================================================
@@ -125,6 +235,12 @@ void virt_to_local(float vx, float vy, float *lx, float *ly) {
     *ly = y;
 }
 
+static long long mono_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
 /* Sets a file descriptor to Non-Blocking mode used for select() multiplexing */
 void set_nonblocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
@@ -139,10 +255,11 @@ void set_nonblocking(int fd) {
  * Functions handling raw socket reads/writes, ensuring strict newline delimitation.
  */
 
-/* * Formats and sends a message ensuring strict Protocol adherence.
- * The protocol requires every message to end with '\n'.
+/* * Formats and queues a message ensuring strict Protocol adherence.
+ * The protocol requires every message to end with '\n'. Nothing is written
+ * until peer_flush(), so the lines of one pass leave in a single send().
  */
-void send_msg(int fd, const char *fmt, ...) {
+void send_msg(Peer *p, const char *fmt, ...) {
     char buf[BUFSZ];
     va_list args;
     
@@ -154,7 +271,7 @@ void send_msg(int fd, const char *fmt, ...) {
     int len = strlen(buf);
     
     // 2. Log raw data before modification
-    logMessage(LOG_PATH_SC, "[NET-OUT] Sending raw data: '%s'", buf);
+    LOG_DEBUG(LOG_PATH_SC, "[NET-OUT] Sending raw data: '%s'", buf);
 
     // 3. FORCE NEWLINE: The protocol relies on \n to detect end of message
     if (len == 0 || buf[len-1] != '\n') {
@@ -163,75 +280,72 @@ void send_msg(int fd, const char *fmt, ...) {
         len++;
     }
 
-    // 4. Write to socket
-    ssize_t sent = write(fd, buf, len);
-    
-    if (sent < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EPIPE)
-            logMessage(LOG_PATH_SC, "[NET] ERROR sending: %s", strerror(errno));
+    // 4. Queue for the socket
+    if (netout_append(&p->out, buf, len) < 0) {
+        LOG_ERROR(LOG_PATH_SC, "[NET] Output queue of peer %d full, line dropped", p->id);
     }
 }
 
-/* * Reads raw bytes from the socket into the persistent buffer `sock_buf`.
- * Returns 1 if data read, 0 if buffer full, -1 if connection closed.
+/* * Sends everything queued for the peer. A partial write keeps the rest queued
+ * (the loop then waits for the socket to be writable). With NET_CORK the socket
+ * stays corked between flushes and is uncorked here to push the batch out.
+ * Returns -1 on a socket error.
  */
-int read_socket_chunk(int fd) {
-    if (sock_buf.len >= BUFSZ - 1) {
-        logMessage(LOG_PATH_SC, "[NET-ERR] Buffer full! Cannot read more.");
-        return 0; 
-    }
-    
-    ssize_t n = read(fd, sock_buf.data + sock_buf.len, BUFSZ - 1 - sock_buf.len);
-    if (n > 0) {
-        sock_buf.len += n;
-        sock_buf.data[sock_buf.len] = '\0';
-        return 1; 
+int peer_flush(Peer *p) {
+    if (netout_pending(&p->out) == 0) return 0;
+    ssize_t left = netout_flush(&p->out, p->fd);
+#if NET_CORK
+    int off = 0, on = 1;
+    setsockopt(p->fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+    setsockopt(p->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+#endif
+    if (left < 0) {
+        if (errno != EPIPE && errno != ECONNRESET)
+            LOG_ERROR(LOG_PATH_SC, "[NET] ERROR sending: %s", strerror(errno));
+        return -1;
     }
-    if (n == 0) logMessage(LOG_PATH_SC, "[NET-IN] Connection closed by peer (read 0).");
-    return (n == 0) ? -1 : 0;
+    return 0;
 }
 
-/* * Extracts a single line from `sock_buf` based on the newline delimiter.
- * Returns 1 if a line was found and extracted, 0 otherwise.
+/* * Reads everything the peer's socket has into its buffer.
+ * Returns 1 if data read, 0 if nothing (or the buffer is full), -1 if connection closed.
  */
-int get_line_from_buffer(char *out_line, int max_len) {
-    char *newline_ptr = strchr(sock_buf.data, '\n');
-    
-    if (newline_ptr) {
-        // Calculate line length excluding the newline
-        int line_len = newline_ptr - sock_buf.data;
-        
-        if (line_len >= max_len) line_len = max_len - 1;
-        
-        // Copy the line
-        memcpy(out_line, sock_buf.data, line_len);
-        out_line[line_len] = '\0'; // Null-terminate for C string safety
-        
-        logMessage(LOG_PATH_SC, "[NET-PARSE] Extracted line (via \\n): '%s'", out_line);
-
-        // Shift remaining data in buffer to the front
-        int remaining = sock_buf.len - (newline_ptr - sock_buf.data) - 1;
-        memmove(sock_buf.data, newline_ptr + 1, remaining);
-        sock_buf.len = remaining;
-        sock_buf.data[sock_buf.len] = '\0';
-        return 1;
+int read_socket_chunk(Peer *p) {
+    int got = 0;
+    while (1) {
+        ssize_t n = netbuf_fill(&p->buf, p->fd);
+        if (n > 0) {
+            got = 1;
+            continue;
+        }
+        if (n == 0) {
+            logMessage(LOG_PATH_SC, "[NET-IN] Connection closed by peer (read 0).");
+            return -1;
+        }
+        if (errno == EMSGSIZE) {
+            LOG_ERROR(LOG_PATH_SC, "[NET-ERR] Line longer than %d bytes from peer %d, dropped", NETBUF_MAX, p->id);
+            continue;
+        }
+        if (errno == EINTR) continue;
+        // EAGAIN: drained. ENOBUFS: full of lines, the loop stops polling it until they are parsed
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+            LOG_ERROR(LOG_PATH_SC, "[NET-ERR] Read failed: %s", strerror(errno));
+            return -1;
+        }
+        return got;
     }
-    return 0;
 }
 
 /* * Blocking Read (Used only during initial Handshake).
- * Reads byte-by-byte until a newline is found.
+ * Fills the peer's buffer until a line is complete, so bytes the peer sent
+ * right after it (e.g. the first streamed lines) stay buffered for the loop.
+ * Returns the line, or NULL if the connection closed or the read timed out.
  */
-int read_line_blocking(int fd, char *out, int out_sz) {
-    int pos = 0; char c;
-    while (pos < out_sz - 1) {
-        if (read(fd, &c, 1) <= 0) return -1;
-        if (c == '\n') break; 
-        out[pos++] = c;
-    }
-    out[pos] = '\0'; 
-    logMessage(LOG_PATH_SC, "[HANDSHAKE] Blocking read: '%s'", out);
-    return pos;
+const char *read_line_blocking(Peer *p) {
+    peer_flush(p); // The peer may be waiting for what we queued before answering
+    const char *line = netbuf_read_line(&p->buf, p->fd, NULL);
+    if (line) LOG_DEBUG(LOG_PATH_SC, "[HANDSHAKE] Blocking read: '%s'", line);
+    return line;
 }
 
 
@@ -242,6 +356,17 @@ int read_line_blocking(int fd, char *out, int out_sz) {
  * initial strict protocol handshake to sync Client/Server.
  */
 
+/* * Per-connection TCP options (NET_NODELAY / NET_CORK). Lines are already batched
+ * by peer_flush(), so Nagle would only add a delayed-ACK round trip.
+ */
+static void tcp_tune(int fd) {
+    int on = 1;
+    if (NET_NODELAY && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0)
+        LOG_ERROR(LOG_PATH_SC, "[NET] TCP_NODELAY failed: %s", strerror(errno));
+    if (NET_CORK && setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on)) < 0)
+        LOG_ERROR(LOG_PATH_SC, "[NET] TCP_CORK failed: %s", strerror(errno));
+}
+
 int init_server(int port) {
     int s = socket(AF_INET, SOCK_STREAM, 0);
     int opt = 1; setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
@@ -249,263 +374,984 @@ int init_server(int port) {
     a.sin_family = AF_INET; a.sin_addr.s_addr = INADDR_ANY; a.sin_port = htons(port);
     
     if (bind(s, (struct sockaddr*)&a, sizeof(a)) < 0) {
-        logMessage(LOG_PATH_SC, "[NET-ERR] Bind failed: %s", strerror(errno));
+        LOG_ERROR(LOG_PATH_SC, "[NET-ERR] Bind failed: %s", strerror(errno));
         return -1;
     }
-    listen(s, 1);
-    logMessage(LOG_PATH_SC, "[NET-SRV] Waiting for connection on port %d...", port);
-    
-    struct sockaddr_in cli;
-    socklen_t len = sizeof(cli);
-    int client_fd = accept(s, (struct sockaddr*)&cli, &len);
-    if (client_fd >= 0) {
-        logMessage(LOG_PATH_SC, "[NET-SRV] Accepted connection from %s", inet_ntoa(cli.sin_addr));
-    }
-    return client_fd;
+    // Clients are accepted by the event loop, up to NET_MAX_PEERS at a time
+    listen(s, NET_MAX_PEERS);
+    logMessage(LOG_PATH_SC, "[NET-SRV] Waiting for connections on port %d...", port);
+    return s;
 }
 
-int init_client(const char *addr, int port) {
+// Reconnect delays: NET_RETRY_MIN_MS, doubled after every failed attempt up to NET_RETRY_MAX_MS
+static int next_delay(int delay_ms) {
+    return (delay_ms * 2 < NET_RETRY_MAX_MS) ? delay_ms * 2 : NET_RETRY_MAX_MS;
+}
+
+/* * One connection attempt, bounded by NET_CONNECT_SEC (connect() honours SO_SNDTIMEO).
+ * A fresh socket each time: one whose connect() failed cannot be reused portably.
+ * Returns the socket, or -1.
+ */
+static int tcp_connect(const char *addr, int port) {
     int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) return -1;
     struct sockaddr_in a = {0};
     a.sin_family = AF_INET; a.sin_port = htons(port);
     inet_pton(AF_INET, addr, &a.sin_addr);
-    
+
+    struct timeval tv = { NET_CONNECT_SEC, 0 };
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(s, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        close(s);
+        return -1;
+    }
+    tv.tv_sec = 0;
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    tcp_tune(s);
+    return s;
+}
+
+int init_client(const char *addr, int port) {
+    strncpy(server_addr, addr, sizeof(server_addr) - 1);
+    server_port = port;
+
     logMessage(LOG_PATH_SC, "[NET-CLI] Connecting to %s:%d ...", addr, port);
-    while (connect(s, (struct sockaddr*)&a, sizeof(a)) < 0) {
-        logMessage(LOG_PATH_SC, "[NET-CLI] Retry in 1s...");
-        sleep(1);
+    int s, delay_ms = NET_RETRY_MIN_MS;
+    while ((s = tcp_connect(addr, port)) < 0) {
+        logMessage(LOG_PATH_SC, "[NET-CLI] Retry in %d ms...", delay_ms);
+        usleep(delay_ms * 1000);
+        delay_ms = next_delay(delay_ms);
     }
     logMessage(LOG_PATH_SC, "[NET-CLI] Connected!");
     return s;
 }
 
 /* Helpers for Blackboard Communication */
+static void bb_write(int fd_out, const Message *msg) {
+    metrics_msg_out(msg->type);
+    metrics_write(fd_out, msg, sizeof(*msg));
+}
+
 void send_window_size(int fd_out, int w, int h) {
-    Message msg; msg.type = MSG_TYPE_SIZE;
-    snprintf(msg.data, sizeof(msg.data), "%d %d", w, h);
-    write(fd_out, &msg, sizeof(msg));  
+    Message msg;
+    msg_encode_size(&msg, w, h);
+    bb_write(fd_out, &msg);
     logMessage(LOG_PATH_SC, "[BB-OUT] Sent Window Size: %d %d", w, h);
 }
 
 void receive_window_size(int fd_in, int *w, int *h){
     Message msg;
-    if (read(fd_in, &msg, sizeof(msg)) > 0) {
-        sscanf(msg.data, "%d %d", w, h);
+    if (metrics_read(fd_in, &msg, sizeof(msg)) > 0 && msg_decode_size(&msg, w, h) == 0) {
         logMessage(LOG_PATH_SC, "[BB-IN] Received Window Size: %d %d", *w, *h);
     }
 }
 
-void update_local_position(int fd_in) {
+/* * Drains the Blackboard pipe (latest local position) and updates the local velocity
+ * estimate streamed with it. Returns 1 if it asked to quit.
+ */
+int update_local_position(int fd_in) {
     Message msg;
-    while (read(fd_in, &msg, sizeof(msg)) > 0) {
-        sscanf(msg.data, "%f %f", &my_last_x, &my_last_y);
+    float x, y;
+    while (metrics_read(fd_in, &msg, sizeof(msg)) > 0) {
+        metrics_msg_in(msg.type);
+        if (msg.type == MSG_TYPE_POSITION && msg_decode_position(&msg, &x, &y) == 0) {
+            long long now = mono_ms();
+            if (my_last_ms && now > my_last_ms) {
+                float dt = (now - my_last_ms) / 1000.0f;
+                my_vel_x += VEL_SMOOTHING * ((x - my_last_x) / dt - my_vel_x);
+                my_vel_y += VEL_SMOOTHING * ((y - my_last_y) / dt - my_vel_y);
+            }
+            // A second position within the same millisecond only replaces x, y
+            if (now > my_last_ms) my_last_ms = now;
+            my_last_x = x;
+            my_last_y = y;
+        }
+        else if (msg.type == MSG_TYPE_EXIT) return 1;
     }
+    return 0;
+}
+
+/* Forwards a remote drone (virtual coords, velocity if vel) to the Blackboard */
+void send_remote_drone(int fd_bb_out, int id, float virt_x, float virt_y, const float *vel) {
+    float remote_x, remote_y, local_vel[2];
+    Message msg;
+    virt_to_local(virt_x, virt_y, &remote_x, &remote_y);
+    // Velocities only rotate
+    if (vel) virt_to_local(vel[0], vel[1], &local_vel[0], &local_vel[1]);
+    msg_encode_drone(&msg, id, remote_x, remote_y, vel ? local_vel : NULL);
+    bb_write(fd_bb_out, &msg);
 }
 
 /* * The Handshake Logic:
  * 1. Server sends "ok" -> Client confirms with "ook".
  * 2. Server sends "size W H" -> Client confirms with "sok W H".
  * 3. Client adapts local window size to match Server.
+ * A client resuming its session answers "rejoin <id> <session> <rx_seq>" instead of
+ * "ook": the server stores it in rejoin_req and returns 1 (see resume_peer()).
  */
-int protocol_handshake(int mode, int fd, int *w, int *h, int fd_bb_out) {
-    char buf[BUFSZ];
+int protocol_handshake(int mode, Peer *p, int *w, int *h, int fd_bb_out) {
+    const char *line;
     logMessage(LOG_PATH_SC, "[HANDSHAKE] Start Mode: %s", mode == MODE_SERVER ? "SERVER" : "CLIENT");
     
     if (mode == MODE_SERVER) {
-        send_msg(fd, "ok"); 
-        if (read_line_blocking(fd, buf, sizeof(buf)) <= 0 || strcmp(buf, "ook") != 0) {
-            logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'ook', got '%s'", buf);
+        send_msg(p, "ok"); 
+        line = read_line_blocking(p);
+        if (line && sscanf(line, "rejoin %d %u %u", &rejoin_req.id, &rejoin_req.session, &rejoin_req.rx_seq) == 3) {
+            return 1;
+        }
+        if (!line || strcmp(line, "ook") != 0) {
+            logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'ook', got '%s'", line ? line : "");
             return -1;
         }
-        send_msg(fd, "size %d %d", *w, *h); 
-        if (read_line_blocking(fd, buf, sizeof(buf)) <= 0 || sscanf(buf, "sok %d %d", w, h) != 2) {
-             logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'sok', got '%s'", buf);
+        send_msg(p, "size %d %d", *w, *h); 
+        if (!(line = read_line_blocking(p)) || sscanf(line, "sok %d %d", w, h) != 2) {
+             logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'sok', got '%s'", line ? line : "");
              return -1;
         }
     } else {
-        if (read_line_blocking(fd, buf, sizeof(buf)) <= 0 || strcmp(buf, "ok") != 0) {
-            logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'ok', got '%s'", buf);
+        if (!(line = read_line_blocking(p)) || strcmp(line, "ok") != 0) {
+            logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'ok', got '%s'", line ? line : "");
             return -1;
         }
-        send_msg(fd, "ook"); 
-        if (read_line_blocking(fd, buf, sizeof(buf)) <= 0 || sscanf(buf, "size %d %d", w, h) != 2) {
-             logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'size', got '%s'", buf);
+        send_msg(p, "ook"); 
+        if (!(line = read_line_blocking(p)) || sscanf(line, "size %d %d", w, h) != 2) {
+             logMessage(LOG_PATH_SC, "[HANDSHAKE] Error: Expected 'size', got '%s'", line ? line : "");
              return -1;
         }
         send_window_size(fd_bb_out, *w, *h);
-        send_msg(fd, "sok %d %d", *w, *h); 
+        send_msg(p, "sok %d %d", *w, *h); 
     }
     
-    // Set initial state based on Role
-    net_state = (mode == MODE_SERVER) ? SV_SEND_CMD_DRONE : CL_WAIT_COMMAND;
-    logMessage(LOG_PATH_SC, "[HANDSHAKE] Done. State: %s", state_to_str(net_state));
+    logMessage(LOG_PATH_SC, "[HANDSHAKE] Done.");
     return 0;
 }
 
 
+
+
 /* * ======================================================================================
- * MACRO-SECTION 5: MAIN LOGIC LOOP (STATE MACHINE)
+ * MACRO-SECTION 5: LOCK-STEP PROTOCOL (STATE MACHINE)
  * ======================================================================================
- * The core loop that multiplexes between Network I/O and Blackboard I/O using select().
- * Implements the NetState state machine.
+ * The reference drone/dok/obst/pok exchange, one state machine per connection.
+ * A lock-step client only ever sees the server's drone (the protocol has one).
+ */
+
+/* * Runs the connection's state machine over its buffered lines. The server starts
+ * a new exchange only on a frame tick: with the lines no longer held back by
+ * Nagle, an unpaced exchange would spin as fast as the round trip allows.
+ * Returns -1 when the session with this peer ended ("q"), 0 otherwise.
+ */
+int lockstep_step(Peer *p, int mode, int tick, int fd_bb_out) {
+    const char *net_line;
+    float rx, ry, vx, vy;
+    int state_changed;
+
+    do {
+        state_changed = 0;
+        if (mode == MODE_SERVER) {
+            switch (p->state) {
+                case SV_SEND_CMD_DRONE:
+                    if (!tick) break;
+                    tick = 0; // One exchange per tick
+                    LOG_DEBUG(LOG_PATH_SC, "[SV] >> Sending 'drone' to client %d", p->id);
+                    send_msg(p, "drone");
+                    p->state = SV_SEND_DATA_DRONE;
+                    state_changed = 1; 
+                    break;
+                case SV_SEND_DATA_DRONE:
+                    // Convert Local to Virtual coords for transmission
+                    local_to_virt(my_last_x, my_last_y, &vx, &vy);
+                    send_msg(p, "%f %f", vx, vy);
+                    p->state = SV_WAIT_DOK;
+                    break;
+                case SV_WAIT_DOK:
+                    if ((net_line = netbuf_line(&p->buf, NULL))) {
+                        if (sscanf(net_line, "dok %f %f", &rx, &ry) == 2) {
+                            LOG_DEBUG(LOG_PATH_SC, "[SV] << ACK 'dok'");
+                            p->state = SV_SEND_CMD_OBST;
+                            state_changed = 1;
+                        } else if (strcmp(net_line, "q") == 0) return -1;
+                    }
+                    break;
+                case SV_SEND_CMD_OBST:
+                    send_msg(p, "obst");
+                    p->state = SV_WAIT_DATA_OBST;
+                    break;
+                case SV_WAIT_DATA_OBST:
+                    if ((net_line = netbuf_line(&p->buf, NULL))) {
+                        if (sscanf(net_line, "%f %f", &rx, &ry) == 2) {
+                            LOG_DEBUG(LOG_PATH_SC, "[SV] << Obst Data");
+                            // Remote Virtual -> Local, forwarded to the Blackboard
+                            send_remote_drone(fd_bb_out, p->id, rx, ry, NULL);
+                            
+                            send_msg(p, "pok %f %f", rx, ry);
+                            p->state = SV_SEND_CMD_DRONE;
+                            state_changed = 1; 
+                        }
+                    }
+                    break;
+                default: break; 
+            }
+        } else { // CLIENT LOGIC
+            switch (p->state) {
+                case CL_WAIT_COMMAND:
+                    if ((net_line = netbuf_line(&p->buf, NULL))) {
+                        if (strcmp(net_line, "drone") == 0) {
+                            p->state = CL_WAIT_DRONE_DATA;
+                            state_changed = 1;
+                        } else if (strcmp(net_line, "obst") == 0) {
+                            p->state = CL_SEND_OBST_DATA;
+                            state_changed = 1;
+                        } else if (strcmp(net_line, "q") == 0) {
+                            send_msg(p, "qok");
+                            return -1;
+                        }
+                    }
+                    break;
+                case CL_WAIT_DRONE_DATA:
+                    if ((net_line = netbuf_line(&p->buf, NULL))) {
+                        if (sscanf(net_line, "%f %f", &rx, &ry) == 2) {
+                            // Remote Virtual -> Local, forwarded to the Blackboard
+                            send_remote_drone(fd_bb_out, p->id, rx, ry, NULL);
+                            
+                            send_msg(p, "dok %f %f", rx, ry);
+                            p->state = CL_WAIT_COMMAND;
+                        }
+                    }
+                    break;
+                case CL_SEND_OBST_DATA:
+                    // Convert Local -> Virtual for transmission
+                    local_to_virt(my_last_x, my_last_y, &vx, &vy);
+                    send_msg(p, "%f %f", vx, vy);
+                    p->state = CL_WAIT_POK;
+                    break;
+                case CL_WAIT_POK:
+                    if ((net_line = netbuf_line(&p->buf, NULL))) {
+                        if (sscanf(net_line, "pok %f %f", &rx, &ry) == 2) {
+                            p->state = CL_WAIT_COMMAND;
+                            state_changed = 1; 
+                        }
+                    }
+                    break;
+                default: break; 
+            }
+        }
+    } while (state_changed);
+    return 0;
+}
+
+
+/* * ======================================================================================
+ * MACRO-SECTION 6: STREAMING PROTOCOL
+ * ======================================================================================
+ * Ack-free alternative to the state machine above. After the handshake each peer
+ * pushes its own position every STREAM_PERIOD_MS, whatever the other side does:
+ *
+ *   f <seq> <t_ms> <x> <y> <vx> <vy>
+ *                                   state frame (seq starts at 1, t_ms on the sender clock,
+ *                                   velocity in units/s; peers parsing only x y still work)
+ *   a <seq> <t_ms> <hold_ms>        cumulative ack: highest frame seen, its t_ms echoed and
+ *                                   how long the ack waited, so the sender gets the RTT
+ *   r <id> <seq> <t_ms> <x> <y> [<vx> <vy>]
+ *                                   server -> client: frame of another client, relayed
+ *   l <id>                          server -> client: that client left
+ *   join <id> <session>             server -> client: ticket to resume this session
+ *   q / qok                         quit request / confirmation
+ *
+ * Rejoin: a peer that hears nothing for NET_SILENCE_MS, or whose connection drops,
+ * is lost but not gone. The client reconnects with exponential backoff and answers
+ * the server's "ok" with "rejoin <id> <session> <rx_seq>"; the server, which kept
+ * the slot for NET_REJOIN_SEC, replies with one snapshot line
+ *
+ *   snap <w> <h> <seq> <rx_seq> <t_ms> <x> <y> <vx> <vy>
+ *                                   window size, the server's newest frame, and the
+ *                                   newest frame it had from the client
+ *
+ * followed by an "r" line per other client, and both sides carry on with their
+ * sequence numbers where they were (frames on TCP from then on). "rejoin no" means
+ * the slot is gone: the client drops its ticket and joins again from scratch.
+ *
+ * Frames older than the newest one already seen are dropped, and when several frames
+ * are queued only the newest is forwarded to the Blackboard. With NET_UDP, frames and
+ * acks are UDP datagrams (one line each, no newline): a lost frame is simply replaced
+ * by the next one instead of holding back the TCP stream.
+ */
+
+/* * UDP socket for the frames: bound to an ephemeral port, reported in *port.
+ */
+static int udp_open(int *port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_in a = {0};
+    a.sin_family = AF_INET; a.sin_addr.s_addr = INADDR_ANY; a.sin_port = 0;
+    socklen_t len = sizeof(a);
+    if (bind(fd, (struct sockaddr*)&a, sizeof(a)) < 0 ||
+        getsockname(fd, (struct sockaddr*)&a, &len) < 0) {
+        LOG_ERROR(LOG_PATH_SC, "[STREAM] UDP socket failed: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(a.sin_port);
+    return fd;
+}
+
+// Points the UDP socket at the peer's host (the TCP peer address) and UDP port
+static int udp_connect(int udp_fd, int tcp_fd, int port) {
+    struct sockaddr_in a;
+    socklen_t len = sizeof(a);
+    if (getpeername(tcp_fd, (struct sockaddr*)&a, &len) < 0) return -1;
+    a.sin_port = htons(port);
+    if (connect(udp_fd, (struct sockaddr*)&a, sizeof(a)) < 0) {
+        LOG_ERROR(LOG_PATH_SC, "[STREAM] UDP connect failed: %s", strerror(errno));
+        return -1;
+    }
+    logMessage(LOG_PATH_SC, "[STREAM] Frames over UDP to %s:%d", inet_ntoa(a.sin_addr), port);
+    return 0;
+}
+
+/* * Offers the streaming mode once the handshake is done.
+ * Server: sends "stream <v> [udp <port>]" and waits STREAM_NEGOTIATE_MS for
+ * "stream ok [udp <port>]".
+ * Client: the first line is either the offer (accepted) or the first lock-step
+ * command, which is left in the peer's buffer for lockstep_step().
+ * p->udp_fd is the connected frame socket when both sides chose UDP, -1 otherwise.
+ * Returns 1 if both peers stream, 0 for lock-step, -1 if the connection dropped.
  */
+int stream_negotiate(int mode, Peer *p) {
+    const char *line;
+    int my_port = 0, peer_port = 0;
+    int fd = p->fd;
+    p->udp_fd = NET_UDP ? udp_open(&my_port) : -1;
 
-void network_loop(int mode, int fd_bb_in, int fd_bb_out) {
+    if (mode == MODE_SERVER) {
+        if (p->udp_fd >= 0) send_msg(p, "stream %d udp %d", STREAM_VERSION, my_port);
+        else send_msg(p, "stream %d", STREAM_VERSION);
+        peer_flush(p);
+
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv = { 0, STREAM_NEGOTIATE_MS * 1000 };
+        if (!netbuf_has_line(&p->buf) && select(fd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+            logMessage(LOG_PATH_SC, "[STREAM] No answer to the offer, using lock-step");
+            goto lock_step;
+        }
+        if (!(line = read_line_blocking(p))) goto lost;
+        if (strncmp(line, "stream ok", 9) != 0) {
+            logMessage(LOG_PATH_SC, "[STREAM] Offer refused ('%s'), using lock-step", line);
+            goto lock_step;
+        }
+    } else {
+        peer_flush(p); // Our "sok": the server only sends the offer after it
+        if (netbuf_wait_line(&p->buf, fd) < 0) goto lost;
+        line = netbuf_peek(&p->buf, NULL);
+        int version;
+        if (sscanf(line, "stream %d", &version) != 1 || version != STREAM_VERSION) {
+            // A lock-step server: its first command stays buffered for the state machine
+            goto lock_step;
+        }
+        netbuf_drop(&p->buf);
+        if (p->udp_fd >= 0 && sscanf(line, "stream %d udp %d", &version, &peer_port) == 2) {
+            send_msg(p, "stream ok udp %d", my_port);
+        } else {
+            send_msg(p, "stream ok");
+        }
+        peer_flush(p);
+    }
+
+    // UDP only if both sides announced a port, TCP frames otherwise
+    if (mode == MODE_SERVER && sscanf(line, "stream ok udp %d", &peer_port) != 1) peer_port = 0;
+    if (p->udp_fd >= 0 && (peer_port <= 0 || udp_connect(p->udp_fd, fd, peer_port) < 0)) {
+        close(p->udp_fd);
+        p->udp_fd = -1;
+    }
+    return 1;
+
+lock_step:
+    if (p->udp_fd >= 0) close(p->udp_fd);
+    p->udp_fd = -1;
+    return 0;
+lost:
+    if (p->udp_fd >= 0) close(p->udp_fd);
+    p->udp_fd = -1;
+    return -1;
+}
+
+/* * Frames and acks go to the peer's UDP socket when there is one, else on its TCP line.
+ * A datagram carries one line without the trailing newline.
+ */
+static void stream_send(Peer *p, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void stream_send(Peer *p, const char *fmt, ...) {
+    char buf[BUFSZ];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < 0) return;
+
+    if (p->udp_fd < 0) {
+        send_msg(p, "%s", buf);
+        return;
+    }
+    if (len >= (int)sizeof(buf)) len = sizeof(buf) - 1;
+    // ECONNREFUSED only means the peer's socket is not there (yet): the next frame retries
+    if (send(p->udp_fd, buf, len, 0) < 0 && errno != ECONNREFUSED && errno != EAGAIN) {
+        LOG_DEBUG(LOG_PATH_SC, "[STREAM] UDP send failed: %s", strerror(errno));
+    }
+}
+
+// A state frame of the peer ("f", or the one in a "snap"); vel NULL if it had none
+static void stream_frame(Peer *p, unsigned int seq, long long t_ms, float x, float y, const float *vel, long long now) {
+    StreamState *st = &p->st;
+    if (seq <= st->rx_seq) {
+        st->stale++;
+        return;
+    }
+    if (p->have_new) st->coalesced++; // An older frame of this batch is never forwarded
+    if (st->rx_seq && seq > st->rx_seq + 1) st->lost += seq - st->rx_seq - 1;
+    st->rx_seq = seq;
+    st->rx_t_ms = t_ms;
+    st->rx_at_ms = now;
+    st->received++;
+    p->rx_x = x;
+    p->rx_y = y;
+    p->rx_vel[0] = vel ? vel[0] : 0.0f;
+    p->rx_vel[1] = vel ? vel[1] : 0.0f;
+    p->rx_has_vel = (vel != NULL);
+    p->have_new = 1;
+}
+
+// Parses one line from the peer. Returns 1 when its session ended, 0 otherwise.
+static int stream_handle_line(Peer *p, const char *line, long long now, int fd_bb_out) {
+    StreamState *st = &p->st;
+    unsigned int seq, session;
+    int id;
+    long long t_ms, hold_ms;
+    float x, y, vel[2];
+    int n;
+
+    p->heard_ms = now;
+    if ((n = sscanf(line, "f %u %lld %f %f %f %f", &seq, &t_ms, &x, &y, &vel[0], &vel[1])) >= 4) {
+        stream_frame(p, seq, t_ms, x, y, (n == 6) ? vel : NULL, now);
+    } else if (sscanf(line, "a %u %lld %lld", &seq, &t_ms, &hold_ms) == 3) {
+        if (seq > st->acked) {
+            st->acked = seq;
+            st->rtt_ms = now - t_ms - hold_ms;
+        }
+    } else if ((n = sscanf(line, "r %d %u %lld %f %f %f %f", &id, &seq, &t_ms, &x, &y, &vel[0], &vel[1])) >= 5) {
+        if (id < 1 || id > NET_MAX_PEERS) return 0;
+        RelayTrack *r = &relayed[id];
+        if (seq <= r->rx_seq) {
+            st->stale++;
+            return 0;
+        }
+        r->rx_seq = seq;
+        r->x = x;
+        r->y = y;
+        r->vel[0] = vel[0];
+        r->vel[1] = vel[1];
+        r->has_vel = (n == 7);
+        r->have_new = 1;
+    } else if (sscanf(line, "l %d", &id) == 1) {
+        if (id < 1 || id > NET_MAX_PEERS) return 0;
+        relayed[id].rx_seq = 0;
+        relayed[id].have_new = 0;
+        Message msg;
+        msg_encode_peer_left(&msg, id);
+        bb_write(fd_bb_out, &msg);
+    } else if (sscanf(line, "join %d %u", &id, &session) == 2) {
+        my_id = id;
+        session_id = session;
+        logMessage(LOG_PATH_SC, "[NET-CLI] Joined as client %d (a lost link is resumed for %d s)", id, NET_REJOIN_SEC);
+    } else if (strcmp(line, "q") == 0) {
+        send_msg(p, "qok");
+        return 1;
+    } else if (strcmp(line, "qok") == 0) {
+        return 1;
+    } else {
+        LOG_DEBUG(LOG_PATH_SC, "[STREAM] Ignored line '%s'", line);
+    }
+    return 0;
+}
+
+// Every buffered TCP line and every pending datagram of one peer
+static int stream_receive(Peer *p, int udp_ready, long long now, int fd_bb_out) {
     char net_line[BUFSZ];
-    
-    // Logic Variables
-    float rx, ry; 
-    float vx, vy; 
-    float remote_x, remote_y;
-    Message msg; 
-    fd_set read_fds;
-    struct timeval timeout; 
-
-    set_nonblocking(net_fd);
+    const char *line;
+    while ((line = netbuf_line(&p->buf, NULL))) {
+        if (stream_handle_line(p, line, now, fd_bb_out)) return 1;
+    }
+    if (p->udp_fd >= 0 && udp_ready) {
+        ssize_t n;
+        while ((n = recv(p->udp_fd, net_line, sizeof(net_line) - 1, 0)) >= 0) {
+            net_line[n] = '\0';
+            stream_handle_line(p, net_line, now, fd_bb_out);
+        }
+    }
+    return 0;
+}
+
+// Cumulative ack every STREAM_ACK_EVERY new frames, or STREAM_ACK_MS at the latest
+static void stream_ack(Peer *p, long long now) {
+    StreamState *st = &p->st;
+    if (st->rx_seq != st->acked_rx_seq &&
+        (st->rx_seq - st->acked_rx_seq >= STREAM_ACK_EVERY || now - st->last_ack_ms >= STREAM_ACK_MS)) {
+        stream_send(p, "a %u %lld %lld", st->rx_seq, st->rx_t_ms, now - st->rx_at_ms);
+        st->acked_rx_seq = st->rx_seq;
+        st->last_ack_ms = now;
+    }
+}
+
+static void stream_report(const Peer *p) {
+    const StreamState *st = &p->st;
+    logMessage(LOG_PATH_SC, "[STREAM] peer %d: sent %lu (acked up to %u), received %lu, lost %lu, stale %lu, coalesced %lu, rtt %lld ms",
+               p->id, st->sent, st->acked, st->received, st->lost, st->stale, st->coalesced, st->rtt_ms);
+}
+
+
+/* * ======================================================================================
+ * MACRO-SECTION 7: EVENT LOOP AND PEERS
+ * ======================================================================================
+ * One non-blocking select() loop for the Blackboard pipe, the listening socket
+ * (server) and every connection, whatever protocol each one negotiated.
+ */
+
+static void log_protocol(const Peer *p) {
+    logMessage(LOG_PATH_SC, "[NET] Peer %d protocol: %s", p->id, !p->streaming ? "lock-step" :
+               (p->udp_fd >= 0) ? "streaming (UDP frames)" : "streaming (TCP frames)");
+}
+
+// Sockets and buffers of a connection; its slot and counters are the caller's
+static void conn_close(Peer *p) {
+    peer_flush(p); // Best effort: a last "qok", "q" or "rejoin no"
+    if (p->udp_fd >= 0) close(p->udp_fd);
+    if (p->fd >= 0) close(p->fd);
+    p->fd = p->udp_fd = -1;
+    netbuf_free(&p->buf);
+    netout_free(&p->out);
+}
+
+static void peer_close(Peer *p) {
+    if (p->streaming) stream_report(p);
+    conn_close(p);
+    peer_count--;
+}
+
+/* * A connection is lost (dropped, or silent for NET_SILENCE_MS) but may come back:
+ * its sockets and buffers go, its protocol state and stream counters stay. On the
+ * server the slot is kept until rejoin_by_ms; its drone simply gets no new frames,
+ * and the Blackboard stops extrapolating it on its own.
+ */
+static void peer_suspend(Peer *p, long long now) {
+    peer_close(p);
+    p->have_new = 0;
+    p->suspended = 1;
+    p->rejoin_by_ms = now + NET_REJOIN_SEC * 1000LL;
+}
+
+/* * Server: a client is gone. Its drone leaves the Blackboard and the other clients.
+ */
+static void peer_left(Peer *p, int fd_bb_out) {
+    logMessage(LOG_PATH_SC, "[NET-SRV] Client %d left", p->id);
+    Message msg;
+    msg_encode_peer_left(&msg, p->id);
+    bb_write(fd_bb_out, &msg);
+
+    int id = p->id;
+    if (p->suspended) p->suspended = 0; // Closed already: the slot is free again
+    else peer_close(p);
+    for (int i = 0; i < NET_MAX_PEERS; i++) {
+        if (peers[i].fd >= 0 && peers[i].streaming) send_msg(&peers[i], "l %d", id);
+    }
+}
+
+// Back to the non-blocking sockets of the event loop once a handshake is over
+static void conn_ready(Peer *p) {
+    struct timeval tv = { 0, 0 };
+    setsockopt(p->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    set_nonblocking(p->fd);
+    if (p->udp_fd >= 0) set_nonblocking(p->udp_fd);
+    p->heard_ms = p->st.last_ack_ms = mono_ms();
+}
+
+/* * Server: the connection np asked to resume client rejoin_req.id ("rejoin"). It
+ * takes over that suspended slot, whose sequence numbers and counters carry on,
+ * and gets the snapshot: window size, our newest frame, every other client's.
+ * Returns the slot, or NULL after "rejoin no" when there is nothing to resume.
+ */
+static Peer *resume_peer(Peer *np, int w, int h) {
+    int id = rejoin_req.id;
+    Peer *p = (id >= 1 && id <= NET_MAX_PEERS) ? &peers[id - 1] : NULL;
+    if (!p || !p->suspended || rejoin_req.session != session_id) {
+        logMessage(LOG_PATH_SC, "[NET-SRV] Nothing to resume for client %d, refused", id);
+        send_msg(np, "rejoin no");
+        return NULL;
+    }
+
+    long long now = mono_ms();
+    logMessage(LOG_PATH_SC, "[NET-SRV] Client %d rejoined after %lld ms, it missed %u of our frames",
+               id, now - (p->rejoin_by_ms - NET_REJOIN_SEC * 1000LL), p->st.tx_seq - rejoin_req.rx_seq);
+    p->fd = np->fd;
+    p->buf = np->buf;
+    p->out = np->out;
+    p->suspended = 0;
+    peer_count++;
+
+    float vx, vy, vel[2];
+    local_to_virt(my_last_x, my_last_y, &vx, &vy);
+    local_to_virt(my_vel_x, my_vel_y, &vel[0], &vel[1]);
+    send_msg(p, "snap %d %d %u %u %lld %f %f %f %f", w, h, ++p->st.tx_seq, p->st.rx_seq, now,
+             vx, vy, vel[0], vel[1]);
+    p->st.sent++;
+    for (int k = 0; k < NET_MAX_PEERS; k++) {
+        Peer *q = &peers[k];
+        if (q == p || q->fd < 0 || !q->streaming || !q->st.rx_seq) continue;
+        if (q->rx_has_vel) {
+            send_msg(p, "r %d %u %lld %f %f %f %f", q->id, q->st.rx_seq, q->st.rx_t_ms,
+                     q->rx_x, q->rx_y, q->rx_vel[0], q->rx_vel[1]);
+        } else {
+            send_msg(p, "r %d %u %lld %f %f", q->id, q->st.rx_seq, q->st.rx_t_ms, q->rx_x, q->rx_y);
+        }
+    }
+    return p;
+}
+
+/* * Server: accepts one client and runs its handshake. The handshake is blocking, but
+ * bounded by NET_HANDSHAKE_SEC so a silent client cannot stall the others for long.
+ * It runs on a connection of its own: a rejoining client goes back to its old slot.
+ */
+static void accept_peer(int listen_fd, int w, int h) {
+    struct sockaddr_in cli;
+    socklen_t len = sizeof(cli);
+    int fd = accept(listen_fd, (struct sockaddr*)&cli, &len);
+    if (fd < 0) return;
+
+    Peer *slot = NULL;
+    int suspended = 0;
+    for (int i = 0; i < NET_MAX_PEERS; i++) {
+        if (peers[i].suspended) suspended++;
+        else if (peers[i].fd < 0 && !slot) slot = &peers[i];
+    }
+    if (!slot && !suspended) {
+        logMessage(LOG_PATH_SC, "[NET-SRV] Session full (%d clients), refusing %s", NET_MAX_PEERS, inet_ntoa(cli.sin_addr));
+        close(fd);
+        return;
+    }
+
+    Peer np;
+    memset(&np, 0, sizeof(np));
+    if (netbuf_init(&np.buf) < 0 || netout_init(&np.out) < 0) {
+        LOG_ERROR(LOG_PATH_SC, "[NET-SRV] Out of memory, refusing %s", inet_ntoa(cli.sin_addr));
+        netbuf_free(&np.buf);
+        close(fd);
+        return;
+    }
+    np.fd = fd;
+    np.udp_fd = -1;
+    np.id = slot ? (int)(slot - peers) + 1 : 0;
+    logMessage(LOG_PATH_SC, "[NET-SRV] Accepted connection from %s as client %d", inet_ntoa(cli.sin_addr), np.id);
+
+    tcp_tune(fd);
+    struct timeval tv = { NET_HANDSHAKE_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // Every client gets the server's size; its "sok" must not change ours
+    int cw = w, ch = h;
+    int r = protocol_handshake(MODE_SERVER, &np, &cw, &ch, -1);
+    if (r == 1) {
+        Peer *p = resume_peer(&np, w, h);
+        if (p) {
+            conn_ready(p);
+            log_protocol(p);
+        } else {
+            conn_close(&np);
+        }
+        return;
+    }
+    if (r < 0 || (np.streaming = NET_STREAM ? stream_negotiate(MODE_SERVER, &np) : 0) < 0) {
+        LOG_ERROR(LOG_PATH_SC, "[NET-SRV] Handshake with client %d failed", np.id);
+        conn_close(&np);
+        return;
+    }
+    if (!slot) {
+        // Only lost clients' slots are left, and this is not one of them
+        logMessage(LOG_PATH_SC, "[NET-SRV] Session full (%d clients), refusing %s", NET_MAX_PEERS, inet_ntoa(cli.sin_addr));
+        conn_close(&np);
+        return;
+    }
+
+    *slot = np;
+    peer_count++;
+    conn_ready(slot);
+    slot->state = SV_SEND_CMD_DRONE;
+    log_protocol(slot);
+    if (slot->streaming && NET_REJOIN_SEC > 0) send_msg(slot, "join %d %u", slot->id, session_id);
+}
+
+/* * Client: the link to the server dropped or went silent. The loop keeps serving
+ * the Blackboard and calls client_reconnect() on the retry schedule.
+ */
+static void client_lost(Peer *p, long long now) {
+    logMessage(LOG_PATH_SC, "[NET-CLI] Lost the server, reconnecting for up to %d s", NET_REJOIN_SEC);
+    peer_suspend(p, now);
+    retry_at_ms = now;
+    retry_until_ms = now + NET_REJOIN_SEC * 1000LL;
+    retry_delay_ms = NET_RETRY_MIN_MS;
+}
+
+/* * Client: one reconnect attempt. With a ticket ("join") it resumes its slot and
+ * applies the snapshot's frames (its window size is only checked); without one,
+ * or when the server refuses, it runs the full handshake as at startup. Returns
+ * 0 once the link is back, -1 with the next attempt scheduled (NET_RETRY_MIN_MS
+ * doubling up to NET_RETRY_MAX_MS).
+ */
+static int client_reconnect(Peer *p, int *w, int *h, int fd_bb_out) {
+    const char *line;
+    int fd = tcp_connect(server_addr, server_port);
+    if (fd < 0) goto retry;
+
+    p->fd = fd;
+    p->udp_fd = -1;
+    if (netbuf_init(&p->buf) < 0 || netout_init(&p->out) < 0) {
+        netbuf_free(&p->buf);
+        close(fd);
+        p->fd = -1;
+        goto retry;
+    }
+    peer_count++;
+    struct timeval tv = { NET_HANDSHAKE_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (session_id) {
+        if (!(line = read_line_blocking(p)) || strcmp(line, "ok") != 0) goto lost;
+        send_msg(p, "rejoin %d %u %u", my_id, session_id, p->st.rx_seq);
+
+        unsigned int seq, peer_rx;
+        long long t_ms;
+        int sw, sh;
+        float x, y, vel[2];
+        if (!(line = read_line_blocking(p))) goto lost;
+        if (sscanf(line, "snap %d %d %u %u %lld %f %f %f %f", &sw, &sh, &seq, &peer_rx, &t_ms,
+                   &x, &y, &vel[0], &vel[1]) != 9) {
+            logMessage(LOG_PATH_SC, "[NET-CLI] Rejoin refused ('%s'), joining again", line);
+            session_id = 0;
+            my_id = 0;
+            retry_delay_ms = NET_RETRY_MIN_MS; // The server is up: rejoin at once
+            goto lost;
+        }
+        // The Blackboard sizes its window once, at startup: a different size is only reported
+        if (sw != *w || sh != *h) {
+            logMessage(LOG_PATH_SC, "[NET-CLI] Server window is now %dx%d, this session keeps %dx%d",
+                       sw, sh, *w, *h);
+        }
+        stream_frame(p, seq, t_ms, x, y, vel, mono_ms());
+        logMessage(LOG_PATH_SC, "[NET-CLI] Resumed as client %d, the server missed %u of our frames",
+                   my_id, p->st.tx_seq - peer_rx);
+    } else {
+        if (protocol_handshake(MODE_CLIENT, p, w, h, fd_bb_out) < 0) goto lost;
+        p->streaming = NET_STREAM ? stream_negotiate(MODE_CLIENT, p) : 0;
+        if (p->streaming < 0) goto lost;
+        p->state = CL_WAIT_COMMAND;
+        logMessage(LOG_PATH_SC, "[NET-CLI] Reconnected with a new handshake");
+    }
+    p->suspended = 0;
+    conn_ready(p);
+    log_protocol(p);
+    return 0;
+
+lost:
+    peer_close(p);
+retry:
+    retry_at_ms = mono_ms() + retry_delay_ms;
+    logMessage(LOG_PATH_SC, "[NET-CLI] Reconnect failed, retry in %d ms", retry_delay_ms);
+    retry_delay_ms = next_delay(retry_delay_ms);
+    return -1;
+}
+
+void network_loop(int mode, int listen_fd, int fd_bb_in, int fd_bb_out, int w, int h) {
     set_nonblocking(fd_bb_in);
+    if (listen_fd >= 0) set_nonblocking(listen_fd);
+
+    long long now = mono_ms();
+    long long next_send = now;
+    long long next_report = now + STREAM_REPORT_SEC * 1000;
 
     while (1) {
         // --- 1. Prepare Select ---
+        fd_set read_fds, write_fds;
         FD_ZERO(&read_fds);
-        FD_SET(net_fd, &read_fds);
+        FD_ZERO(&write_fds);
         FD_SET(fd_bb_in, &read_fds);
-        
-        int max_fd = (net_fd > fd_bb_in) ? net_fd : fd_bb_in;
-        int has_buf = (strchr(sock_buf.data, '\n') != NULL);
-        
-        // If we already have a full line in buffer, immediate timeout (0), else wait briefly
-        timeout.tv_sec = 0;
-        timeout.tv_usec = has_buf ? 0 : 2000; 
-
-        if (select(max_fd + 1, &read_fds, NULL, NULL, &timeout) < 0 && errno != EINTR) {
-             logMessage(LOG_PATH_SC, "[NET-ERR] Select failed: %s", strerror(errno));
+        int max_fd = fd_bb_in;
+        if (listen_fd >= 0) {
+            FD_SET(listen_fd, &read_fds);
+            if (listen_fd > max_fd) max_fd = listen_fd;
+        }
+        int has_buf = 0;
+        for (int i = 0; i < NET_MAX_PEERS; i++) {
+            Peer *p = &peers[i];
+            if (p->fd < 0) continue;
+            if (netbuf_space(&p->buf) > 0) { // Full of unparsed lines: leave it in the kernel
+                FD_SET(p->fd, &read_fds);
+                if (p->fd > max_fd) max_fd = p->fd;
+            }
+            if (p->udp_fd >= 0) {
+                FD_SET(p->udp_fd, &read_fds);
+                if (p->udp_fd > max_fd) max_fd = p->udp_fd;
+            }
+            if (netout_pending(&p->out) > 0) { // Rest of a partial write
+                FD_SET(p->fd, &write_fds);
+                if (p->fd > max_fd) max_fd = p->fd;
+            }
+            if (netbuf_has_line(&p->buf)) has_buf = 1;
+        }
+
+        // A full line already buffered: do not wait. Otherwise wake up for the next frame
+        long long wait_ms = has_buf ? 0 : next_send - now;
+        if (wait_ms < 0) wait_ms = 0;
+        struct timeval timeout = { 0, (suseconds_t)(wait_ms * 1000) };
+
+        metrics_loop();
+        metrics_state(MET_IDLE);
+        if (select(max_fd + 1, &read_fds, &write_fds, NULL, &timeout) < 0 && errno != EINTR) {
+             LOG_ERROR(LOG_PATH_SC, "[NET-ERR] Select failed: %s", strerror(errno));
              break;
         }
+        metrics_state(MET_INPUT);
+        now = mono_ms();
 
-        // --- 2. Handle Inputs ---
-        
-        // Read local position from Blackboard
-        if (FD_ISSET(fd_bb_in, &read_fds)) update_local_position(fd_bb_in);
+        // --- 2. Blackboard: local position, or the quit for everyone ---
+        if (FD_ISSET(fd_bb_in, &read_fds) && update_local_position(fd_bb_in)) {
+            for (int i = 0; i < NET_MAX_PEERS; i++) {
+                if (peers[i].fd >= 0) send_msg(&peers[i], "q");
+            }
+            logMessage(LOG_PATH_SC, "[NET] Local quit sent to %d peer(s)", peer_count);
+            goto exit_loop;
+        }
+
+        if (listen_fd >= 0 && FD_ISSET(listen_fd, &read_fds)) accept_peer(listen_fd, w, h);
+
+        // --- 3. Every connection, with the protocol it negotiated ---
+        int tick = (now >= next_send);
+        for (int i = 0; i < NET_MAX_PEERS; i++) {
+            Peer *p = &peers[i];
+            if (p->fd < 0) {
+                // Server: a lost client that did not come back in time
+                if (p->suspended && now >= p->rejoin_by_ms) {
+                    logMessage(LOG_PATH_SC, "[NET-SRV] Client %d did not rejoin within %d s", p->id, NET_REJOIN_SEC);
+                    peer_left(p, fd_bb_out);
+                }
+                continue;
+            }
+
+            int lost = (FD_ISSET(p->fd, &read_fds) && read_socket_chunk(p) == -1);
+            if (NET_REJOIN_SEC > 0 && p->streaming && now - p->heard_ms > NET_SILENCE_MS) {
+                logMessage(LOG_PATH_SC, "[NET] Peer %d silent for %lld ms", p->id, now - p->heard_ms);
+                lost = 1;
+            }
+            // A "q" may be buffered ahead of the close: then it is a clean end, not a loss
+            int ended = 0;
+            if (p->streaming) {
+                int udp_ready = (p->udp_fd >= 0 && FD_ISSET(p->udp_fd, &read_fds));
+                ended = stream_receive(p, udp_ready, now, fd_bb_out);
+            } else if (!lost) {
+                ended = (lockstep_step(p, mode, tick, fd_bb_out) < 0);
+            }
+            // Dropped: the client reconnects, the server keeps a streaming client's slot
+            if (lost && !ended && NET_REJOIN_SEC > 0 && (mode == MODE_CLIENT || p->streaming)) {
+                if (mode == MODE_CLIENT) {
+                    client_lost(p, now);
+                } else {
+                    logMessage(LOG_PATH_SC, "[NET-SRV] Lost client %d, keeping its slot for %d s", p->id, NET_REJOIN_SEC);
+                    peer_suspend(p, now);
+                }
+            } else if (ended || lost) {
+                if (mode == MODE_CLIENT) {
+                    logMessage(LOG_PATH_SC, "[NET] Session ended by the server.");
+                    goto exit_loop;
+                }
+                peer_left(p, fd_bb_out);
+            }
+        }
 
-        // Read raw data from Network into buffer
-        if (FD_ISSET(net_fd, &read_fds)) {
-            if (read_socket_chunk(net_fd) == -1) {
-                logMessage(LOG_PATH_SC, "[NET] Socket closed.");
+        // --- 3b. Client: the server link is down, try again when the next attempt is due ---
+        if (mode == MODE_CLIENT && peers[0].fd < 0 && now >= retry_at_ms) {
+            if (client_reconnect(&peers[0], &w, &h, fd_bb_out) < 0 && mono_ms() >= retry_until_ms) {
+                logMessage(LOG_PATH_SC, "[NET-CLI] Server unreachable for %d s, giving up", NET_REJOIN_SEC);
                 goto exit_loop;
             }
+            now = mono_ms();
         }
 
-        // --- 3. Process State Machine ---
-        int state_changed;
-        do {
-            state_changed = 0;
-            if (mode == MODE_SERVER) {
-                switch (net_state) {
-                    case SV_SEND_CMD_DRONE:
-                        logMessage(LOG_PATH_SC, "[SV] >> Sending 'drone'");
-                        send_msg(net_fd, "drone");
-                        net_state = SV_SEND_DATA_DRONE;
-                        state_changed = 1; 
-                        break;
-                    case SV_SEND_DATA_DRONE:
-                        // Convert Local to Virtual coords for transmission
-                        local_to_virt(my_last_x, my_last_y, &vx, &vy);
-                        send_msg(net_fd, "%f %f", vx, vy);
-                        net_state = SV_WAIT_DOK;
-                        break;
-                    case SV_WAIT_DOK:
-                        if (get_line_from_buffer(net_line, sizeof(net_line))) {
-                            if (sscanf(net_line, "dok %f %f", &rx, &ry) == 2) {
-                                logMessage(LOG_PATH_SC, "[SV] << ACK 'dok'");
-                                net_state = SV_SEND_CMD_OBST;
-                                state_changed = 1;
-                            } else if (strcmp(net_line, "q") == 0) goto exit_loop;
-                        }
-                        break;
-                    case SV_SEND_CMD_OBST:
-                        send_msg(net_fd, "obst");
-                        net_state = SV_WAIT_DATA_OBST;
-                        break;
-                    case SV_WAIT_DATA_OBST:
-                        if (get_line_from_buffer(net_line, sizeof(net_line))) {
-                            if (sscanf(net_line, "%f %f", &rx, &ry) == 2) {
-                                logMessage(LOG_PATH_SC, "[SV] << Obst Data");
-                                msg.type = MSG_TYPE_DRONE;
-                                // Convert Remote Virtual -> Local for display
-                                virt_to_local(rx, ry, &remote_x, &remote_y);
-                                
-                                // Forward to Blackboard
-                                snprintf(msg.data, sizeof(msg.data), "%f %f", remote_x, remote_y);
-                                write(fd_bb_out, &msg, sizeof(msg));
-                                
-                                send_msg(net_fd, "pok %f %f", rx, ry);
-                                net_state = SV_SEND_CMD_DRONE;
-                                state_changed = 1; 
-                            }
-                        }
-                        break;
-                    default: break; 
-                }
-            } else { // CLIENT LOGIC
-                switch (net_state) {
-                    case CL_WAIT_COMMAND:
-                        if (get_line_from_buffer(net_line, sizeof(net_line))) {
-                            if (strcmp(net_line, "drone") == 0) {
-                                net_state = CL_WAIT_DRONE_DATA;
-                                state_changed = 1;
-                            } else if (strcmp(net_line, "obst") == 0) {
-                                net_state = CL_SEND_OBST_DATA;
-                                state_changed = 1;
-                            } else if (strcmp(net_line, "q") == 0) {
-                                send_msg(net_fd, "qok");
-                                goto exit_loop;
-                            }
-                        }
-                        break;
-                    case CL_WAIT_DRONE_DATA:
-                        if (get_line_from_buffer(net_line, sizeof(net_line))) {
-                            if (sscanf(net_line, "%f %f", &rx, &ry) == 2) {
-                                msg.type = MSG_TYPE_DRONE;
-                                // Convert Remote Virtual -> Local for display
-                                virt_to_local(rx, ry, &remote_x, &remote_y);
-                                
-                                // Forward to Blackboard
-                                snprintf(msg.data, sizeof(msg.data), "%f %f", remote_x, remote_y);
-                                write(fd_bb_out, &msg, sizeof(msg));
-                                
-                                send_msg(net_fd, "dok %f %f", rx, ry);
-                                net_state = CL_WAIT_COMMAND;
-                            }
-                        }
-                        break;
-                    case CL_SEND_OBST_DATA:
-                        // Convert Local -> Virtual for transmission
-                        local_to_virt(my_last_x, my_last_y, &vx, &vy);
-                        send_msg(net_fd, "%f %f", vx, vy);
-                        net_state = CL_WAIT_POK;
-                        break;
-                    case CL_WAIT_POK:
-                        if (get_line_from_buffer(net_line, sizeof(net_line))) {
-                            if (sscanf(net_line, "pok %f %f", &rx, &ry) == 2) {
-                                net_state = CL_WAIT_COMMAND;
-                                state_changed = 1; 
-                            }
-                        }
-                        break;
-                    default: break; 
+        // --- 4. Newest frames: to the Blackboard, and relayed to the other clients ---
+        for (int i = 0; i < NET_MAX_PEERS; i++) {
+            Peer *p = &peers[i];
+            if (p->fd < 0 || !p->have_new) continue;
+            p->have_new = 0;
+            send_remote_drone(fd_bb_out, p->id, p->rx_x, p->rx_y, p->rx_has_vel ? p->rx_vel : NULL);
+            if (mode != MODE_SERVER) continue;
+            for (int k = 0; k < NET_MAX_PEERS; k++) {
+                Peer *q = &peers[k];
+                if (k == i || q->fd < 0 || !q->streaming) continue;
+                if (p->rx_has_vel) {
+                    stream_send(q, "r %d %u %lld %f %f %f %f", p->id, p->st.rx_seq, p->st.rx_t_ms,
+                                p->rx_x, p->rx_y, p->rx_vel[0], p->rx_vel[1]);
+                } else {
+                    stream_send(q, "r %d %u %lld %f %f", p->id, p->st.rx_seq, p->st.rx_t_ms, p->rx_x, p->rx_y);
                 }
             }
-        } while (state_changed);
+        }
+        for (int id = 1; id <= NET_MAX_PEERS; id++) {
+            if (!relayed[id].have_new) continue;
+            relayed[id].have_new = 0;
+            send_remote_drone(fd_bb_out, id, relayed[id].x, relayed[id].y,
+                              relayed[id].has_vel ? relayed[id].vel : NULL);
+        }
+
+        // --- 5. Our frame to every streaming peer, at a fixed rate ---
+        if (now >= next_send) {
+            float vx, vy, vel[2];
+            local_to_virt(my_last_x, my_last_y, &vx, &vy);
+            local_to_virt(my_vel_x, my_vel_y, &vel[0], &vel[1]);
+            for (int i = 0; i < NET_MAX_PEERS; i++) {
+                Peer *p = &peers[i];
+                if (p->fd < 0 || !p->streaming) continue;
+                stream_send(p, "f %u %lld %f %f %f %f", ++p->st.tx_seq, now, vx, vy, vel[0], vel[1]);
+                p->st.sent++;
+            }
+            next_send += STREAM_PERIOD_MS;
+            if (next_send <= now) next_send = now + STREAM_PERIOD_MS; // Stalled: do not burst
+        }
+
+        for (int i = 0; i < NET_MAX_PEERS; i++) {
+            if (peers[i].fd >= 0 && peers[i].streaming) stream_ack(&peers[i], now);
+        }
+
+        if (now >= next_report) {
+            for (int i = 0; i < NET_MAX_PEERS; i++) {
+                if (peers[i].fd >= 0 && peers[i].streaming) stream_report(&peers[i]);
+            }
+            next_report += STREAM_REPORT_SEC * 1000;
+        }
+
+        // --- 6. One send per connection for everything this pass queued ---
+        for (int i = 0; i < NET_MAX_PEERS; i++) {
+            if (peers[i].fd >= 0) peer_flush(&peers[i]);
+        }
     }
 
 exit_loop:
-    if (net_fd >= 0) close(net_fd);
+    for (int i = 0; i < NET_MAX_PEERS; i++) {
+        if (peers[i].fd >= 0) peer_close(&peers[i]);
+    }
+    if (listen_fd >= 0) close(listen_fd);
     logMessage(LOG_PATH_SC, "[NET] Loop finished.");
 }
 
 
 /* * ======================================================================================
- * MACRO-SECTION 6: MAIN ENTRY POINT
+ * MACRO-SECTION 8: MAIN ENTRY POINT
  * ======================================================================================
  * Arguments parsing, Signal setup, and Initialization.
  */
@@ -513,6 +1359,7 @@ exit_loop:
 int main(int argc, char *argv[]) {
     signal(SIGPIPE, SIG_IGN); // Prevent crash on broken pipe
     if (argc < 6) return 1;
+    config_from_env();
 
     // Parse Arguments
     int fd_bb_in = atoi(argv[1]);   
@@ -521,23 +1368,51 @@ int main(int argc, char *argv[]) {
     const char *addr = (argc > 4) ? argv[4] : "127.0.0.1";
     int port = atoi(argv[5]);
     int w = 100, h = 100;
+    int listen_fd = -1;
+
+    for (int i = 0; i < NET_MAX_PEERS; i++) peers[i].fd = peers[i].udp_fd = -1;
+
+    // Startup barrier: connect only once the whole local session has started
+    registry_ready(ROLE_NETWORK);
 
     // Initialize Connection
     if (mode == MODE_SERVER) {
-        // Server needs the Window Size from Blackboard to send to Client
+        // Server needs the Window Size from Blackboard to send to its Clients
         receive_window_size(fd_bb_in, &w, &h);
-        net_fd = init_server(port);
+        session_id = ((uint32_t)getpid() << 16) ^ (uint32_t)mono_ms();
+        if (!session_id) session_id = 1;
+        listen_fd = init_server(port);
+        if (listen_fd < 0) {
+            LOG_ERROR(LOG_PATH_SC, "[NET-FATAL] Init Failed.");
+            return 1;
+        }
     } else {
-        net_fd = init_client(addr, port);
-    }
+        Peer *p = &peers[0];
+        if (netbuf_init(&p->buf) < 0 || netout_init(&p->out) < 0) return 1;
+        p->fd = init_client(addr, port);
+        p->id = 0;
+        peer_count = 1;
 
-    // Perform Handshake
-    if (net_fd < 0 || protocol_handshake(mode, net_fd, &w, &h, fd_bb_out) < 0) {
-        logMessage(LOG_PATH_SC, "[NET-FATAL] Init Failed.");
-        return 1;
+        // Perform Handshake
+        if (p->fd < 0 || protocol_handshake(mode, p, &w, &h, fd_bb_out) < 0) {
+            LOG_ERROR(LOG_PATH_SC, "[NET-FATAL] Init Failed.");
+            return 1;
+        }
+        p->streaming = NET_STREAM ? stream_negotiate(mode, p) : 0;
+        if (p->streaming < 0) {
+            LOG_ERROR(LOG_PATH_SC, "[NET-FATAL] Connection lost during stream negotiation.");
+            return 1;
+        }
+        conn_ready(p);
+        p->state = CL_WAIT_COMMAND;
+        log_protocol(p);
     }
 
     // Start Main Loop
-    network_loop(mode, fd_bb_in, fd_bb_out);
+    metrics_join("NETWORK");
+    metrics_pipe(fd_bb_in, "bb.in");
+    metrics_pipe(fd_bb_out, "bb.out");
+    network_loop(mode, listen_fd, fd_bb_in, fd_bb_out, w, h);
+    metrics_leave();
     return 0;
-}
\ No newline at end of file
+}
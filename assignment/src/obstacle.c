@@ -12,49 +12,49 @@
 #include <signal.h>
 #include <sys/select.h>
 #include <sys/stat.h>
-#include <sys/file.h>
 
 #include "app_common.h"
 #include "log.h"
 #include "process_pid.h"
+#include "msg_codec.h"
+#include "entities.h"
+#include "sim_core.h"
+#include "heartbeat.h"
+#include "metrics.h"
 
-typedef enum { STATE_INIT, STATE_WAITING, STATE_GENERATING } ProcessState;
+typedef enum { STATE_INIT, STATE_WAITING, STATE_READING, STATE_GENERATING } ProcessState;
 static volatile sig_atomic_t current_state = STATE_INIT;
+
+/* What each state counts as in the metrics segment (exec/stats) */
+static const MetState met_state_of[] = {
+    [STATE_INIT] = MET_IDLE, [STATE_WAITING] = MET_IDLE,
+    [STATE_READING] = MET_INPUT, [STATE_GENERATING] = MET_UPDATE
+};
+
+static void set_state(ProcessState state) {
+    current_state = state;
+    metrics_state(met_state_of[state]);
+}
 static volatile pid_t watchdog_pid = -1;
 
+// Targets as the Blackboard distributes them, patched in place by its deltas
+static Point *targets = NULL;
+static int num_targets = 0, targets_cap = 0;
+static uint32_t targets_version = 0;
+static Point *generated = NULL;        // Last generated array, reused by every round
+static int generated_cap = 0;
+
 /* ======================================================================================
  * SECTION 2: WATCHDOG & HELPERS
  * ====================================================================================== */
-void publish_my_pid(FILE *fp) {
-    fprintf(fp, "%s %d\n", OBSTACLE_PID_TAG, getpid());
-    logMessage(LOG_PATH, "[OBST] PID published securely");
+void publish_my_pid(void) {
+    if (registry_publish(ROLE_OBSTACLE) == 0) logMessage(LOG_PATH, "[OBST] PID published");
 }
 
 void wait_for_watchdog_pid() {
-    FILE *fp;
-    char line[256], tag[128];
-    int pid_temp;
-    bool wd_found = false;
-
     logMessage(LOG_PATH, "[OBST] Waiting for Watchdog...");
-
-    while (!wd_found) {
-        fp = fopen(PID_FILE_PATH, "r");
-        if (fp) {
-            while (fgets(line, sizeof(line), fp)) {
-                if (sscanf(line, "%s %d", tag, &pid_temp) == 2) {
-                    if (strcmp(tag, WD_PID_TAG) == 0) {
-                        watchdog_pid = (pid_t)pid_temp;
-                        wd_found = true;
-                        break;
-                    }
-                }
-            }
-            fclose(fp);
-        }
-        if (!wd_found) usleep(200000);
-    }
-    logMessage(LOG_PATH, "[OBST] Watchdog found (PID %d)", watchdog_pid);
+    watchdog_pid = registry_wait(ROLE_WATCHDOG, -1);
+    if (watchdog_pid > 0) logMessage(LOG_PATH, "[OBST] Watchdog found (PID %d)", watchdog_pid);
 }
 
 void watchdog_ping_handler(int sig) {
@@ -64,38 +64,18 @@ void watchdog_ping_handler(int sig) {
 
 /* ======================================================================================
  * SECTION 3: GENERATION LOGIC
- * Creates random obstacles avoiding overlap.
+ * Creates random obstacles on distinct free cells (occupancy bitmap).
  * ====================================================================================== */
-Point* generate_obstacles(int width, int height, int* num_out) {
-    int total_cells = (width - 2) * (height - 2);
-    int count = (int) round(PERC_OBST * total_cells);
-    if (count < 1) count = 1;
-
-    Point* arr = malloc(sizeof(Point) * count);
-    if (!arr) {
+// Refills *arr (capacity *cap, kept across rounds) and returns the obstacle count
+int generate_obstacles(int width, int height, Point **arr, int *cap) {
+    srand(time(NULL)); 
+    int count = sim_generate(arr, cap, width, height, PERC_OBST, NULL, 0);
+    if (count < 0) {
         logMessage(LOG_PATH, "[OBST] ERROR malloc: %s", strerror(errno));
         exit(1);
     }
-
-    srand(time(NULL)); 
-    for (int i = 0; i < count; i++) {
-        int valid;
-        do {
-            valid = 1;
-            arr[i].x = rand() % (width - 2) + 1;
-            arr[i].y = rand() % (height - 2) + 1;
-            // Check self-overlap
-            for (int j = 0; j < i; j++) {
-                if (arr[i].x == arr[j].x && arr[i].y == arr[j].y) {
-                    valid = 0;
-                    break;
-                }
-            }
-        } while (!valid);
-    }
     logMessage(LOG_PATH, "[OBST] Generated %d obstacles", count);
-    *num_out = count;
-    return arr;
+    return count;
 }
 
 /* ======================================================================================
@@ -103,6 +83,7 @@ Point* generate_obstacles(int width, int height, int* num_out) {
  * ====================================================================================== */
 int main(int argc, char *argv[]) {
     if (argc < 3) return 1;
+    config_from_env();
 
     int fd_in  = atoi(argv[1]);
     int fd_out = atoi(argv[2]);
@@ -117,21 +98,18 @@ int main(int argc, char *argv[]) {
 
     wait_for_watchdog_pid();
 
-    FILE *fp_pid = fopen(PID_FILE_PATH, "a");
-    if (!fp_pid) {
-        logMessage(LOG_PATH, "[OBST] Error opening PID file!");
-        exit(1);
-    }
-    int fd_pid = fileno(fp_pid);
-    flock(fd_pid, LOCK_EX); 
-    publish_my_pid(fp_pid);
-    fflush(fp_pid);
-    flock(fd_pid, LOCK_UN);
-    fclose(fp_pid);
+    publish_my_pid();
+    hb_join("OBSTACLE", HB_DEADLINE_MS);
+    metrics_join("OBSTACLE");
+    metrics_pipe(fd_in, "bb.in");
+    metrics_pipe(fd_out, "bb.out");
+    registry_ready(ROLE_OBSTACLE);
 
     // --- MAIN LOOP ---
     while (1) {
-        current_state = STATE_WAITING;
+        metrics_loop();
+        set_state(STATE_WAITING);
+        hb_beat(); // At least every select() timeout
         fd_set set;
         FD_ZERO(&set);
         FD_SET(fd_in, &set);
@@ -148,29 +126,48 @@ int main(int argc, char *argv[]) {
         }
 
         if (FD_ISSET(fd_in, &set)) {
+            set_state(STATE_READING);
             Message msg;
-            ssize_t n = read(fd_in, &msg, sizeof(msg));
+            ssize_t n = metrics_read(fd_in, &msg, sizeof(msg));
 
             if (n <= 0) {
                 logMessage(LOG_PATH, "[OBST] Pipe closed, exiting.");
                 break;
             }
+            metrics_msg_in(msg.type);
 
             // On MSG_TYPE_SIZE, generate obstacles
             if (msg.type == MSG_TYPE_SIZE) {
-                current_state = STATE_GENERATING;
+                set_state(STATE_GENERATING);
                 int width, height;
-                if (sscanf(msg.data, "%d %d", &width, &height) == 2) {
-                    int num_obst = 0;
-                    Point* arr = generate_obstacles(width, height, &num_obst);
+                if (msg_decode_size(&msg, &width, &height) == 0) {
+                    int num_obst = generate_obstacles(width, height, &generated, &generated_cap);
                     
                     Message out_msg;
-                    out_msg.type = MSG_TYPE_OBSTACLES;
-                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_obst);
+                    msg_encode_entities(&out_msg, MSG_TYPE_OBSTACLES, num_obst, 0);
                     
-                    write(fd_out, &out_msg, sizeof(out_msg));
-                    write(fd_out, arr, sizeof(Point) * num_obst);
-                    free(arr);
+                    metrics_msg_out(MSG_TYPE_OBSTACLES);
+                    metrics_write(fd_out, &out_msg, sizeof(out_msg));
+                    metrics_write(fd_out, generated, sizeof(Point) * num_obst);
+                }
+            }
+            else if (msg.type == MSG_TYPE_TARGETS) {
+                int count;
+                uint32_t version;
+                if (msg_decode_entities(&msg, &count, &version) < 0) continue;
+                // The array follows the header: read it all so it is not parsed as messages
+                if (entities_read(metrics_read, fd_in, &targets, &targets_cap, count) < 0) {
+                    logMessage(LOG_PATH, "[OBST] ERROR: snapshot of %d targets lost", count);
+                    count = 0;
+                }
+                num_targets = count;
+                targets_version = version;
+            }
+            else if (msg.type == MSG_TYPE_ENTITY_DELTA) {
+                MsgEntityDelta d;
+                if (msg_decode_entity_delta(&msg, &d) == 0 && d.kind == MSG_TYPE_TARGETS &&
+                    entities_apply(&targets, &num_targets, &targets_cap, &targets_version, &d) < 0) {
+                    logMessage(LOG_PATH, "[OBST] Target delta (version %u) rejected", d.version);
                 }
             }
             else if(msg.type == MSG_TYPE_EXIT){
@@ -182,6 +179,10 @@ int main(int argc, char *argv[]) {
         }
     }
     quit:
+    hb_leave();
+    metrics_leave();
+    free(targets);
+    free(generated);
     close(fd_in);
     close(fd_out);
     return 0;
@@ -0,0 +1,146 @@
+#include "occupancy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ======================================================================================
+ * SECTION 1: STORAGE
+ * ====================================================================================== */
+int occ_init(Occupancy *o, int width, int height) {
+    memset(o, 0, sizeof(*o));
+    if (width < 1 || height < 1) return 0;
+    o->stride = (width + 63) / 64;
+    o->bits = calloc((size_t)o->stride * height, sizeof(uint64_t));
+    if (!o->bits) return -1;
+    o->width = width;
+    o->height = height;
+    return 0;
+}
+
+void occ_free(Occupancy *o) {
+    free(o->bits);
+    memset(o, 0, sizeof(*o));
+}
+
+void occ_reset(Occupancy *o) {
+    if (o->bits) memset(o->bits, 0, sizeof(uint64_t) * o->stride * o->height);
+}
+
+/* ======================================================================================
+ * SECTION 2: CELLS
+ * ====================================================================================== */
+static int inside(const Occupancy *o, int x, int y) {
+    return x >= 0 && y >= 0 && x < o->width && y < o->height;
+}
+
+int occ_test(const Occupancy *o, int x, int y) {
+    if (!inside(o, x, y)) return 0;
+    return (o->bits[y * o->stride + x / 64] >> (x % 64)) & 1;
+}
+
+void occ_set(Occupancy *o, int x, int y) {
+    if (inside(o, x, y)) o->bits[y * o->stride + x / 64] |= 1ull << (x % 64);
+}
+
+void occ_clear(Occupancy *o, int x, int y) {
+    if (inside(o, x, y)) o->bits[y * o->stride + x / 64] &= ~(1ull << (x % 64));
+}
+
+void occ_set_points(Occupancy *o, const Point *pts, int n) {
+    for (int i = 0; i < n; i++) occ_set(o, pts[i].x, pts[i].y);
+}
+
+/* ======================================================================================
+ * SECTION 3: SAMPLING
+ * ====================================================================================== */
+// Playing-field columns 1..width-2 that fall in word k of a row
+static uint64_t field_mask(const Occupancy *o, int k) {
+    int lo = k * 64, hi = lo + 63;
+    if (lo < 1) lo = 1;
+    if (hi > o->width - 2) hi = o->width - 2;
+    if (lo > hi) return 0;
+    uint64_t upto_hi = (hi % 64 == 63) ? ~0ull : (1ull << (hi % 64 + 1)) - 1;
+    return upto_hi & ~((1ull << (lo % 64)) - 1);
+}
+
+static uint64_t free_word(const Occupancy *o, int y, int k) {
+    return ~o->bits[y * o->stride + k] & field_mask(o, k);
+}
+
+int occ_free_cells(const Occupancy *o) {
+    int n = 0;
+    for (int y = 1; y < o->height - 1; y++) {
+        for (int k = 0; k < o->stride; k++) n += __builtin_popcountll(free_word(o, y, k));
+    }
+    return n;
+}
+
+// The rank-th free cell in row-major order (rank < occ_free_cells())
+static void nth_free(const Occupancy *o, int rank, Point *out) {
+    for (int y = 1; y < o->height - 1; y++) {
+        for (int k = 0; k < o->stride; k++) {
+            uint64_t w = free_word(o, y, k);
+            int c = __builtin_popcountll(w);
+            if (rank >= c) {
+                rank -= c;
+                continue;
+            }
+            while (rank--) w &= w - 1; // Drop the lower free cells
+            out->x = k * 64 + __builtin_ctzll(w);
+            out->y = y;
+            return;
+        }
+    }
+}
+
+int occ_pick_free(const Occupancy *o, Point *out) {
+    if (o->width < 3 || o->height < 3) return -1;
+    for (int i = 0; i < OCC_PROBES; i++) {
+        int x = rand() % (o->width - 2) + 1;
+        int y = rand() % (o->height - 2) + 1;
+        if (!occ_test(o, x, y)) {
+            out->x = x;
+            out->y = y;
+            return 0;
+        }
+    }
+    int free_n = occ_free_cells(o);
+    if (free_n == 0) return -1;
+    nth_free(o, rand() % free_n, out);
+    return 0;
+}
+
+int occ_place_random(Occupancy *o, Point *out, int n) {
+    int free_n = (o->width < 3 || o->height < 3) ? 0 : occ_free_cells(o);
+    if (n > free_n) n = free_n;
+
+    if (n <= free_n / 2) {
+        for (int i = 0; i < n; i++) {
+            occ_pick_free(o, &out[i]);
+            occ_set(o, out[i].x, out[i].y);
+        }
+        return n;
+    }
+
+    // Dense: draw n of the free cells without replacement
+    int *cells = malloc(sizeof(int) * free_n);
+    if (!cells) return -1;
+    int m = 0;
+    for (int y = 1; y < o->height - 1; y++) {
+        for (int k = 0; k < o->stride; k++) {
+            for (uint64_t w = free_word(o, y, k); w; w &= w - 1) {
+                cells[m++] = y * o->width + k * 64 + __builtin_ctzll(w);
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        int j = i + rand() % (free_n - i);
+        int c = cells[j];
+        cells[j] = cells[i];
+        out[i].x = c % o->width;
+        out[i].y = c / o->width;
+        occ_set(o, out[i].x, out[i].y);
+    }
+    free(cells);
+    return n;
+}
@@ -0,0 +1,48 @@
+// occupancy.h
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <stdint.h>
+
+#include "app_common.h"
+
+#define OCC_PROBES 32              // Random probes before an exact pick
+
+/* * One bit per cell of a width x height window, rows padded to whole 64-bit
+ * words. Entities are placed in the playing field, 1..width-2 x 1..height-2
+ * (the window border excluded); cells outside the window read as free and
+ * are never set.
+ */
+typedef struct {
+    uint64_t *bits;
+    int width, height;
+    int stride;                    // Words per row
+} Occupancy;
+
+// All cells free. Returns -1 on allocation failure.
+int  occ_init(Occupancy *o, int width, int height);
+void occ_free(Occupancy *o);
+void occ_reset(Occupancy *o);
+
+int  occ_test(const Occupancy *o, int x, int y);
+void occ_set(Occupancy *o, int x, int y);
+void occ_clear(Occupancy *o, int x, int y);
+void occ_set_points(Occupancy *o, const Point *pts, int n);
+
+// Free cells of the playing field
+int  occ_free_cells(const Occupancy *o);
+
+/* * Uniformly random free cell of the playing field (not marked). A few random
+ * probes first; past that, the free cells are counted and one is drawn by rank,
+ * so a crowded field still terminates. Returns -1 when the field is full.
+ */
+int  occ_pick_free(const Occupancy *o, Point *out);
+
+/* * Places up to n entities on distinct free cells and marks them: one
+ * occ_pick_free() each while they fill at most half of the free space, else a
+ * partial Fisher-Yates shuffle of the free-cell list. Returns the number
+ * placed, less than n only when the field is full (-1 on allocation failure).
+ */
+int  occ_place_random(Occupancy *o, Point *out, int n);
+
+#endif
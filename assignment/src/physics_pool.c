@@ -0,0 +1,115 @@
+#include "physics_pool.h"
+#include "app_common.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ======================================================================================
+ * SECTION 1: WORKERS
+ * ====================================================================================== */
+static void *worker_main(void *arg) {
+    PhysicsWorker *w = arg;
+    PhysicsPool *p = w->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (1) {
+        while (p->generation == seen) pthread_cond_wait(&p->start, &p->lock);
+        seen = p->generation;
+        if (p->stop) break;
+
+        int count = p->swarm->count;
+        int lo = (int)((long)count * w->index / p->count);
+        int hi = (int)((long)count * (w->index + 1) / p->count);
+        pthread_mutex_unlock(&p->lock);
+
+        // The job fields only change between generations, read here without the lock
+        MsgForce *out = (lo == 0 && hi > 0) ? p->out : NULL;
+        for (int s = 0; s < p->steps; s++) {
+            sim_swarm_step_range(p->field, &w->scratch, p->obstacles, p->swarm, lo, hi,
+                                 p->width, p->height, out);
+        }
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0) pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/* ======================================================================================
+ * SECTION 2: POOL LIFETIME
+ * ====================================================================================== */
+static void stop_workers(PhysicsPool *p, int started) {
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+        sim_scratch_free(&p->workers[i].scratch);
+    }
+}
+
+int physics_pool_init(PhysicsPool *p, int threads) {
+    memset(p, 0, sizeof(*p));
+    p->workers = calloc(threads, sizeof(PhysicsWorker));
+    if (!p->workers) return -1;
+    p->count = threads;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        PhysicsWorker *w = &p->workers[i];
+        w->pool = p;
+        w->index = i;
+        sim_scratch_init(&w->scratch);
+        int err = pthread_create(&w->thread, NULL, worker_main, w);
+        if (err) {
+            logMessage(LOG_PATH, "[POOL] ERROR pthread_create: %s", strerror(err));
+            stop_workers(p, i);
+            physics_pool_free(p);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void physics_pool_free(PhysicsPool *p) {
+    if (!p->workers) return;
+    if (!p->stop) stop_workers(p, p->count);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    pthread_mutex_destroy(&p->lock);
+    free(p->workers);
+    p->workers = NULL;
+}
+
+/* ======================================================================================
+ * SECTION 3: JOBS
+ * ====================================================================================== */
+void physics_pool_start(PhysicsPool *p, const SimField *field, const Point *obstacles, DroneSwarm *swarm,
+                        int width, int height, int steps, MsgForce *out) {
+    pthread_mutex_lock(&p->lock);
+    p->field = field;
+    p->obstacles = obstacles;
+    p->swarm = swarm;
+    p->width = width;
+    p->height = height;
+    p->steps = steps;
+    p->out = out;
+    p->busy = p->count;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void physics_pool_wait(PhysicsPool *p) {
+    pthread_mutex_lock(&p->lock);
+    while (p->busy > 0) pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
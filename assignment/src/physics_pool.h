@@ -0,0 +1,56 @@
+// physics_pool.h
+#ifndef PHYSICS_POOL_H
+#define PHYSICS_POOL_H
+
+#include <pthread.h>
+#include "sim_core.h"
+
+/* Build option: make PHYSICS_THREADS=N steps the Drone's swarm on N worker
+ * threads while the main thread keeps draining the Blackboard pipe. */
+#ifndef PHYSICS_THREADS
+#define PHYSICS_THREADS 1
+#endif
+
+struct PhysicsPool;
+
+typedef struct {
+    struct PhysicsPool *pool;
+    int index;
+    pthread_t thread;
+    SimScratch scratch;                  // Grid hits of this worker's queries
+} PhysicsWorker;
+
+/* * Worker i owns drones [count*i/N, count*(i+1)/N) of the swarm. The drones do
+ * not act on each other, so a worker runs all the steps of a job on its own
+ * range without waiting for the others; a job is one generation, see below.
+ */
+typedef struct PhysicsPool {
+    PhysicsWorker *workers;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    unsigned long generation;            // Bumped by every job (and by the stop request)
+    int busy;                            // Workers still on the current job
+    int stop;
+
+    // The current job, read-only for the workers except for their swarm range and out
+    const SimField *field;
+    const Point *obstacles;
+    DroneSwarm *swarm;
+    int width, height, steps;
+    MsgForce *out;                       // Written by the worker that owns drone 0
+} PhysicsPool;
+
+// Starts threads workers. Returns -1 (and starts none) when a thread cannot be created.
+int  physics_pool_init(PhysicsPool *p, int threads);
+void physics_pool_free(PhysicsPool *p);
+
+/* * Hands steps physics steps of swarm out and returns at once. Until
+ * physics_pool_wait() returns, field and obstacles must not change and the
+ * caller must not touch swarm or out.
+ */
+void physics_pool_start(PhysicsPool *p, const SimField *field, const Point *obstacles, DroneSwarm *swarm,
+                        int width, int height, int steps, MsgForce *out);
+void physics_pool_wait(PhysicsPool *p);
+
+#endif
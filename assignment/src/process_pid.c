@@ -0,0 +1,188 @@
+#include "process_pid.h"
+#include "app_common.h"
+#include "log.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+static PidRegistry *reg = NULL;          // This process's mapping, attached on first use
+static int attach_failed = 0;
+
+static const char *const role_names[ROLE_COUNT] = {
+    "WATCHDOG", "BLACKBOARD", "DRONE", "OBSTACLE", "TARGET", "INPUT", "NETWORK"
+};
+
+static int futex_wait(void *word, uint32_t val, const struct timespec *rel) {
+    return (int)syscall(SYS_futex, word, FUTEX_WAIT, val, rel, NULL, 0);
+}
+
+static void futex_wake_all(void *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Absolute CLOCK_MONOTONIC deadline timeout_ms from now
+static struct timespec deadline_after(int timeout_ms) {
+    struct timespec d;
+    clock_gettime(CLOCK_MONOTONIC, &d);
+    d.tv_sec += timeout_ms / 1000;
+    d.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (d.tv_nsec >= 1000000000L) { d.tv_nsec -= 1000000000L; d.tv_sec++; }
+    return d;
+}
+
+// Relative time left until deadline into *left; 0 once it has passed
+static int time_left(const struct timespec *deadline, struct timespec *left) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left->tv_sec = deadline->tv_sec - now.tv_sec;
+    left->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (left->tv_nsec < 0) { left->tv_nsec += 1000000000L; left->tv_sec--; }
+    return left->tv_sec >= 0;
+}
+
+/* ======================================================================================
+ * SECTION 1: SEGMENT LIFETIME
+ * ====================================================================================== */
+int registry_create(uint32_t expected) {
+    int fd = shm_open(REGISTRY_NAME, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        logMessage(LOG_PATH, "[REG] ERROR shm_open: %s", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(PidRegistry)) < 0) {
+        logMessage(LOG_PATH, "[REG] ERROR ftruncate: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    PidRegistry *r = mmap(NULL, sizeof(PidRegistry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r == MAP_FAILED) {
+        logMessage(LOG_PATH, "[REG] ERROR mmap: %s", strerror(errno));
+        return -1;
+    }
+
+    // ftruncate zero-fills the segment: every slot starts empty
+    r->expected = expected;
+    r->magic = REGISTRY_MAGIC;
+    munmap(r, sizeof(PidRegistry));
+    return 0;
+}
+
+void registry_unlink(void) {
+    shm_unlink(REGISTRY_NAME);
+}
+
+static PidRegistry *attach(void) {
+    if (reg || attach_failed) return reg;
+    int fd = shm_open(REGISTRY_NAME, O_RDWR, 0600);
+    if (fd >= 0) {
+        PidRegistry *r = mmap(NULL, sizeof(PidRegistry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (r != MAP_FAILED && r->magic == REGISTRY_MAGIC) reg = r;
+        else if (r != MAP_FAILED) munmap(r, sizeof(PidRegistry));
+    }
+    if (!reg) {
+        attach_failed = 1;
+        logMessage(LOG_PATH, "[REG] No PID registry (PID %d runs unregistered)", getpid());
+    }
+    return reg;
+}
+
+/* ======================================================================================
+ * SECTION 2: SLOTS
+ * The slots are the futex words: waiters sleep while theirs reads 0, the
+ * publisher stores its PID and wakes them all. The segment is MAP_SHARED, so
+ * these are the process-shared futex operations (no FUTEX_PRIVATE_FLAG).
+ * ====================================================================================== */
+int registry_publish(ProcessRole role) {
+    PidRegistry *r = attach();
+    if (!r) return -1;
+    atomic_store_explicit(&r->pid[role], (int32_t)getpid(), memory_order_release);
+    futex_wake_all(&r->pid[role]);
+    return 0;
+}
+
+pid_t registry_wait(ProcessRole role, int timeout_ms) {
+    PidRegistry *r = attach();
+    if (!r) return -1;
+
+    struct timespec deadline = deadline_after(timeout_ms > 0 ? timeout_ms : 0);
+
+    int32_t pid;
+    while ((pid = atomic_load_explicit(&r->pid[role], memory_order_acquire)) == 0) {
+        struct timespec left, *wait_for = NULL;
+        if (timeout_ms >= 0) {
+            if (!time_left(&deadline, &left)) return -1;
+            wait_for = &left;
+        }
+        // Returns at once (EAGAIN) if the slot was filled in the meantime; EINTR: a signal
+        futex_wait(&r->pid[role], 0, wait_for);
+    }
+    return (pid_t)pid;
+}
+
+pid_t registry_get(ProcessRole role) {
+    PidRegistry *r = attach();
+    return r ? (pid_t)atomic_load_explicit(&r->pid[role], memory_order_acquire) : 0;
+}
+
+uint32_t registry_expected(void) {
+    PidRegistry *r = attach();
+    return r ? r->expected : 0;
+}
+
+const char *registry_role_name(ProcessRole role) {
+    return (role >= 0 && role < ROLE_COUNT) ? role_names[role] : "UNKNOWN";
+}
+
+/* ======================================================================================
+ * SECTION 3: STARTUP BARRIER
+ * ready is a bitmask main sleeps on until it covers expected; go is the word
+ * every process sleeps on until main flips it. Both only ever grow, so a late
+ * process passes straight through and a lost wake-up cannot happen.
+ * ====================================================================================== */
+void registry_ready(ProcessRole role) {
+    PidRegistry *r = attach();
+    if (!r) return;
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    atomic_store_explicit(&r->ready_ns[role], (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec,
+                          memory_order_relaxed);
+    atomic_fetch_or_explicit(&r->ready, ROLE_BIT(role), memory_order_release);
+    futex_wake_all(&r->ready);
+
+    while (atomic_load_explicit(&r->go, memory_order_acquire) == 0) {
+        futex_wait(&r->go, 0, NULL);
+    }
+}
+
+uint32_t registry_barrier(int timeout_ms) {
+    PidRegistry *r = attach();
+    if (!r) return 0;
+
+    struct timespec deadline = deadline_after(timeout_ms), left;
+    uint32_t ready;
+    while (((ready = atomic_load_explicit(&r->ready, memory_order_acquire)) & r->expected) != r->expected) {
+        if (!time_left(&deadline, &left)) break;
+        futex_wait(&r->ready, ready, &left);
+    }
+
+    atomic_store_explicit(&r->go, 1, memory_order_release);
+    futex_wake_all(&r->go);
+    return atomic_load_explicit(&r->ready, memory_order_acquire);
+}
+
+int64_t registry_ready_ns(ProcessRole role) {
+    PidRegistry *r = attach();
+    return r ? atomic_load_explicit(&r->ready_ns[role], memory_order_relaxed) : 0;
+}
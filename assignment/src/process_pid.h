@@ -1,14 +1,67 @@
 #ifndef PROCESS_PID_H
 #define PROCESS_PID_H
 
-// Qui diciamo al programma di cercare/creare questo file di testo
-#define PID_FILE_PATH "./pid_registry.txt"
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
 
-#define WD_PID_TAG    "WATCHDOG_PID"
-#define DRONE_PID_TAG "DRONE_PID"
-#define TARGET_PID_TAG "TARGET_PID"
-#define OBSTACLE_PID_TAG "OBSTACLE_PID"
-#define BB_PID_TAG "BB_PID"
-#define INPUT_PID_TAG "INPUT_PID"
+/* * PID registry: a shared-memory table with one slot per role, created by main
+ * before it forks. A process publishes its PID with one atomic store and wakes
+ * whoever waits on that slot (futex on the slot itself), so nobody polls.
+ * The same segment holds the startup barrier: every process main spawned reports
+ * ready and blocks until main releases them all at once.
+ */
+#define REGISTRY_NAME  "/arp_registry"
+#define REGISTRY_MAGIC 0x47455241u       // "AREG"
 
-#endif
\ No newline at end of file
+typedef enum {
+    ROLE_WATCHDOG,
+    ROLE_BLACKBOARD,
+    ROLE_DRONE,
+    ROLE_OBSTACLE,
+    ROLE_TARGET,
+    ROLE_INPUT,
+    ROLE_NETWORK,
+    ROLE_COUNT
+} ProcessRole;
+
+#define ROLE_BIT(role) (1u << (role))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t expected;                   // ROLE_BITs of the processes main spawns
+    _Atomic int32_t pid[ROLE_COUNT];     // 0 until the role registers
+    _Atomic uint32_t ready;              // ROLE_BITs reported ready (futex word)
+    _Atomic uint32_t go;                 // Set once by main to release the barrier (futex word)
+    _Atomic int64_t ready_ns[ROLE_COUNT]; // CLOCK_MONOTONIC of each ready report
+} PidRegistry;
+
+// Creates (or truncates) the segment, every slot empty. Called once by main.
+int  registry_create(uint32_t expected);
+void registry_unlink(void);
+
+// Publishes getpid() for role. Returns -1 when there is no registry.
+int   registry_publish(ProcessRole role);
+/* * Blocks until role is registered, at most timeout_ms (-1: no limit).
+ * Returns its PID, or -1 on timeout or when there is no registry (a process
+ * started on its own then runs unwatched instead of waiting forever).
+ */
+pid_t registry_wait(ProcessRole role, int timeout_ms);
+// PID of role, 0 while it is not registered
+pid_t registry_get(ProcessRole role);
+// Roles main spawned in this session, 0 when there is no registry
+uint32_t registry_expected(void);
+
+/* * Startup barrier. A process calls registry_ready() once its setup is done and
+ * before its main loop: it returns when main releases the barrier, or at once
+ * when there is no registry or the barrier is already released. main calls
+ * registry_barrier(), which returns the ROLE_BITs that were ready when it
+ * released them: all expected roles, or fewer when timeout_ms ran out.
+ */
+void     registry_ready(ProcessRole role);
+uint32_t registry_barrier(int timeout_ms);
+// CLOCK_MONOTONIC ns of role's ready report, 0 if it has not reported
+int64_t  registry_ready_ns(ProcessRole role);
+const char *registry_role_name(ProcessRole role);
+
+#endif
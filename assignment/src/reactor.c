@@ -0,0 +1,95 @@
+#include "reactor.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define NS_PER_SEC 1000000000LL
+
+/* ======================================================================================
+ * SECTION 1: REGISTRATION
+ * ====================================================================================== */
+int reactor_init(Reactor *r) {
+    memset(r, 0, sizeof(*r));
+    for (int i = 0; i < REACTOR_MAX_FDS; i++) r->entries[i].fd = -1;
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return (r->epfd < 0) ? -1 : 0;
+}
+
+void reactor_close(Reactor *r) {
+    if (r->epfd >= 0) close(r->epfd);
+    r->epfd = -1;
+}
+
+int reactor_add(Reactor *r, int fd, ReactorHandler handler, void *arg) {
+    ReactorEntry *e = NULL;
+    for (int i = 0; i < REACTOR_MAX_FDS && !e; i++) {
+        if (r->entries[i].fd < 0) e = &r->entries[i];
+    }
+    if (!e) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = e;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) return -1;
+
+    e->fd = fd;
+    e->handler = handler;
+    e->arg = arg;
+    return 0;
+}
+
+int reactor_del(Reactor *r, int fd) {
+    for (int i = 0; i < REACTOR_MAX_FDS; i++) {
+        if (r->entries[i].fd == fd) {
+            r->entries[i].fd = -1;
+            return epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL);
+        }
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+/* ======================================================================================
+ * SECTION 2: DISPATCH
+ * ====================================================================================== */
+int reactor_run_once(Reactor *r, int timeout_ms) {
+    struct epoll_event evs[REACTOR_MAX_FDS];
+    int n = epoll_wait(r->epfd, evs, REACTOR_MAX_FDS, timeout_ms);
+    if (n < 0) return -1;
+
+    for (int i = 0; i < n; i++) {
+        ReactorEntry *e = evs[i].data.ptr;
+        // A handler earlier in this batch may have removed the entry
+        if (e->fd >= 0) e->handler(e->fd, evs[i].events, e->arg);
+    }
+    return n;
+}
+
+/* ======================================================================================
+ * SECTION 3: TIMERS
+ * ====================================================================================== */
+int reactor_timer_create(void) {
+    return timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+int reactor_timer_arm(int tfd, long long first_ns, long long period_ns) {
+    struct itimerspec its;
+    its.it_value.tv_sec = first_ns / NS_PER_SEC;
+    its.it_value.tv_nsec = first_ns % NS_PER_SEC;
+    its.it_interval.tv_sec = period_ns / NS_PER_SEC;
+    its.it_interval.tv_nsec = period_ns % NS_PER_SEC;
+    return timerfd_settime(tfd, 0, &its, NULL);
+}
+
+uint64_t reactor_timer_drain(int tfd) {
+    uint64_t expirations = 0;
+    if (read(tfd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations)) return 0;
+    return expirations;
+}
@@ -0,0 +1,44 @@
+// reactor.h
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>
+
+#define REACTOR_MAX_FDS 16
+
+/* * Minimal epoll reactor: every registered fd has its own handler, called
+ * with the epoll events when it becomes ready. Timers are timerfds
+ * registered like any other fd.
+ */
+typedef void (*ReactorHandler)(int fd, uint32_t events, void *arg);
+
+typedef struct {
+    int fd;
+    ReactorHandler handler;
+    void *arg;
+} ReactorEntry;
+
+typedef struct {
+    int epfd;
+    ReactorEntry entries[REACTOR_MAX_FDS];
+} Reactor;
+
+int  reactor_init(Reactor *r);
+void reactor_close(Reactor *r);
+int  reactor_add(Reactor *r, int fd, ReactorHandler handler, void *arg);
+int  reactor_del(Reactor *r, int fd);
+
+/* * Waits up to timeout_ms (-1: forever) and dispatches the ready fds.
+ * Returns the number of dispatched events, -1 with errno set on error
+ * (EINTR when a signal arrived).
+ */
+int reactor_run_once(Reactor *r, int timeout_ms);
+
+// --- timerfd helpers (CLOCK_MONOTONIC, non-blocking) ---
+int      reactor_timer_create(void);
+// first_ns == 0 disarms the timer; period_ns == 0 makes it one-shot
+int      reactor_timer_arm(int tfd, long long first_ns, long long period_ns);
+// Consumes the expiration counter, returns the number of expirations
+uint64_t reactor_timer_drain(int tfd);
+
+#endif
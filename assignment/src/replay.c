@@ -0,0 +1,413 @@
+/* ======================================================================================
+ * FILE: replay.c
+ * Feeds a session trace (see trace.h, recorded by the Blackboard when
+ * ARP_TRACE_FILE is set) back into a freshly spawned Drone or Blackboard.
+ *
+ *   replay <trace> [drone|blackboard] [fast]
+ *
+ * drone      : replays everything the Blackboard sent to the Drone and compares
+ *              the replayed trajectory with the recorded one.
+ * blackboard : replays Input keys, Drone positions/forces and the obstacle/target
+ *              arrays, so the recorded session is redrawn on this terminal.
+ * fast       : no pacing. The Drone runs in lockstep on TICK messages (one per
+ *              RENDER_FPS period of recorded time), so the physics path runs as
+ *              fast as the CPU allows while inputs still land on the same steps.
+ * ====================================================================================== */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+
+#include "app_common.h"
+#include "log.h"
+#include "shm_ipc.h"
+#include "msg_codec.h"
+#include "trace.h"
+
+#define MAX_SINKS 8
+#define TICK_STEPS ((PHYSICS_HZ / RENDER_FPS) > 0 ? (PHYSICS_HZ / RENDER_FPS) : 1)
+#define TICK_NS    (1000000000LL * TICK_STEPS / PHYSICS_HZ)
+
+enum { TARGET_DRONE, TARGET_BLACKBOARD };
+
+/* * Everything the replayed process writes is drained here, otherwise it would
+ * block on a full pipe while we block feeding it. fds[0] of the Drone target
+ * carries its Messages, which are parsed to follow the replayed position.
+ */
+typedef struct {
+    int fds[MAX_SINKS];
+    int count;
+    int parse_drone;
+    unsigned long positions;
+    float last_x, last_y;
+    Message partial;               // Message split across two reads
+    size_t partial_len;
+    size_t skip;                   // Bytes of a SWARM payload still to skip
+} Sink;
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 1: HELPERS
+ * ------------------------------------------------------------------------------------- */
+static long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void sink_add(Sink *s, int fd) {
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    s->fds[s->count++] = fd;
+}
+
+/* * The Drone's output is a stream of Messages, where a SWARM header (swarm
+ * builds) is followed by its positions: those are skipped, not parsed.
+ */
+static void sink_parse(Sink *s, const uint8_t *p, size_t n) {
+    while (n > 0) {
+        if (s->skip) {
+            size_t k = (n < s->skip) ? n : s->skip;
+            s->skip -= k; p += k; n -= k;
+            continue;
+        }
+        size_t k = sizeof(Message) - s->partial_len;
+        if (k > n) k = n;
+        memcpy((uint8_t *)&s->partial + s->partial_len, p, k);
+        s->partial_len += k; p += k; n -= k;
+        if (s->partial_len < sizeof(Message)) break;
+        s->partial_len = 0;
+
+        const Message *m = &s->partial;
+        int count;
+        if (m->type == MSG_TYPE_POSITION && msg_decode_position(m, &s->last_x, &s->last_y) == 0) {
+            s->positions++;
+        } else if (m->type == MSG_TYPE_SWARM && msg_decode_entities(m, &count, NULL) == 0) {
+            s->skip = sizeof(MsgPosition) * (size_t)count;
+        }
+    }
+}
+
+static void sink_read(Sink *s, int i) {
+    uint8_t batch[64 * sizeof(Message)];
+    ssize_t n;
+    while ((n = read(s->fds[i], batch, sizeof(batch))) > 0) {
+        if (s->parse_drone && i == 0) sink_parse(s, batch, (size_t)n);
+    }
+    if (n == 0) { // Writer gone
+        close(s->fds[i]);
+        s->fds[i] = -1;
+    }
+}
+
+/* * Waits up to timeout_ns (-1: forever) for output or, if wfd >= 0, for wfd to
+ * become writable. Returns 1 if wfd is writable, 0 otherwise, -1 if nothing is
+ * left to wait on.
+ */
+static int sink_poll(Sink *s, long long timeout_ns, int wfd) {
+    fd_set rfds, wfds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    int max_fd = -1;
+    for (int i = 0; i < s->count; i++) {
+        if (s->fds[i] < 0) continue;
+        FD_SET(s->fds[i], &rfds);
+        if (s->fds[i] > max_fd) max_fd = s->fds[i];
+    }
+    if (wfd >= 0) {
+        FD_SET(wfd, &wfds);
+        if (wfd > max_fd) max_fd = wfd;
+    }
+    if (max_fd < 0) return -1;
+
+    struct timeval tv, *ptv = NULL;
+    if (timeout_ns >= 0) {
+        tv.tv_sec = timeout_ns / 1000000000LL;
+        tv.tv_usec = (timeout_ns % 1000000000LL) / 1000;
+        ptv = &tv;
+    }
+    int ret = select(max_fd + 1, &rfds, wfd >= 0 ? &wfds : NULL, NULL, ptv);
+    if (ret < 0) return (errno == EINTR) ? 0 : -1;
+
+    for (int i = 0; i < s->count; i++) {
+        if (s->fds[i] >= 0 && FD_ISSET(s->fds[i], &rfds)) sink_read(s, i);
+    }
+    return (wfd >= 0 && FD_ISSET(wfd, &wfds)) ? 1 : 0;
+}
+
+// Writes len bytes to the (non-blocking) fd while draining the sinks
+static int feed(Sink *s, int fd, const void *buf, size_t len) {
+    size_t off = 0;
+    sink_poll(s, 0, -1);
+    while (off < len) {
+        ssize_t n = write(fd, (const char *)buf + off, len - off);
+        if (n > 0) { off += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno != EAGAIN) return -1;
+        if (sink_poll(s, -1, fd) < 0) return -1;
+    }
+    return 0;
+}
+
+static void wait_until(Sink *s, long long deadline_ns) {
+    long long left;
+    while ((left = deadline_ns - now_ns()) > 0) {
+        if (sink_poll(s, left, -1) < 0) usleep(left / 1000);
+    }
+}
+
+static int wait_positions(Sink *s, unsigned long target) {
+    while (s->positions < target) {
+        if (sink_poll(s, -1, -1) < 0) return -1;
+    }
+    return 0;
+}
+
+// Waits until the replayed process has read everything fed so far
+static void wait_consumed(Sink *s, const int *fds, int n) {
+    for (int tries = 0; tries < 500; tries++) { // <= ~5s
+        int pending = 0;
+        for (int i = 0; i < n; i++) {
+            int bytes = 0;
+            if (fds[i] >= 0 && ioctl(fds[i], FIONREAD, &bytes) == 0) pending += bytes;
+        }
+        if (pending == 0) return;
+        if (sink_poll(s, 10000000LL, -1) < 0) return;
+    }
+}
+
+// Input records are raw key bytes or, from LATENCY=1 sessions, stamped Messages
+static int is_quit_key(const void *buf, size_t len) {
+    char key;
+    MsgLatency lat;
+    return msg_decode_input_record(buf, len, &key, &lat) == 0 && key == 'q';
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <trace> [drone|blackboard] [fast]\n", prog);
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 2: MAIN
+ * ------------------------------------------------------------------------------------- */
+int main(int argc, char *argv[]) {
+    if (argc < 2) { usage(argv[0]); return 1; }
+    config_from_env(); // TICK_STEPS: run it with the session's ARP_* rates
+
+#if USE_SHM_TRANSPORT
+    // The replayed process would wait for data on the rings, not on our pipes
+    fprintf(stderr, "[REPLAY] Needs the pipe transport, rebuild with SHM=0\n");
+    return 1;
+#endif
+
+    int target = TARGET_DRONE, fast = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "drone") == 0) target = TARGET_DRONE;
+        else if (strcmp(argv[i], "blackboard") == 0) target = TARGET_BLACKBOARD;
+        else if (strcmp(argv[i], "fast") == 0) fast = 1;
+        else { usage(argv[0]); return 1; }
+    }
+
+    int fd_trace = open(argv[1], O_RDONLY);
+    if (fd_trace < 0) {
+        perror("open trace");
+        return 1;
+    }
+    TraceFileHeader hdr;
+    if (trace_read_header(fd_trace, &hdr) < 0) {
+        fprintf(stderr, "[REPLAY] %s is not a trace file\n", argv[1]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    logMessage(LOG_PATH, "[REPLAY] %s into %s (%s), recorded mode %d role %d",
+               argv[1], target == TARGET_DRONE ? "drone" : "blackboard", fast ? "fast" : "1x",
+               hdr.mode, hdr.role);
+
+    // --- SPAWN THE REPLAYED PROCESS ---
+    Sink sink = {0};
+    int fd_input = -1, fd_drone = -1, fd_obst = -1, fd_targ = -1;
+    pid_t child;
+
+    if (target == TARGET_DRONE) {
+        int to_drone[2], from_drone[2];
+        if (pipe(to_drone) == -1 || pipe(from_drone) == -1) { perror("pipe"); return 1; }
+
+        child = fork();
+        if (child < 0) { perror("fork"); return 1; }
+        if (child == 0) {
+            close(to_drone[1]); close(from_drone[0]); close(fd_trace);
+            char fd_in[16], fd_out[16], arg_mode[4], arg_role[4];
+            snprintf(fd_in,    sizeof(fd_in),    "%d", to_drone[0]);
+            snprintf(fd_out,   sizeof(fd_out),   "%d", from_drone[1]);
+            snprintf(arg_mode, sizeof(arg_mode), "%d", MODE_REPLAY);
+            // Only networked sessions have a role, and it decides the spawn point
+            snprintf(arg_role, sizeof(arg_role), "%d", hdr.mode == MODE_NETWORKED ? hdr.role : 0);
+            execlp("./exec/drone", "./exec/drone", fd_in, fd_out, arg_mode, arg_role, fast ? "fast" : "1x", NULL);
+            perror("exec drone");
+            exit(1);
+        }
+        close(to_drone[0]); close(from_drone[1]);
+        fd_drone = to_drone[1];
+        fcntl(fd_drone, F_SETFL, O_NONBLOCK);
+        sink.parse_drone = 1;
+        sink_add(&sink, from_drone[0]);
+    } else {
+        // Same pipe set main.c builds; nothing answers on the Drone/Obstacle/Target/WD/Network outputs
+        int p_input[2], p_drone_bb[2], p_bb_drone[2], p_bb_obst[2], p_obst_bb[2];
+        int p_bb_targ[2], p_targ_bb[2], p_bb_wd[2], p_bb_net[2], p_net_bb[2];
+        if (pipe(p_input) == -1 || pipe(p_drone_bb) == -1 || pipe(p_bb_drone) == -1 ||
+            pipe(p_bb_obst) == -1 || pipe(p_obst_bb) == -1 || pipe(p_bb_targ) == -1 ||
+            pipe(p_targ_bb) == -1 || pipe(p_bb_wd) == -1 || pipe(p_bb_net) == -1 || pipe(p_net_bb) == -1) {
+            perror("pipe");
+            return 1;
+        }
+
+        child = fork();
+        if (child < 0) { perror("fork"); return 1; }
+        if (child == 0) {
+            close(p_input[1]); close(p_drone_bb[1]); close(p_bb_drone[0]);
+            close(p_bb_obst[0]); close(p_obst_bb[1]); close(p_bb_targ[0]);
+            close(p_targ_bb[1]); close(p_bb_wd[0]); close(p_bb_net[0]); close(p_net_bb[1]);
+            close(fd_trace);
+
+            char a[12][16];
+            int fds[12] = { p_input[0], p_drone_bb[0], p_bb_drone[1], p_bb_obst[1], p_obst_bb[0],
+                            p_bb_targ[1], p_targ_bb[0], p_bb_wd[1], MODE_REPLAY, 0, p_bb_net[1], p_net_bb[0] };
+            for (int i = 0; i < 12; i++) snprintf(a[i], sizeof(a[i]), "%d", fds[i]);
+            execlp("./exec/blackboard", "./exec/blackboard",
+                   a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], "0.0.0.0", a[10], a[11], "0", NULL);
+            perror("exec blackboard");
+            exit(1);
+        }
+        close(p_input[0]); close(p_drone_bb[0]); close(p_bb_drone[1]);
+        close(p_bb_obst[1]); close(p_obst_bb[0]); close(p_bb_targ[1]);
+        close(p_targ_bb[0]); close(p_bb_wd[1]); close(p_bb_net[1]); close(p_net_bb[0]);
+
+        fd_input = p_input[1];
+        fd_drone = p_drone_bb[1];
+        fd_obst  = p_obst_bb[1];
+        fd_targ  = p_targ_bb[1];
+        fcntl(fd_input, F_SETFL, O_NONBLOCK);
+        fcntl(fd_drone, F_SETFL, O_NONBLOCK);
+        fcntl(fd_obst,  F_SETFL, O_NONBLOCK);
+        fcntl(fd_targ,  F_SETFL, O_NONBLOCK);
+        sink_add(&sink, p_bb_drone[0]);
+        sink_add(&sink, p_bb_obst[0]);
+        sink_add(&sink, p_bb_targ[0]);
+        sink_add(&sink, p_bb_wd[0]);
+        sink_add(&sink, p_bb_net[0]);
+    }
+
+    // --- PLAYBACK ---
+    static uint8_t buf[TRACE_MAX_RECORD];
+    TraceRecord rec;
+    unsigned long sent = 0, ticks = 0;
+    long long virtual_ns = 0;
+    float rec_x = 0.0f, rec_y = 0.0f;
+    int have_rec_pos = 0, ended = 0, r;
+    long long t_start = now_ns();
+
+    while ((r = trace_read_next(fd_trace, &rec, buf, sizeof(buf))) == 1) {
+        const Message *m = (const Message *)buf;
+        int is_msg = rec.len >= sizeof(Message);
+
+        // Recorded trajectory, for the comparison at the end
+        if (rec.source == TRACE_SRC_DRONE && is_msg && m->type == MSG_TYPE_POSITION &&
+            msg_decode_position(m, &rec_x, &rec_y) == 0) {
+            have_rec_pos = 1;
+        }
+        if (ended) continue;
+
+        int fd = -1;
+        if (target == TARGET_DRONE) {
+            if (rec.source == TRACE_SRC_TO_DRONE && is_msg) fd = fd_drone;
+        } else if (rec.source == TRACE_SRC_INPUT) {
+            fd = fd_input;
+        } else if (rec.source == TRACE_SRC_DRONE) {
+            fd = fd_drone;
+        } else if (rec.source == TRACE_SRC_TO_DRONE && is_msg) {
+            // Entity arrays as the Blackboard knew them, including its own relocations
+            MsgEntityDelta d;
+            if (m->type == MSG_TYPE_OBSTACLES) fd = fd_obst;
+            else if (m->type == MSG_TYPE_TARGETS) fd = fd_targ;
+            else if (m->type == MSG_TYPE_ENTITY_DELTA && msg_decode_entity_delta(m, &d) == 0)
+                fd = (d.kind == MSG_TYPE_OBSTACLES) ? fd_obst : fd_targ;
+        }
+        if (fd < 0) continue;
+
+        if (!fast) {
+            wait_until(&sink, t_start + (long long)rec.t_ns);
+        } else if (target == TARGET_DRONE) {
+            // Advance the Drone to the record's time, one output period per TICK
+            while (virtual_ns < (long long)rec.t_ns) {
+                Message tick;
+                msg_encode_tick(&tick, TICK_STEPS);
+                if (feed(&sink, fd_drone, &tick, sizeof(tick)) < 0) break;
+                ticks++;
+                virtual_ns += TICK_NS;
+                if (wait_positions(&sink, ticks) < 0) break;
+            }
+        }
+
+        // The quit is sent after the shutdown drain, so nothing queued is lost
+        if ((target == TARGET_DRONE && m->type == MSG_TYPE_EXIT) ||
+            (target == TARGET_BLACKBOARD && fd == fd_input && is_quit_key(buf, rec.len))) {
+            ended = 1;
+            continue;
+        }
+
+        if (feed(&sink, fd, buf, rec.len) < 0) {
+            logMessage(LOG_PATH, "[REPLAY] Replayed process stopped reading");
+            ended = 1;
+            continue;
+        }
+        sent++;
+    }
+    if (r < 0) logMessage(LOG_PATH, "[REPLAY] Truncated record after %lu records", sent);
+    close(fd_trace);
+
+    // --- SHUTDOWN: let the process consume everything, then quit it ---
+    int fed[4] = { fd_input, fd_drone, fd_obst, fd_targ };
+    wait_consumed(&sink, fed, 4);
+    double secs = (now_ns() - t_start) / 1e9;
+
+    if (target == TARGET_DRONE) {
+        Message quit_msg;
+        msg_encode_exit(&quit_msg);
+        feed(&sink, fd_drone, &quit_msg, sizeof(quit_msg));
+    } else {
+        const char quit_key[2] = { 'q', '\0' };
+        feed(&sink, fd_input, quit_key, sizeof(quit_key));
+    }
+    while (sink_poll(&sink, -1, -1) >= 0); // Until every output is closed
+    waitpid(child, NULL, 0);
+
+    // --- REPORT ---
+    if (secs <= 0.0) secs = 1e-9;
+    printf("[REPLAY] %s %s: %lu records in %.3f s (%.0f records/s)\n",
+           target == TARGET_DRONE ? "drone" : "blackboard", fast ? "fast" : "1x", sent, secs, sent / secs);
+    logMessage(LOG_PATH, "[REPLAY] %lu records in %.3f s", sent, secs);
+
+    if (target == TARGET_DRONE) {
+        if (fast) {
+            unsigned long steps = ticks * TICK_STEPS;
+            printf("[REPLAY] %lu physics steps (%.0f steps/s, %.1fx real time)\n",
+                   steps, steps / secs, (virtual_ns / 1e9) / secs);
+        }
+        printf("[REPLAY] %lu positions, replayed final (%.3f, %.3f)\n", sink.positions, sink.last_x, sink.last_y);
+        if (have_rec_pos) {
+            float dx = sink.last_x - rec_x, dy = sink.last_y - rec_y;
+            printf("[REPLAY] recorded final (%.3f, %.3f), distance %.4f\n", rec_x, rec_y, sqrtf(dx*dx + dy*dy));
+            logMessage(LOG_PATH, "[REPLAY] Final position error %.4f", sqrtf(dx*dx + dy*dy));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include "shm_ipc.h"
+#include "app_common.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RING_MASK (SHM_RING_BYTES - 1)
+#define REC_ALIGN(n) (((n) + 3u) & ~3u)
+
+/* ======================================================================================
+ * SECTION 1: SEGMENT LIFETIME
+ * ====================================================================================== */
+int shm_world_create(void) {
+    int fd = shm_open(SHM_WORLD_NAME, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        logMessage(LOG_PATH, "[SHM] ERROR shm_open: %s", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(ShmWorld)) < 0) {
+        logMessage(LOG_PATH, "[SHM] ERROR ftruncate: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    ShmWorld *w = mmap(NULL, sizeof(ShmWorld), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED) {
+        logMessage(LOG_PATH, "[SHM] ERROR mmap: %s", strerror(errno));
+        return -1;
+    }
+
+    // ftruncate zero-fills the segment: counters and seqlock start at 0
+    w->magic = SHM_WORLD_MAGIC;
+    munmap(w, sizeof(ShmWorld));
+    logMessage(LOG_PATH, "[SHM] World segment created (%zu bytes)", sizeof(ShmWorld));
+    return 0;
+}
+
+ShmWorld *shm_world_attach(void) {
+    int fd = shm_open(SHM_WORLD_NAME, O_RDWR, 0600);
+    if (fd < 0) {
+        logMessage(LOG_PATH, "[SHM] ERROR attach shm_open: %s", strerror(errno));
+        return NULL;
+    }
+    ShmWorld *w = mmap(NULL, sizeof(ShmWorld), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED) {
+        logMessage(LOG_PATH, "[SHM] ERROR attach mmap: %s", strerror(errno));
+        return NULL;
+    }
+    if (w->magic != SHM_WORLD_MAGIC) {
+        logMessage(LOG_PATH, "[SHM] ERROR bad segment magic");
+        munmap(w, sizeof(ShmWorld));
+        return NULL;
+    }
+    return w;
+}
+
+void shm_world_detach(ShmWorld *w) {
+    if (w) munmap(w, sizeof(ShmWorld));
+}
+
+void shm_world_unlink(void) {
+    shm_unlink(SHM_WORLD_NAME);
+}
+
+/* ======================================================================================
+ * SECTION 2: SEQLOCK DRONE STATE
+ * ====================================================================================== */
+void shm_drone_publish(ShmDroneState *s, float x, float y, const MsgForce *forces, const MsgLatency *echo) {
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    s->x = x;
+    s->y = y;
+    s->forces = *forces;
+    if (echo) s->echo = *echo;
+    else s->echo.id = 0;
+    s->frame++;
+
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
+
+int shm_drone_read(ShmDroneState *s, float *x, float *y, MsgForce *forces, MsgLatency *echo,
+                   uint32_t *last_frame) {
+    uint32_t s1, s2, frame;
+    do {
+        s1 = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (s1 & 1) continue; // Writer in progress
+        *x = s->x;
+        *y = s->y;
+        *forces = s->forces;
+        *echo = s->echo;
+        frame = s->frame;
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+
+    if (frame == *last_frame) return 0;
+    *last_frame = frame;
+    return 1;
+}
+
+/* ======================================================================================
+ * SECTION 3: SPSC RING
+ * ====================================================================================== */
+static void ring_copy_in(ShmRing *r, uint64_t pos, const void *src, size_t len) {
+    size_t off = pos & RING_MASK;
+    size_t first = SHM_RING_BYTES - off;
+    if (first > len) first = len;
+    memcpy(r->data + off, src, first);
+    memcpy(r->data, (const uint8_t *)src + first, len - first);
+}
+
+static void ring_copy_out(const ShmRing *r, uint64_t pos, void *dst, size_t len) {
+    size_t off = pos & RING_MASK;
+    size_t first = SHM_RING_BYTES - off;
+    if (first > len) first = len;
+    memcpy(dst, r->data + off, first);
+    memcpy((uint8_t *)dst + first, r->data, len - first);
+}
+
+static int ring_push(ShmRing *r, uint32_t flags, const void *a, size_t alen, const void *b, size_t blen) {
+    uint32_t len = (uint32_t)(alen + blen);
+    uint64_t need = sizeof(uint32_t) + REC_ALIGN((uint64_t)alen + blen);
+    if (need > SHM_RING_BYTES) return -1; // Would never fit, however long it waited
+
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (need > SHM_RING_BYTES - (head - tail)) return -1;
+
+    uint32_t word = len | flags;
+    ring_copy_in(r, head, &word, sizeof(word));
+    ring_copy_in(r, head + sizeof(word), a, alen);
+    if (blen) ring_copy_in(r, head + sizeof(word) + alen, b, blen);
+
+    atomic_store_explicit(&r->head, head + need, memory_order_release);
+    return 0;
+}
+
+int shm_ring_push(ShmRing *r, const void *a, size_t alen, const void *b, size_t blen) {
+    return ring_push(r, 0, a, alen, b, blen);
+}
+
+ssize_t shm_ring_pop(ShmRing *r, void *out, size_t cap, int *more) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return 0;
+
+    uint32_t len;
+    ring_copy_out(r, tail, &len, sizeof(len));
+    *more = (len & SHM_REC_MORE) != 0;
+    len &= ~SHM_REC_MORE;
+    ssize_t ret = len;
+    if (len > cap) ret = -1; // Dropped, so that the ring never wedges
+    else ring_copy_out(r, tail + sizeof(len), out, len);
+
+    atomic_store_explicit(&r->tail, tail + sizeof(len) + REC_ALIGN(len), memory_order_release);
+    return ret;
+}
+
+/* ======================================================================================
+ * SECTION 4: PRODUCER OUTBOX
+ * ====================================================================================== */
+void shm_outbox_init(ShmOutbox *o, ShmRing *ring) {
+    memset(o, 0, sizeof(*o));
+    o->ring = ring;
+}
+
+void shm_outbox_free(ShmOutbox *o) {
+    free(o->buf);
+    memset(o, 0, sizeof(*o));
+}
+
+size_t shm_outbox_pending(const ShmOutbox *o) {
+    return o->len - o->off;
+}
+
+// Bytes [from, from + n) of the concatenation a + b
+static void gather(uint8_t *dst, const void *a, size_t alen, const void *b, size_t from, size_t n) {
+    if (from < alen) {
+        size_t k = (n < alen - from) ? n : alen - from;
+        memcpy(dst, (const uint8_t *)a + from, k);
+        dst += k; from += k; n -= k;
+    }
+    if (n) memcpy(dst, (const uint8_t *)b + (from - alen), n);
+}
+
+int shm_outbox_flush(ShmOutbox *o) {
+    int pushed = 0;
+    while (o->off < o->len) {
+        uint32_t word;
+        memcpy(&word, o->buf + o->off, sizeof(word));
+        uint32_t len = word & ~SHM_REC_MORE;
+        if (ring_push(o->ring, word & SHM_REC_MORE, o->buf + o->off + sizeof(word), len, NULL, 0) < 0) break;
+        o->off += sizeof(word) + len;
+        pushed++;
+    }
+    if (o->off == o->len) o->off = o->len = 0;
+    return pushed;
+}
+
+int shm_outbox_send(ShmOutbox *o, const void *a, size_t alen, const void *b, size_t blen) {
+    size_t total = alen + blen;
+    // Nothing waiting: small records go straight to the ring
+    if (o->off == o->len && total <= SHM_CHUNK_BYTES && ring_push(o->ring, 0, a, alen, b, blen) == 0) return 1;
+
+    size_t chunks = total ? (total + SHM_CHUNK_BYTES - 1) / SHM_CHUNK_BYTES : 1;
+    size_t add = total + chunks * sizeof(uint32_t);
+    if (shm_outbox_pending(o) + add > SHM_OUTBOX_MAX) return -1;
+
+    // Compact before growing: the pushed bytes at the front are dead
+    if (o->off) {
+        memmove(o->buf, o->buf + o->off, o->len - o->off);
+        o->len -= o->off;
+        o->off = 0;
+    }
+    if (o->len + add > o->cap) {
+        size_t cap = o->cap ? o->cap : SHM_RING_BYTES;
+        while (cap < o->len + add) cap *= 2;
+        uint8_t *nb = realloc(o->buf, cap);
+        if (!nb) return -1;
+        o->buf = nb;
+        o->cap = cap;
+    }
+
+    for (size_t from = 0, i = 0; i < chunks; i++) {
+        size_t n = (total - from < SHM_CHUNK_BYTES) ? total - from : SHM_CHUNK_BYTES;
+        uint32_t word = (uint32_t)n | (i + 1 < chunks ? SHM_REC_MORE : 0);
+        memcpy(o->buf + o->len, &word, sizeof(word));
+        gather(o->buf + o->len + sizeof(word), a, alen, b, from, n);
+        o->len += sizeof(word) + n;
+        from += n;
+    }
+    return shm_outbox_flush(o);
+}
@@ -0,0 +1,98 @@
+// shm_ipc.h
+#ifndef SHM_IPC_H
+#define SHM_IPC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#include "app_common.h"
+
+/* Build option: make SHM=1 enables the shared-memory transport between
+ * Blackboard and Drone. With 0 the plain Message-over-pipe path is used. */
+#ifndef USE_SHM_TRANSPORT
+#define USE_SHM_TRANSPORT 0
+#endif
+
+#define SHM_WORLD_NAME  "/arp_world"
+#define SHM_WORLD_MAGIC 0x41525057u      // "ARPW"
+#define SHM_RING_BYTES  (64 * 1024)      // Must be a power of two
+#define SHM_WAKE_BYTE   'w'              // Pipes only carry wake-ups in SHM mode
+#define SHM_CHUNK_BYTES (SHM_RING_BYTES / 4) // Largest record an outbox pushes in one piece
+#define SHM_OUTBOX_MAX  (8 * 1024 * 1024) // Bytes an outbox may hold back before it drops
+#define SHM_REC_MORE    0x80000000u      // Length flag: the next record continues this one
+
+/* * Drone state block (Drone -> Blackboard), protected by a seqlock.
+ * seq is odd while the drone is writing; readers retry until they see
+ * the same even value before and after copying the fields.
+ */
+typedef struct {
+    _Atomic uint32_t seq;
+    uint32_t frame;                      // Incremented on every publish
+    float x, y;
+    MsgForce forces;
+    MsgLatency echo;                     // Key press stamp echoed by this frame (id 0: none)
+} ShmDroneState;
+
+/* * Single-producer / single-consumer byte ring.
+ * Records are [uint32 len][payload] padded to 4 bytes. head and tail are
+ * free-running byte counters kept on separate cache lines. A len with
+ * SHM_REC_MORE set is a chunk: the payload goes on in the next record.
+ */
+typedef struct {
+    _Atomic uint64_t head;               // Written by the producer only
+    char pad_head[56];
+    _Atomic uint64_t tail;               // Written by the consumer only
+    char pad_tail[56];
+    uint8_t data[SHM_RING_BYTES];
+} ShmRing;
+
+typedef struct {
+    uint32_t magic;
+    ShmDroneState drone;
+    ShmRing inputs;                      // Blackboard -> Drone: size, input keys, exit
+    ShmRing entities;                    // Blackboard -> Drone: obstacle/target arrays
+} ShmWorld;
+
+// Creates (or truncates) the segment. Called once by main before forking.
+int shm_world_create(void);
+// Maps the segment created by main. Returns NULL on failure.
+ShmWorld *shm_world_attach(void);
+void shm_world_detach(ShmWorld *w);
+void shm_world_unlink(void);
+
+// Seqlock writer/reader for the drone state block. echo may be NULL (nothing echoed).
+void shm_drone_publish(ShmDroneState *s, float x, float y, const MsgForce *forces, const MsgLatency *echo);
+// Copies a consistent snapshot. Returns 1 if frame differs from *last_frame (and updates it).
+int  shm_drone_read(ShmDroneState *s, float *x, float *y, MsgForce *forces, MsgLatency *echo,
+                    uint32_t *last_frame);
+
+// Pushes one record made of two parts (header + optional payload). 0 on success, -1 if
+// full, or at once if the record could never fit (SHM_RING_BYTES and more: see ShmOutbox).
+int     shm_ring_push(ShmRing *r, const void *a, size_t alen, const void *b, size_t blen);
+// Pops one record into out. Returns its length, 0 if empty, -1 if cap is too small
+// (the record is dropped in that case). *more: a chunk, continued by the next record.
+ssize_t shm_ring_pop(ShmRing *r, void *out, size_t cap, int *more);
+
+/* * Producer-side queue in front of a ring, so a full ring never blocks the
+ * producer. Records that do not fit yet wait here, in order, and move on with
+ * shm_outbox_flush() once the consumer has made room. One that is bigger than
+ * SHM_CHUNK_BYTES leaves as chunks, which the consumer reads back as one stream.
+ */
+typedef struct {
+    ShmRing *ring;
+    uint8_t *buf;                        // [uint32 len | flags][payload] records, unpadded
+    size_t len, cap, off;                // off: first byte not pushed yet
+} ShmOutbox;
+
+void   shm_outbox_init(ShmOutbox *o, ShmRing *ring);
+void   shm_outbox_free(ShmOutbox *o);
+// Queues a record behind the pending ones and pushes what fits. Returns the records
+// pushed, or -1 when it was dropped (no memory, or SHM_OUTBOX_MAX already held back).
+int    shm_outbox_send(ShmOutbox *o, const void *a, size_t alen, const void *b, size_t blen);
+// Pushes what fits of the pending records. Returns the records pushed.
+int    shm_outbox_flush(ShmOutbox *o);
+size_t shm_outbox_pending(const ShmOutbox *o);
+
+#endif
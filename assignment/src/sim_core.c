@@ -0,0 +1,230 @@
+#include "sim_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "occupancy.h"
+#include "entities.h"
+
+/* ======================================================================================
+ * SECTION 1: FIELD
+ * ====================================================================================== */
+void sim_scratch_init(SimScratch *sc) {
+    sc->hits = NULL;
+    sc->hits_cap = 0;
+    soa_init(&sc->near);
+}
+
+void sim_scratch_free(SimScratch *sc) {
+    free(sc->hits);
+    soa_free(&sc->near);
+    sim_scratch_init(sc);
+}
+
+// A query can return every entity of a grid: room for the larger of the two
+static int scratch_fit(SimScratch *sc, const SimField *f) {
+    int need = f->obst_grid.count > f->targ_grid.count ? f->obst_grid.count : f->targ_grid.count;
+    if (need <= sc->hits_cap) return 0;
+    int *hits = realloc(sc->hits, sizeof(int) * need);
+    if (!hits) return -1;
+    sc->hits = hits;
+    sc->hits_cap = need;
+    return 0;
+}
+
+void sim_field_init(SimField *f) {
+    grid_init(&f->obst_grid);
+    grid_init(&f->targ_grid);
+    soa_init(&f->obst_soa);
+    soa_init(&f->targ_soa);
+    sim_scratch_init(&f->scratch);
+}
+
+void sim_field_free(SimField *f) {
+    grid_free(&f->obst_grid);
+    grid_free(&f->targ_grid);
+    soa_free(&f->obst_soa);
+    soa_free(&f->targ_soa);
+    sim_scratch_free(&f->scratch);
+}
+
+void sim_field_set_obstacles(SimField *f, const Point *obstacles, int n) {
+    grid_sync(&f->obst_grid, obstacles, n);
+    soa_from_points(&f->obst_soa, obstacles, n);
+}
+
+void sim_field_set_targets(SimField *f, const Point *targets, int n) {
+    grid_sync(&f->targ_grid, targets, n);
+    soa_from_points(&f->targ_soa, targets, n);
+}
+
+/* ======================================================================================
+ * SECTION 2: PHYSICS
+ * ====================================================================================== */
+/* * Forces on one drone at (x, y) with command force (Fx, Fy): targets, obstacles
+ * and walls summed and clamped into *totFx, *totFy. out (may be NULL) receives
+ * the breakdown.
+ */
+static void drone_forces(const SimField *f, SimScratch *sc, float x, float y, float Fx, float Fy,
+                         int win_width, int win_height, float *totFx, float *totFy, MsgForce *out) {
+    float repFx=0.0f, repFy=0.0f, repWallFx=0.0f, repWallFy=0.0f, abtrFx = 0.0f, abtrFy = 0.0f;
+
+    // Only entities within rho (+ the half-cell offset) can contribute
+    int num_hits;
+
+    // A. Attractive (Targets)
+    num_hits = grid_query_into(&f->targ_grid, x, y, rho + 1.0f, sc->hits);
+    soa_gather(&sc->near, &f->targ_soa, sc->hits, num_hits);
+    force_sum(&sc->near, x, y, rho, eta, &abtrFx, &abtrFy);
+
+    // B. Repulsive (Obstacles)
+    num_hits = grid_query_into(&f->obst_grid, x, y, rho + 1.0f, sc->hits);
+    soa_gather(&sc->near, &f->obst_soa, sc->hits, num_hits);
+    force_sum(&sc->near, x, y, rho, eta, &repFx, &repFy);
+
+    // C. Walls
+    float dR = (win_width-1) - x;
+    float dL = x - 1;
+    float dT = y - 1;
+    float dB = (win_height-1) - y;
+    if(dR < rho) repWallFx -= eta * (1.0f/dR - 1.0f/rho)/(dR*dR);
+    if(dL < rho) repWallFx += eta * (1.0f/dL - 1.0f/rho)/(dL*dL);
+    if(dT < rho) repWallFy += eta * (1.0f/dT - 1.0f/rho)/(dT*dT);
+    if(dB < rho) repWallFy -= eta * (1.0f/dB - 1.0f/rho)/(dB*dB);
+
+    // D. Sum & Clamp
+    float sumFx = Fx + repFx + repWallFx - abtrFx;
+    float sumFy = Fy + repFy + repWallFy - abtrFy;
+    float forceMag = sqrt(sumFx*sumFx + sumFy*sumFy);
+    if(forceMag > MAX_FORCE){
+        sumFx = sumFx/forceMag*MAX_FORCE;
+        sumFy = sumFy/forceMag*MAX_FORCE;
+    }
+    *totFx = sumFx;
+    *totFy = sumFy;
+
+    if (out) *out = (MsgForce){Fx, Fy, repFx, repFy, repWallFx, repWallFy, abtrFx, abtrFy};
+}
+
+// F. Collision: a drone that ended on an obstacle goes back to (x_1, y_1)
+static void drone_collide(const SimField *f, SimScratch *sc, const Point *obstacles,
+                          float *x, float *y, float x_1, float y_1) {
+    int num_hits = grid_query_into(&f->obst_grid, *x, *y, 1.0f, sc->hits);
+    for(int h=0; h<num_hits; h++){
+        int i = sc->hits[h];
+        float dx = *x - (float)obstacles[i].x;
+        float dy = *y - (float)obstacles[i].y;
+        if(sqrt(dx*dx + dy*dy) <= 0.1f){
+            *x = x_1; *y = y_1;
+            break;
+        }
+    }
+}
+
+void sim_physics_step(SimField *f, const Point *obstacles, Drone *drn, int win_width, int win_height, MsgForce *out) {
+    float totFx, totFy;
+    if (scratch_fit(&f->scratch, f) < 0) return;
+    drone_forces(f, &f->scratch, drn->x, drn->y, drn->Fx, drn->Fy, win_width, win_height, &totFx, &totFy, out);
+
+    // E. Euler Integration
+    drn->x_2 = drn->x_1; drn->x_1 = drn->x;
+    drn->y_2 = drn->y_1; drn->y_1 = drn->y;
+    drn->x = (DT*DT*totFx - drn->x_2 + (2+K*DT)*drn->x_1)/(1+K*DT);
+    drn->y = (DT*DT*totFy - drn->y_2 + (2+K*DT)*drn->y_1)/(1+K*DT);
+
+    drone_collide(f, &f->scratch, obstacles, &drn->x, &drn->y, drn->x_1, drn->y_1);
+}
+
+/* ======================================================================================
+ * SECTION 3: SWARM
+ * ====================================================================================== */
+int sim_swarm_init(DroneSwarm *s, int count) {
+    memset(s, 0, sizeof(*s));
+    // Every array starts on a 64-byte boundary of one block
+    size_t stride = ((size_t)count + 15) & ~(size_t)15;
+    float *block = aligned_alloc(64, 10 * stride * sizeof(float));
+    if (!block) return -1;
+    memset(block, 0, 10 * stride * sizeof(float));
+
+    float **arrays[] = { &s->x, &s->y, &s->x_1, &s->y_1, &s->x_2, &s->y_2, &s->Fx, &s->Fy, &s->ax, &s->ay };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) *arrays[i] = block + i * stride;
+    s->count = count;
+    return 0;
+}
+
+void sim_swarm_free(DroneSwarm *s) {
+    free(s->x); // The block
+    memset(s, 0, sizeof(*s));
+}
+
+void sim_swarm_spawn(DroneSwarm *s, float x0, float y0, int win_width, int win_height) {
+    int others = s->count - 1;
+    int cols = (int)ceil(sqrt((double)others));
+    int rows = cols > 0 ? (others + cols - 1) / cols : 0;
+
+    for (int i = 0; i < s->count; i++) {
+        float x = x0, y = y0;
+        if (i > 0) {
+            int j = i - 1;
+            x = 1.0f + (win_width - 2) * ((j % cols) + 0.5f) / cols;
+            y = 1.0f + (win_height - 2) * ((j / cols) + 0.5f) / rows;
+        }
+        s->x[i] = s->x_1[i] = s->x_2[i] = x;
+        s->y[i] = s->y_1[i] = s->y_2[i] = y;
+        s->Fx[i] = s->Fy[i] = 0.0f;
+    }
+}
+
+/* * E. Euler integration of one axis for the whole swarm: the same expression as
+ * sim_physics_step(), in a loop with no aliasing and no branches, so it runs as
+ * SIMD (sim_core.o is built with the vectoriser on, see the Makefile).
+ */
+static void swarm_integrate(int n, float *restrict p, float *restrict p_1, float *restrict p_2,
+                            const float *restrict a) {
+    for (int i = 0; i < n; i++) {
+        float prev = p_1[i];
+        p_2[i] = prev;
+        p_1[i] = p[i];
+        p[i] = (DT*DT*a[i] - prev + (2+K*DT)*p[i])/(1+K*DT);
+    }
+}
+
+void sim_swarm_step_range(const SimField *f, SimScratch *sc, const Point *obstacles, DroneSwarm *s,
+                          int lo, int hi, int win_width, int win_height, MsgForce *out) {
+    if (lo >= hi || scratch_fit(sc, f) < 0) return;
+
+    for (int i = lo; i < hi; i++) {
+        drone_forces(f, sc, s->x[i], s->y[i], s->Fx[i], s->Fy[i], win_width, win_height,
+                     &s->ax[i], &s->ay[i], i == lo ? out : NULL);
+    }
+
+    swarm_integrate(hi - lo, s->x + lo, s->x_1 + lo, s->x_2 + lo, s->ax + lo);
+    swarm_integrate(hi - lo, s->y + lo, s->y_1 + lo, s->y_2 + lo, s->ay + lo);
+
+    for (int i = lo; i < hi; i++) {
+        drone_collide(f, sc, obstacles, &s->x[i], &s->y[i], s->x_1[i], s->y_1[i]);
+    }
+}
+
+void sim_swarm_step(SimField *f, const Point *obstacles, DroneSwarm *s, int win_width, int win_height, MsgForce *out) {
+    sim_swarm_step_range(f, &f->scratch, obstacles, s, 0, s->count, win_width, win_height, out);
+}
+
+/* ======================================================================================
+ * SECTION 4: GENERATION
+ * Random entities on distinct free cells (occupancy bitmap).
+ * ====================================================================================== */
+int sim_generate(Point **pts, int *cap, int width, int height, float density, const Point *taken, int num_taken) {
+    int total_cells = (width - 2) * (height - 2);
+    int count = (int) round(density * total_cells);
+    if (count < 1) count = 1;
+
+    Occupancy occ;
+    if (entities_reserve(pts, cap, count) < 0 || occ_init(&occ, width, height) < 0) return -1;
+
+    if (taken) occ_set_points(&occ, taken, num_taken);
+    int placed = occ_place_random(&occ, *pts, count);
+    occ_free(&occ);
+    return placed;
+}
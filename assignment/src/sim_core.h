@@ -0,0 +1,82 @@
+// sim_core.h
+#ifndef SIM_CORE_H
+#define SIM_CORE_H
+
+#include "app_common.h"
+#include "spatial_grid.h"
+#include "force_kernel.h"
+
+/* * Simulation code without pipes, signals or logging: the Drone physics step and
+ * the obstacle/target generators. Linked by the processes and by the
+ * microbenchmarks (bench/microbench.c).
+ */
+
+/* * Scratch of one thread stepping drones: the grid hits of a query and the
+ * entities they gathered.
+ */
+typedef struct {
+    int *hits;
+    int hits_cap;
+    PointSoA near;
+} SimScratch;
+
+void sim_scratch_init(SimScratch *sc);
+void sim_scratch_free(SimScratch *sc);
+
+/* * What the physics step reads of the obstacles and targets: a neighbour grid and
+ * a float SoA copy of each array, plus the scratch of the single-threaded calls.
+ * The step only reads the grids and copies, so threads with their own SimScratch
+ * can step drones on one field at the same time.
+ */
+typedef struct {
+    SpatialGrid obst_grid, targ_grid;
+    PointSoA obst_soa, targ_soa;
+    SimScratch scratch;
+} SimField;
+
+void sim_field_init(SimField *f);
+void sim_field_free(SimField *f);
+// Full update after a snapshot (the grid only relinks the entities that moved)
+void sim_field_set_obstacles(SimField *f, const Point *obstacles, int n);
+void sim_field_set_targets(SimField *f, const Point *targets, int n);
+
+/* * One fixed physics step: field forces, Euler integration and collision against
+ * obstacles[] (the array the field was built from). out receives the force
+ * breakdown shown in the Blackboard status bar.
+ */
+void sim_physics_step(SimField *f, const Point *obstacles, Drone *drn, int win_width, int win_height, MsgForce *out);
+
+/* * The drones of one Drone process (NUM_DRONES) as structure of arrays, so the
+ * integration of all of them is one loop per axis. Drone 0 is the one the
+ * keys steer and the status bar shows.
+ */
+typedef struct {
+    int count;
+    float *x, *y, *x_1, *y_1, *x_2, *y_2;   // Positions now, one and two steps ago
+    float *Fx, *Fy;                         // Command force (keys)
+    float *ax, *ay;                         // Total force of the step in progress
+} DroneSwarm;
+
+// Returns -1 on allocation failure
+int  sim_swarm_init(DroneSwarm *s, int count);
+void sim_swarm_free(DroneSwarm *s);
+// Drone 0 at (x0, y0), the others on a lattice over the field, all at rest
+void sim_swarm_spawn(DroneSwarm *s, float x0, float y0, int win_width, int win_height);
+/* * sim_physics_step() for every drone: forces per drone, then one Euler update
+ * of the whole swarm, then collisions. out receives drone 0's breakdown.
+ */
+void sim_swarm_step(SimField *f, const Point *obstacles, DroneSwarm *s, int win_width, int win_height, MsgForce *out);
+/* * The same step for drones [lo, hi) only, with the caller's scratch; out (may be
+ * NULL) receives drone lo's breakdown. Disjoint ranges can run concurrently.
+ */
+void sim_swarm_step_range(const SimField *f, SimScratch *sc, const Point *obstacles, DroneSwarm *s,
+                          int lo, int hi, int win_width, int win_height, MsgForce *out);
+
+/* * density * the playing field's cells, at least one, placed on distinct free
+ * cells that are not in taken[0..num_taken) (may be NULL). They refill *pts,
+ * which grows (entities_reserve) only when a round needs more than *cap.
+ * Returns the number placed (less when the field is full), -1 on allocation failure.
+ */
+int sim_generate(Point **pts, int *cap, int width, int height, float density, const Point *taken, int num_taken);
+
+#endif
@@ -0,0 +1,122 @@
+#include "spatial_grid.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* ======================================================================================
+ * SECTION 1: INTERNAL HELPERS
+ * ====================================================================================== */
+static int clampi(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static int bucket_index(const SpatialGrid *g, Point p) {
+    int bx = clampi(p.x / GRID_CELL, 0, g->cols - 1);
+    int by = clampi(p.y / GRID_CELL, 0, g->rows - 1);
+    return by * g->cols + bx;
+}
+
+static void link_item(SpatialGrid *g, int i, int b) {
+    g->prev[i] = -1;
+    g->next[i] = g->head[b];
+    if (g->head[b] >= 0) g->prev[g->head[b]] = i;
+    g->head[b] = i;
+    g->bucket_of[i] = b;
+}
+
+static void unlink_item(SpatialGrid *g, int i) {
+    int b = g->bucket_of[i];
+    if (g->prev[i] >= 0) g->next[g->prev[i]] = g->next[i];
+    else g->head[b] = g->next[i];
+    if (g->next[i] >= 0) g->prev[g->next[i]] = g->prev[i];
+}
+
+static int grow(int **arr, int new_cap) {
+    int *p = realloc(*arr, sizeof(int) * new_cap);
+    if (!p) return -1;
+    *arr = p;
+    return 0;
+}
+
+// Full rebuild sized on the extent of the points
+static int rebuild(SpatialGrid *g, const Point *pts, int n, int cols, int rows) {
+    if (n > g->cap) {
+        if (grow(&g->next, n) || grow(&g->prev, n) || grow(&g->bucket_of, n) || grow(&g->hits, n))
+            return -1;
+        g->cap = n;
+    }
+    if (cols * rows > g->bucket_cap) {
+        if (grow(&g->head, cols * rows)) return -1;
+        g->bucket_cap = cols * rows;
+    }
+    g->cols = cols;
+    g->rows = rows;
+    g->count = n;
+    memset(g->head, 0xff, sizeof(int) * cols * rows); // all -1
+
+    for (int i = 0; i < n; i++) link_item(g, i, bucket_index(g, pts[i]));
+    return n;
+}
+
+/* ======================================================================================
+ * SECTION 2: PUBLIC API
+ * ====================================================================================== */
+void grid_init(SpatialGrid *g) {
+    memset(g, 0, sizeof(*g));
+}
+
+void grid_free(SpatialGrid *g) {
+    free(g->head); free(g->next); free(g->prev);
+    free(g->bucket_of); free(g->hits);
+    grid_init(g);
+}
+
+int grid_sync(SpatialGrid *g, const Point *pts, int n) {
+    int max_x = 0, max_y = 0;
+    for (int i = 0; i < n; i++) {
+        if (pts[i].x > max_x) max_x = pts[i].x;
+        if (pts[i].y > max_y) max_y = pts[i].y;
+    }
+    int cols = max_x / GRID_CELL + 1;
+    int rows = max_y / GRID_CELL + 1;
+
+    // Same population and the extent still fits: relink only what moved
+    if (g->head && n == g->count && cols <= g->cols && rows <= g->rows) {
+        int moved = 0;
+        for (int i = 0; i < n; i++) {
+            int b = bucket_index(g, pts[i]);
+            if (b != g->bucket_of[i]) {
+                unlink_item(g, i);
+                link_item(g, i, b);
+                moved++;
+            }
+        }
+        return moved;
+    }
+    return rebuild(g, pts, n, cols, rows);
+}
+
+int grid_query_into(const SpatialGrid *g, float x, float y, float r, int *hits) {
+    if (g->count == 0) return 0;
+
+    int bx0 = clampi((int)floorf((x - r) / GRID_CELL), 0, g->cols - 1);
+    int bx1 = clampi((int)floorf((x + r) / GRID_CELL), 0, g->cols - 1);
+    int by0 = clampi((int)floorf((y - r) / GRID_CELL), 0, g->rows - 1);
+    int by1 = clampi((int)floorf((y + r) / GRID_CELL), 0, g->rows - 1);
+
+    int n = 0;
+    for (int by = by0; by <= by1; by++) {
+        for (int bx = bx0; bx <= bx1; bx++) {
+            for (int i = g->head[by * g->cols + bx]; i >= 0; i = g->next[i]) {
+                hits[n++] = i;
+            }
+        }
+    }
+    return n;
+}
+
+int grid_query(SpatialGrid *g, float x, float y, float r, const int **hits) {
+    *hits = g->hits;
+    return grid_query_into(g, x, y, r, g->hits);
+}
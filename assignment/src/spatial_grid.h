@@ -0,0 +1,44 @@
+// spatial_grid.h
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include "app_common.h"
+
+// Bucket edge in cells. Close to rho so a force query touches at most 3x3 buckets.
+#define GRID_CELL 8
+
+/* * Uniform bucket grid over integer Point cells.
+ * Every bucket is a doubly linked list of indices into the caller's Point
+ * array, so a single entity can be moved between buckets in O(1).
+ */
+typedef struct {
+    int cols, rows;     // Bucket counts
+    int *head;          // [cols*rows] first index of each bucket, -1 if empty
+    int *next, *prev;   // [cap] bucket list links
+    int *bucket_of;     // [cap] current bucket of each index
+    int *hits;          // [cap] scratch returned by grid_query()
+    int count, cap;
+    int bucket_cap;
+} SpatialGrid;
+
+void grid_init(SpatialGrid *g);
+void grid_free(SpatialGrid *g);
+
+/* * Brings the grid in line with pts[0..n). If n and the extent are unchanged
+ * only the entities whose bucket changed are relinked, otherwise the grid is
+ * rebuilt. Returns the number of relinked entities, -1 on allocation failure.
+ */
+int grid_sync(SpatialGrid *g, const Point *pts, int n);
+
+/* * Collects the indices of all entities in buckets overlapping the square
+ * [x - r, x + r] x [y - r, y + r]. Returns the count; *hits stays valid until
+ * the next call on the same grid.
+ */
+int grid_query(SpatialGrid *g, float x, float y, float r, const int **hits);
+
+/* * Same query into the caller's hits[] (room for g->count indices), without
+ * touching the grid: threads can query one grid concurrently.
+ */
+int grid_query_into(const SpatialGrid *g, float x, float y, float r, int *hits);
+
+#endif
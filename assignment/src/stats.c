@@ -0,0 +1,116 @@
+/* ======================================================================================
+ * FILE: stats.c
+ * Reads the metrics segment (see metrics.h) of a running session and prints,
+ * per process, what changed over an interval.
+ *
+ *   stats [seconds] [rounds]
+ *
+ * seconds : sampling interval (default 1). Rates are over that interval, the
+ *           longest loop and the most bytes ever queued on a pipe are since start.
+ * rounds  : reports to print (default 1, 0 until interrupted).
+ * ====================================================================================== */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_common.h"
+#include "metrics.h"
+
+static const char *const type_names[MET_MSG_TYPES] = {
+    "?", "SIZE", "OBSTACLES", "INPUT", "EXIT", "DRONE", "POSITION", "OBST_FORCE",
+    "TARGETS", "FORCE", "PID", "TICK", "PEER_LEFT", "OBST_MOTION", "ENTITY_DELTA", "SWARM"
+};
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 1: REPORT
+ * ------------------------------------------------------------------------------------- */
+static void print_msgs(const char *dir, const _Atomic uint64_t *now, const _Atomic uint64_t *before, double secs) {
+    int any = 0;
+    for (int t = 0; t < MET_MSG_TYPES; t++) {
+        uint64_t d = now[t] - before[t];
+        if (!d) continue;
+        if (!any) printf("  msgs %-4s", dir);
+        printf("  %s %.1f/s", type_names[t], d / secs);
+        any = 1;
+    }
+    if (any) printf("\n");
+}
+
+static void print_slot(const MetSlot *s, const MetSlot *b, double secs) {
+    uint64_t total = 0;
+    for (int i = 0; i < MET_STATES; i++) total += s->state_ns[i] - b->state_ns[i];
+
+    printf("%s [PID %d]  %.0f loops/s, longest loop %.2f ms, now %s\n", s->name, (int)s->pid,
+           (s->loops - b->loops) / secs, s->loop_max_ns / 1e6, metrics_state_name((int)s->state));
+    if (total) {
+        printf("  time");
+        for (int i = 0; i < MET_STATES; i++) {
+            uint64_t d = s->state_ns[i] - b->state_ns[i];
+            if (d) printf("  %s %.1f%%", metrics_state_name(i), 100.0 * d / total);
+        }
+        printf("\n");
+    }
+    print_msgs("in", s->msgs_in, b->msgs_in, secs);
+    print_msgs("out", s->msgs_out, b->msgs_out, secs);
+
+    uint32_t counters = s->counters < MET_MAX_COUNTERS ? s->counters : MET_MAX_COUNTERS;
+    if (counters) printf("  count");
+    for (uint32_t i = 0; i < counters; i++) {
+        const MetCounter *c = &s->counter[i];
+        printf("  %s %.1f/s (%llu)", c->name, (c->value - b->counter[i].value) / secs,
+               (unsigned long long)c->value);
+    }
+    if (counters) printf("\n");
+
+    uint32_t pipes = s->pipes < MET_MAX_PIPES ? s->pipes : MET_MAX_PIPES;
+    if (pipes) printf("  %-12s %12s %12s %9s %9s\n", "pipe", "in B/s", "out B/s", "pending", "max");
+    for (uint32_t i = 0; i < pipes; i++) {
+        const MetPipe *p = &s->pipe[i], *q = &b->pipe[i];
+        printf("  %-12s %12.0f %12.0f %9u %9u\n", p->name,
+               (p->bytes_in - q->bytes_in) / secs, (p->bytes_out - q->bytes_out) / secs,
+               (unsigned)p->pending, (unsigned)p->pending_max);
+    }
+}
+
+/* --------------------------------------------------------------------------------------
+ * SECTION 2: MAIN
+ * ------------------------------------------------------------------------------------- */
+int main(int argc, char *argv[]) {
+    double secs = (argc > 1) ? atof(argv[1]) : 1.0;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 1;
+    if (secs <= 0) {
+        fprintf(stderr, "Usage: %s [seconds] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    const MetTable *t = metrics_attach();
+    if (!t) {
+        fprintf(stderr, "[STATS] No metrics segment: is a session running (built with METRICS=1)?\n");
+        return 1;
+    }
+
+    static MetTable before, now;
+    memcpy(&now, t, sizeof(now));
+    for (int r = 0; rounds == 0 || r < rounds; r++) {
+        before = now;
+        struct timespec ts = { (time_t)secs, (long)((secs - (time_t)secs) * 1e9) };
+        nanosleep(&ts, NULL);
+        memcpy(&now, t, sizeof(now));
+
+        if (r > 0) printf("\n");
+        uint32_t used = now.used < MET_MAX_SLOTS ? now.used : MET_MAX_SLOTS;
+        int shown = 0;
+        for (uint32_t i = 0; i < used; i++) {
+            // Joined during the interval: no baseline yet
+            if (now.slot[i].pid == 0 || now.slot[i].pid != before.slot[i].pid) continue;
+            print_slot(&now.slot[i], &before.slot[i], secs);
+            shown++;
+        }
+        if (!shown) printf("[STATS] No process is publishing metrics\n");
+        fflush(stdout);
+    }
+
+    metrics_detach(t);
+    return 0;
+}
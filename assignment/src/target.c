@@ -13,52 +13,48 @@
 #include <signal.h>
 #include <sys/select.h>
 #include <sys/stat.h>
-#include <sys/file.h>
 
 #include "app_common.h"
 #include "log.h"
 #include "process_pid.h"
+#include "msg_codec.h"
+#include "entities.h"
+#include "sim_core.h"
+#include "heartbeat.h"
+#include "metrics.h"
 
 static Point *obstacles = NULL;
-static int num_obstacles = 0;
+static int num_obstacles = 0, obstacles_cap = 0;
+static uint32_t obstacles_version = 0;
+static Point *generated = NULL;        // Last generated array, reused by every round
+static int generated_cap = 0;
 static volatile pid_t watchdog_pid = -1;
 
-typedef enum { STATE_INIT, STATE_WAITING, STATE_GENERATING } ProcessState;
+typedef enum { STATE_INIT, STATE_WAITING, STATE_READING, STATE_GENERATING } ProcessState;
 static volatile sig_atomic_t current_state = STATE_INIT;
 
+/* What each state counts as in the metrics segment (exec/stats) */
+static const MetState met_state_of[] = {
+    [STATE_INIT] = MET_IDLE, [STATE_WAITING] = MET_IDLE,
+    [STATE_READING] = MET_INPUT, [STATE_GENERATING] = MET_UPDATE
+};
+
+static void set_state(ProcessState state) {
+    current_state = state;
+    metrics_state(met_state_of[state]);
+}
+
 /* ======================================================================================
  * SECTION 2: WATCHDOG UTILITIES
  * ====================================================================================== */
-void publish_my_pid(FILE *fp) {
-    fprintf(fp, "%s %d\n", TARGET_PID_TAG, getpid());
-    logMessage(LOG_PATH, "[TARG] PID published securely");
+void publish_my_pid(void) {
+    if (registry_publish(ROLE_TARGET) == 0) logMessage(LOG_PATH, "[TARG] PID published");
 }
 
 void wait_for_watchdog_pid() {
-    FILE *fp;
-    char line[256], tag[128];
-    int pid_temp;
-    bool wd_found = false;
-
     logMessage(LOG_PATH, "[TARG] Waiting for Watchdog...");
-
-    while (!wd_found) {
-        fp = fopen(PID_FILE_PATH, "r");
-        if (fp) {
-            while (fgets(line, sizeof(line), fp)) {
-                if (sscanf(line, "%s %d", tag, &pid_temp) == 2) {
-                    if (strcmp(tag, WD_PID_TAG) == 0) {
-                        watchdog_pid = (pid_t)pid_temp;
-                        wd_found = true;
-                        break;
-                    }
-                }
-            }
-            fclose(fp);
-        }
-        if (!wd_found) usleep(200000);
-    }
-    logMessage(LOG_PATH, "[TARG] Watchdog found (PID %d)", watchdog_pid);
+    watchdog_pid = registry_wait(ROLE_WATCHDOG, -1);
+    if (watchdog_pid > 0) logMessage(LOG_PATH, "[TARG] Watchdog found (PID %d)", watchdog_pid);
 }
 
 void watchdog_ping_handler(int signo) {
@@ -70,36 +66,14 @@ void watchdog_ping_handler(int signo) {
 
 /* ======================================================================================
  * SECTION 3: GENERATION LOGIC
- * Generates targets checking collision with current Obstacles.
+ * Generates targets on free cells, the current Obstacles marked as taken.
  * ====================================================================================== */
-Point* generate_targets(int width, int height, Point* obstacles, int num_obstacles, int* num_out) {
-    int total_cells = (width - 2) * (height - 2);
-    int count = (int) round(PERC_TARG * total_cells);
-    if (count < 1) count = 1;
-
-    Point* arr = malloc(sizeof(Point) * count);
-    if (!arr) exit(1);
-    
-    for (int i = 0; i < count; i++) {
-        int valid;
-        do {
-            valid = 1;
-            arr[i].x = rand() % (width - 2) + 1;
-            arr[i].y = rand() % (height - 2) + 1;
-            
-            // Check self-overlap
-            for (int j = 0; j < i; j++) {
-                if (arr[i].x == arr[j].x && arr[i].y == arr[j].y) { valid = 0; break; }
-            }
-            // Check obstacle-overlap
-            for (int j = 0; j < num_obstacles && valid; j++) {
-                if (arr[i].x == obstacles[j].x && arr[i].y == obstacles[j].y) { valid = 0; break; }
-            }
-        } while (!valid);
-    }
+// Refills *arr (capacity *cap, kept across rounds) and returns the target count
+int generate_targets(int width, int height, Point* obstacles, int num_obstacles, Point **arr, int *cap) {
+    int count = sim_generate(arr, cap, width, height, PERC_TARG, obstacles, num_obstacles);
+    if (count < 0) exit(1);
     logMessage(LOG_PATH, "[TARG] Generated %d targets", count);
-    *num_out = count;
-    return arr;
+    return count;
 }
 
 /* ======================================================================================
@@ -107,6 +81,7 @@ Point* generate_targets(int width, int height, Point* obstacles, int num_obstacl
  * ====================================================================================== */
 int main(int argc, char *argv[]) {
     if (argc < 3) return 1;
+    config_from_env();
 
     srand(time(NULL));
 
@@ -124,21 +99,18 @@ int main(int argc, char *argv[]) {
 
     wait_for_watchdog_pid();
 
-    FILE *fp_pid = fopen(PID_FILE_PATH, "a");
-    if (!fp_pid) {
-        logMessage(LOG_PATH, "[TARG] Error opening PID file!");
-        exit(1);
-    }
-    int fd_pid = fileno(fp_pid);
-    flock(fd_pid, LOCK_EX); 
-    publish_my_pid(fp_pid);
-    fflush(fp_pid);
-    flock(fd_pid, LOCK_UN);
-    fclose(fp_pid);
+    publish_my_pid();
+    hb_join("TARGET", HB_DEADLINE_MS);
+    metrics_join("TARGET");
+    metrics_pipe(fd_in, "bb.in");
+    metrics_pipe(fd_out, "bb.out");
+    registry_ready(ROLE_TARGET);
 
     // --- MAIN LOOP ---
     while (1) {
-        current_state = STATE_WAITING;
+        metrics_loop();
+        set_state(STATE_WAITING);
+        hb_beat(); // At least every select() timeout
         fd_set set;
         FD_ZERO(&set);
         FD_SET(fd_in, &set);
@@ -154,44 +126,50 @@ int main(int argc, char *argv[]) {
         }
 
         if (FD_ISSET(fd_in, &set)) {
+            set_state(STATE_READING);
             Message msg;
-            ssize_t n = read(fd_in, &msg, sizeof(msg));
+            ssize_t n = metrics_read(fd_in, &msg, sizeof(msg));
             if (n <= 0) {
                 logMessage(LOG_PATH, "[TARG] Pipe closed, exiting.");
                 break;
             }
+            metrics_msg_in(msg.type);
 
             if (msg.type == MSG_TYPE_SIZE) {
-                sscanf(msg.data, "%d %d", &win_width, &win_height);
+                msg_decode_size(&msg, &win_width, &win_height);
             }
             // Upon receiving obstacles, generate targets
             else if (msg.type == MSG_TYPE_OBSTACLES) {
-                current_state = STATE_GENERATING;
+                set_state(STATE_GENERATING);
                 int count = 0;
-                sscanf(msg.data, "%d", &count);
+                uint32_t version = 0;
+                msg_decode_entities(&msg, &count, &version);
                 
-                free(obstacles);
-                obstacles = NULL;
                 num_obstacles = 0;
-
-                if (count > 0) {
-                    obstacles = malloc(sizeof(Point) * count);
-                    if (obstacles) {
-                        read(fd_in, obstacles, sizeof(Point) * count);
-                        num_obstacles = count;
-                    }
+                if (entities_read(metrics_read, fd_in, &obstacles, &obstacles_cap, count) == 0) {
+                    num_obstacles = count;
+                } else {
+                    logMessage(LOG_PATH, "[TARG] ERROR: snapshot of %d obstacles lost", count);
                 }
+                obstacles_version = version;
 
                 if (win_width > 0 && win_height > 0) {
-                    int num_targ = 0;
-                    Point* arr = generate_targets(win_width, win_height, obstacles, num_obstacles, &num_targ);
+                    int num_targ = generate_targets(win_width, win_height, obstacles, num_obstacles,
+                                                    &generated, &generated_cap);
                     
                     Message out_msg;
-                    out_msg.type = MSG_TYPE_TARGETS;
-                    snprintf(out_msg.data, sizeof(out_msg.data), "%d", num_targ);
-                    write(fd_out, &out_msg, sizeof(out_msg));
-                    write(fd_out, arr, sizeof(Point) * num_targ);
-                    free(arr);
+                    msg_encode_entities(&out_msg, MSG_TYPE_TARGETS, num_targ, 0);
+                    metrics_msg_out(MSG_TYPE_TARGETS);
+                    metrics_write(fd_out, &out_msg, sizeof(out_msg));
+                    metrics_write(fd_out, generated, sizeof(Point) * num_targ);
+                }
+            }
+            // A relocated obstacle: patched in place, the targets stay
+            else if (msg.type == MSG_TYPE_ENTITY_DELTA) {
+                MsgEntityDelta d;
+                if (msg_decode_entity_delta(&msg, &d) == 0 && d.kind == MSG_TYPE_OBSTACLES &&
+                    entities_apply(&obstacles, &num_obstacles, &obstacles_cap, &obstacles_version, &d) < 0) {
+                    logMessage(LOG_PATH, "[TARG] Obstacle delta (version %u) rejected", d.version);
                 }
             }
             else if(msg.type == MSG_TYPE_EXIT){
@@ -204,7 +182,10 @@ int main(int argc, char *argv[]) {
     }
 
     quit:
+    hb_leave();
+    metrics_leave();
     free(obstacles);
+    free(generated);
     close(fd_in);
     close(fd_out);
     return 0;
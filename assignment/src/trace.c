@@ -0,0 +1,96 @@
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "log.h"
+
+static int trace_fd = -1;
+static struct timespec trace_t0;
+
+/* ======================================================================================
+ * SECTION 1: WRITER
+ * ====================================================================================== */
+int trace_open(const char *path, int mode, int role) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        logMessage(LOG_PATH, "[TRACE] Cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    TraceFileHeader hdr = { TRACE_MAGIC, TRACE_VERSION, (uint8_t)mode, (uint8_t)role, (int64_t)time(NULL) };
+    if (write(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        logMessage(LOG_PATH, "[TRACE] Cannot write header to %s", path);
+        close(fd);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &trace_t0);
+    trace_fd = fd;
+    logMessage(LOG_PATH, "[TRACE] Recording to %s", path);
+    return 0;
+}
+
+void trace_record(TraceSource src, const void *a, size_t alen, const void *b, size_t blen) {
+    if (trace_fd < 0) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    TraceRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.t_ns = (uint64_t)(now.tv_sec - trace_t0.tv_sec) * 1000000000ull + (uint64_t)now.tv_nsec - (uint64_t)trace_t0.tv_nsec;
+    rec.source = (uint8_t)src;
+    rec.len = (uint32_t)(alen + blen);
+
+    struct iovec iov[3] = {
+        { &rec, sizeof(rec) },
+        { (void *)a, alen },
+        { (void *)b, blen },
+    };
+    ssize_t want = (ssize_t)(sizeof(rec) + alen + blen);
+    if (writev(trace_fd, iov, blen ? 3 : 2) != want) {
+        // A torn record would desynchronise the reader: stop here, the prefix stays valid
+        logMessage(LOG_PATH, "[TRACE] Write failed, recording stopped");
+        trace_close();
+    }
+}
+
+void trace_close(void) {
+    if (trace_fd < 0) return;
+    close(trace_fd);
+    trace_fd = -1;
+}
+
+/* ======================================================================================
+ * SECTION 2: READER
+ * ====================================================================================== */
+// Returns 1 when len bytes were read, 0 on a clean EOF before the first byte, -1 otherwise
+static int read_exact(int fd, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, (char *)buf + got, len - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return (n == 0 && got == 0) ? 0 : -1;
+        got += (size_t)n;
+    }
+    return 1;
+}
+
+int trace_read_header(int fd, TraceFileHeader *hdr) {
+    if (read_exact(fd, hdr, sizeof(*hdr)) != 1) return -1;
+    if (hdr->magic != TRACE_MAGIC || hdr->version != TRACE_VERSION) return -1;
+    return 0;
+}
+
+int trace_read_next(int fd, TraceRecord *rec, void *buf, size_t cap) {
+    int r = read_exact(fd, rec, sizeof(*rec));
+    if (r <= 0) return r;
+    if (rec->len > cap) return -1;
+    if (rec->len && read_exact(fd, buf, rec->len) != 1) return -1;
+    return 1;
+}
@@ -0,0 +1,58 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "app_common.h"
+
+// Recording is enabled by pointing this variable at the output file
+#define TRACE_ENV      "ARP_TRACE_FILE"
+#define TRACE_MAGIC    0x54505241u      // "ARPT"
+#define TRACE_VERSION  1
+#define TRACE_MAX_RECORD (64 * 1024)    // Largest payload accepted by the reader
+
+// Stream a record was observed on (Blackboard point of view)
+typedef enum {
+    TRACE_SRC_INPUT = 1,    // Raw key bytes from the Input process
+    TRACE_SRC_DRONE,        // POSITION / FORCE Messages from the Drone
+    TRACE_SRC_OBSTACLE,     // Message + Point[] from the Obstacle process
+    TRACE_SRC_TARGET,       // Message + Point[] from the Target process
+    TRACE_SRC_NETWORK,      // Messages from the Network process
+    TRACE_SRC_TO_DRONE      // Everything the Blackboard sent to the Drone
+} TraceSource;
+
+/* * File layout: one TraceFileHeader, then records made of a TraceRecord
+ * header followed by len payload bytes, exactly as they travelled on the
+ * stream (Message, optionally followed by its Point array).
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t mode, role;     // Recorded session (MODE_*, MODE_SERVER/CLIENT)
+    int64_t started;        // Wall-clock start, seconds since the epoch
+} TraceFileHeader;
+
+typedef struct __attribute__((packed)) {
+    uint64_t t_ns;          // CLOCK_MONOTONIC since trace_open()
+    uint8_t source;         // TraceSource
+    uint8_t reserved[3];
+    uint32_t len;
+} TraceRecord;
+
+/* * Writer (one per process). trace_open() truncates the file and writes the
+ * header. trace_record() appends a+b as one record with a single writev() and
+ * is a no-op while no trace is open, so call sites need no checks.
+ */
+int  trace_open(const char *path, int mode, int role);
+void trace_record(TraceSource src, const void *a, size_t alen, const void *b, size_t blen);
+void trace_close(void);
+
+/* * Reader. trace_read_next() fills rec and up to cap payload bytes.
+ * Returns 1 for a record, 0 at end of file, -1 on a truncated or oversized record.
+ */
+int trace_read_header(int fd, TraceFileHeader *hdr);
+int trace_read_next(int fd, TraceRecord *rec, void *buf, size_t cap);
+
+#endif
@@ -12,16 +12,20 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
-#include <sys/file.h>
 #include <stdarg.h> 
 #include <fcntl.h> // <--- CRITICAL: Required for O_NONBLOCK
 
 #include "process_pid.h" 
+#include "config.h"
 #include "log.h" 
+#include "heartbeat.h"
+#include "metrics.h"
+#include "reactor.h"
 
 #define LOG_PATH "logs/watchdog.log"
-#define TIMEOUT_US 200000 // 200ms timeout for response
-#define CYCLE_DELAY 2     // Seconds between checks
+#define TIMEOUT_US (arp_config.wd_timeout_ms * 1000) // Timeout for a ping response
+#define CYCLE_DELAY (arp_config.wd_cycle_sec)        // Seconds between checks
+#define HB_REPORT_SEC 10  // Heartbeat mode: liveness summary period in the log
 
 typedef struct {
     pid_t pid;
@@ -35,7 +39,7 @@ static int process_count = 0;
 
 /* ======================================================================================
  * SECTION 2: HELPER FUNCTIONS
- * Logging wrapper, PID file parsing, and Signal Handling.
+ * Logging wrapper, PID registry reading, and Signal Handling.
  * ====================================================================================== */
 
 // Wrapper to log to both Console (stdout) and File with timestamps
@@ -61,45 +65,27 @@ void w_log(const char *format, ...) {
     logMessage(LOG_PATH, "%s", buffer);
 }
 
-// Writes the Watchdog's own PID to the shared file
-void publish_my_pid(FILE *fp) {
-    fprintf(fp, "%s %d\n", WD_PID_TAG, getpid());
-    w_log("[WATCHDOG] PID published securely");
+// Publishes the Watchdog's own PID in its registry slot
+void publish_my_pid(void) {
+    if (registry_publish(ROLE_WATCHDOG) == 0) w_log("[WATCHDOG] PID published");
 }
 
-// Reads the shared PID file to discover other processes dynamically
+// Reads the registry slots to discover the other processes dynamically
 void refresh_process_registry() {
-    FILE *fp = fopen(PID_FILE_PATH, "r");
-    if (!fp) return;
-    
-    char line[256];
-    char tag[128];
-    int pid_val;
-    
-    process_count = 0; 
+    process_count = 0;
 
-    while (fgets(line, sizeof(line), fp)) {
-        if (sscanf(line, "%s %d", tag, &pid_val) == 2) {
-            // Skip own PID
-            if (strcmp(tag, WD_PID_TAG) == 0) continue;
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        // Skip own PID
+        if (role == ROLE_WATCHDOG) continue;
 
-            if (process_count < MAX_PROCESSES) {
-                process_map[process_count].pid = (pid_t)pid_val;
-                process_map[process_count].alive = 0; 
-                
-                // Map tags to readable names
-                if (strcmp(tag, DRONE_PID_TAG) == 0) strcpy(process_map[process_count].name, "DRONE");
-                else if (strcmp(tag, BB_PID_TAG) == 0) strcpy(process_map[process_count].name, "BLACKBOARD");
-                else if (strcmp(tag, TARGET_PID_TAG) == 0) strcpy(process_map[process_count].name, "TARGET");
-                else if (strcmp(tag, OBSTACLE_PID_TAG) == 0) strcpy(process_map[process_count].name, "OBSTACLE");
-                else if (strcmp(tag, INPUT_PID_TAG) == 0) strcpy(process_map[process_count].name, "INPUT");
-                else strcpy(process_map[process_count].name, "UNKNOWN");
-                
-                process_count++;
-            }
-        }
+        pid_t pid = registry_get((ProcessRole)role);
+        if (pid <= 0 || process_count >= MAX_PROCESSES) continue;
+
+        process_map[process_count].pid = pid;
+        process_map[process_count].alive = 0;
+        strcpy(process_map[process_count].name, registry_role_name((ProcessRole)role));
+        process_count++;
     }
-    fclose(fp);
 }
 
 // Handler for SIGUSR2 (PONG): Marks a specific process as alive
@@ -117,6 +103,119 @@ void pong_handler(int sig, siginfo_t *info, void *context) {
     }
 }
 
+/* ======================================================================================
+ * SECTION 2B: HEARTBEAT MONITOR (HEARTBEAT=1)
+ * Every HB_PERIOD_MS one pass over the shared slots compares each process's last
+ * beat with its own deadline: no signals, and the cost of a pass does not depend
+ * on how responsive the processes are. The quit pipe is watched by the same
+ * reactor, so the Watchdog leaves as soon as the Blackboard quits.
+ * ====================================================================================== */
+#if USE_HEARTBEAT
+typedef struct {
+    HbTable *table;
+    int fd_bb_read;
+    int seen[HB_MAX_SLOTS];          // PID last logged as registered, per slot
+    uint64_t next_report_ns;
+    int quit;
+} HbMonitor;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void on_quit_pipe(int fd, uint32_t events, void *arg) {
+    (void)events;
+    HbMonitor *m = arg;
+    char buf[80];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0) return;
+    if (n > 0) w_log("[WATCHDOG] Received quit signal. Exiting.");
+    else w_log("[WATCHDOG] Blackboard pipe closed. Exiting.");
+    m->quit = 1;
+}
+
+static void on_scan_timer(int fd, uint32_t events, void *arg) {
+    (void)events;
+    HbMonitor *m = arg;
+    reactor_timer_drain(fd);
+
+    uint64_t now = monotonic_ns();
+    uint32_t used = atomic_load(&m->table->used);
+    if (used > HB_MAX_SLOTS) used = HB_MAX_SLOTS;
+    int alive = 0;
+    uint64_t max_silence = 0;
+
+    for (uint32_t i = 0; i < used; i++) {
+        HbSlot *s = &m->table->slot[i];
+        int32_t pid = atomic_load_explicit(&s->pid, memory_order_acquire);
+        if (pid == 0) continue; // Free or left cleanly
+        if (m->seen[i] != pid) {
+            w_log("[WATCHDOG] Process %s [PID %d] registered (deadline %u ms)", s->name, pid, s->deadline_ms);
+            m->seen[i] = pid;
+        }
+
+        uint64_t beat = atomic_load_explicit(&s->beat_ns, memory_order_acquire);
+        uint64_t silence = (now > beat) ? now - beat : 0;
+        if (silence > (uint64_t)s->deadline_ms * 1000000ull) {
+            w_log("[WATCHDOG] ALERT! Process %s [PID %d] silent for %llu ms (deadline %u ms)!",
+                  s->name, pid, (unsigned long long)(silence / 1000000ull), s->deadline_ms);
+            // The quit may have arrived while it was already exiting
+            char buf[80];
+            if (read(m->fd_bb_read, buf, sizeof(buf)) > 0) {
+                w_log("[WATCHDOG] Received quit signal. Exiting.");
+                m->quit = 1;
+                return;
+            }
+            w_log("[WATCHDOG] Killing system due to unresponsive process.");
+            log_flush();      // SIGKILL below includes us: no atexit
+            kill(0, SIGKILL); // Kill the entire process group
+            exit(1);
+        }
+        alive++;
+        if (silence > max_silence) max_silence = silence;
+    }
+
+    if (now >= m->next_report_ns) {
+        w_log("[WATCHDOG] %d processes alive, longest silence %.1f ms", alive, max_silence / 1e6);
+        m->next_report_ns = now + HB_REPORT_SEC * 1000000000ull;
+    }
+}
+
+// Returns 0 once the session quits, -1 when heartbeats are unavailable
+static int heartbeat_monitor(int fd_bb_read) {
+    HbMonitor m = {0};
+    m.table = heartbeat_attach();
+    m.fd_bb_read = fd_bb_read;
+    if (!m.table) return -1;
+
+    Reactor reactor;
+    int tfd = reactor_timer_create();
+    if (reactor_init(&reactor) < 0 || tfd < 0) {
+        heartbeat_detach(m.table);
+        return -1;
+    }
+    const long long period_ns = HB_PERIOD_MS * 1000000LL;
+    reactor_timer_arm(tfd, period_ns, period_ns);
+    reactor_add(&reactor, tfd, on_scan_timer, &m);
+    reactor_add(&reactor, fd_bb_read, on_quit_pipe, &m);
+    w_log("[WATCHDOG] Heartbeat monitoring started (every %d ms)", HB_PERIOD_MS);
+
+    while (!m.quit) {
+        metrics_loop();
+        metrics_state(MET_IDLE);
+        if (reactor_run_once(&reactor, -1) < 0 && errno != EINTR) break;
+        metrics_state(MET_INPUT);
+    }
+
+    reactor_close(&reactor);
+    close(tfd);
+    heartbeat_detach(m.table);
+    return 0;
+}
+#endif
+
 /* ======================================================================================
  * SECTION 3: MAIN SETUP
  * Initialization, Locking, and Configuration.
@@ -124,6 +223,7 @@ void pong_handler(int sig, siginfo_t *info, void *context) {
 int main(int argc, char *argv[]) {
 
     if (argc < 2) return 1;
+    config_from_env();
     int fd_bb_read  = atoi(argv[1]);
 
     // 1. CRITICAL: SET PIPE TO NON-BLOCKING
@@ -140,28 +240,37 @@ int main(int argc, char *argv[]) {
     sa_pong.sa_flags = SA_RESTART | SA_SIGINFO; 
     sigaction(SIGUSR2, &sa_pong, NULL);
 
-    // Clean old PID file
-    remove(PID_FILE_PATH);
-
     w_log("[WATCHDOG] Starting... PID: %d", getpid());
 
-    // Securely publish PID with file locking
-    FILE *fp_pid = fopen(PID_FILE_PATH, "a");
-    if (!fp_pid) {
-        w_log("[WATCHDOG] Error opening PID file!");
-        exit(1);
+    // Main created the registry empty, so there is nothing stale to clean
+    publish_my_pid();
+    registry_ready(ROLE_WATCHDOG);
+    metrics_join("WATCHDOG");
+    metrics_pipe(fd_bb_read, "bb.in");
+
+#if USE_HEARTBEAT
+    // Slots are only checked once their process has joined: no warm-up needed
+    if (heartbeat_monitor(fd_bb_read) == 0) goto done;
+    w_log("[WATCHDOG] No heartbeat segment, falling back to SIGUSR1 pings");
+#endif
+
+    // Wait for the other processes main spawned to register their PIDs (after the
+    // startup barrier they all have): each wait wakes on the publish itself, and
+    // all of them share one 4 second budget
+    w_log("[WATCHDOG] Warm-up phase (up to 4 seconds)...");
+    struct timespec warm_start, warm_now;
+    clock_gettime(CLOCK_MONOTONIC, &warm_start);
+    const uint32_t expected = registry_expected();
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        if (role == ROLE_WATCHDOG || !(expected & ROLE_BIT(role))) continue;
+        clock_gettime(CLOCK_MONOTONIC, &warm_now);
+        long spent_ms = (warm_now.tv_sec - warm_start.tv_sec) * 1000L
+                      + (warm_now.tv_nsec - warm_start.tv_nsec) / 1000000L;
+        if (spent_ms >= 4000 || registry_wait((ProcessRole)role, (int)(4000 - spent_ms)) < 0) break;
     }
-    int fd_pid = fileno(fp_pid);
-    flock(fd_pid, LOCK_EX); 
-    publish_my_pid(fp_pid);
-    fflush(fp_pid);
-    flock(fd_pid, LOCK_UN);
-    fclose(fp_pid);
-    
-    // Wait for other processes to start and register their PIDs
-    w_log("[WATCHDOG] Warm-up phase (4 seconds)...");
-    sleep(4); 
-    w_log("[WATCHDOG] Warm-up complete. Monitoring started.");
+    clock_gettime(CLOCK_MONOTONIC, &warm_now);
+    w_log("[WATCHDOG] Warm-up complete after %ld ms. Monitoring started.",
+          (warm_now.tv_sec - warm_start.tv_sec) * 1000L + (warm_now.tv_nsec - warm_start.tv_nsec) / 1000000L);
 
     /* ======================================================================================
      * SECTION 4: MONITORING LOOP
@@ -169,6 +278,8 @@ int main(int argc, char *argv[]) {
      * ====================================================================================== */
     while (1) {
         char buf[80];
+        metrics_loop();
+        metrics_state(MET_INPUT);
         
         // 1. CHECK FOR QUIT SIGNAL (Non-blocking)
         ssize_t n = read(fd_bb_read, buf, sizeof(buf)-1);
@@ -181,6 +292,7 @@ int main(int argc, char *argv[]) {
         refresh_process_registry();
 
         if (process_count == 0) {
+            metrics_state(MET_IDLE);
             sleep(1);
             continue;
         }
@@ -197,6 +309,7 @@ int main(int argc, char *argv[]) {
             // C. Wait for response (Fast Polling)
             int elapsed = 0;
             int step = 5000; // 5ms steps
+            metrics_state(MET_IDLE);
             
             while (process_map[i].alive == 0 && elapsed < TIMEOUT_US) {
                 usleep(step);
@@ -204,25 +317,34 @@ int main(int argc, char *argv[]) {
             }
 
             // D. Verify Result (Performed AFTER the waiting loop)
+            metrics_state(MET_INPUT);
             if (process_map[i].alive == 1) {
                 // Success: The process responded in time
                 w_log("[WATCHDOG] Process %s [PID %d] is responsive!", 
                            process_map[i].name, process_map[i].pid);
+            } else if (read(fd_bb_read, buf, sizeof(buf)-1) > 0) {
+                // The quit arrived while we were waiting: the process exited, it did not hang
+                w_log("[WATCHDOG] Received quit signal. Exiting.");
+                goto done;
             } else {
                 // Failure: Timeout reached
                 w_log("[WATCHDOG] ALERT! Process %s [PID %d] timed out after %d ms!", 
                            process_map[i].name, process_map[i].pid, elapsed/1000);
                 
                 w_log("[WATCHDOG] Killing system due to unresponsive process.");
+                log_flush();      // SIGKILL below includes us: no atexit
                 kill(0, SIGKILL); // Kill the entire process group
                 exit(1);
             }
         }
         
         w_log("[WATCHDOG] All %d processes checked. Waiting next cycle...", process_count);
+        metrics_state(MET_IDLE);
         sleep(CYCLE_DELAY);
     }
 
+done:
+    metrics_leave();
     logMessage(LOG_PATH, "[WD] Terminated Successfully");
     return 0;
 }
\ No newline at end of file